@@ -0,0 +1,831 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+#include <cairo/cairo.h>
+#include "database.h"
+#include "analytics.h"
+#include "budget.h"
+#include "goal.h"
+#include "chart.h"
+#include "arena.h"
+#include "profile.h"
+#include "synth.h"
+
+/* Each case runs until it has used BENCH_MIN_SECONDS or reached its iteration cap. */
+#define BENCH_MIN_SECONDS 0.25
+#define BENCH_DEFAULT_ITERS 2000
+#define BENCH_MAX_MATERIALIZE 2000000L  /* larger ledgers skip the fetch-everything case */
+#define CHART_WIDTH 800
+#define CHART_HEIGHT 600
+
+typedef struct BenchCtx {
+    long rows;
+    char month[9];            /* current month, YYYY-MM */
+    char range_from[DATE_LEN];
+    char range_to[DATE_LEN];
+    const char *db_path;
+    int *ids;                 /* rows made by setup for the case that follows */
+    int id_count;
+    int id_cap;
+    Transaction tx;
+    Budget budget;
+    Goal goal;
+    RecurringTransaction rule;
+    cairo_surface_t *surface;
+    long sink;                /* keeps results observable */
+} BenchCtx;
+
+typedef struct BenchCase {
+    const char *name;
+    const char *group;
+    int (*setup)(BenchCtx *ctx, int iters);   /* untimed, may be NULL */
+    int (*run)(BenchCtx *ctx, int i);
+    int max_iters;                            /* 0 means BENCH_DEFAULT_ITERS */
+} BenchCase;
+
+/* ---- setup helpers ---- */
+
+static void bench_tx(Transaction *t, const char *category, const char *date, Money amount)
+{
+    memset(t, 0, sizeof(*t));
+    snprintf(t->type, TYPE_LEN, "expense");
+    snprintf(t->category, CATEGORY_LEN, "%s", category);
+    snprintf(t->date, DATE_LEN, "%s", date);
+    snprintf(t->note, NOTE_LEN, "bench row");
+    t->amount = amount;
+}
+
+static int collect_id(const Transaction *t, void *user_data)
+{
+    BenchCtx *ctx = (BenchCtx*)user_data;
+    if (ctx->id_count == ctx->id_cap) {
+        int ncap = ctx->id_cap ? ctx->id_cap * 2 : 256;
+        int *tmp = (int*)realloc(ctx->ids, (size_t)ncap * sizeof(int));
+        if (!tmp) return -1;
+        ctx->ids = tmp; ctx->id_cap = ncap;
+    }
+    ctx->ids[ctx->id_count++] = t->id;
+    return 0;
+}
+
+/* Add iters rows in category "Bench" and remember their ids */
+static int setup_bench_rows(BenchCtx *ctx, int iters)
+{
+    ctx->id_count = 0;
+    if (db_begin_transaction() != 0) return -1;
+    for (int i = 0; i < iters; ++i) {
+        bench_tx(&ctx->tx, "Bench", ctx->range_to, 100 + i);
+        if (add_transaction(&ctx->tx) != 0) { db_rollback_transaction(); return -1; }
+    }
+    if (db_commit_transaction() != 0) return -1;
+    TxQuery q = { .category = "Bench" };
+    return visit_transactions(&q, collect_id, ctx) == 0 && ctx->id_count > 0 ? 0 : -1;
+}
+
+static int setup_bench_budgets(BenchCtx *ctx, int iters)
+{
+    for (int i = 0; i < iters; ++i) {
+        Budget b = { .monthly_limit = 1000 };
+        snprintf(b.category, CATEGORY_LEN, "Bench budget %d", i);
+        if (add_or_update_budget(&b) != 0) return -1;
+    }
+    Budget *list = NULL;
+    int count = 0;
+    if (fetch_budgets(&list, &count) != 0) return -1;
+    free(ctx->ids);
+    ctx->id_cap = count ? count : 1;
+    ctx->ids = (int*)malloc((size_t)ctx->id_cap * sizeof(int));
+    ctx->id_count = 0;
+    for (int i = 0; ctx->ids && i < count; ++i)
+        if (strncmp(list[i].category, "Bench budget", 12) == 0) ctx->ids[ctx->id_count++] = list[i].id;
+    if (count > 0) ctx->budget = list[0];
+    free(list);
+    return ctx->ids ? 0 : -1;
+}
+
+static int setup_bench_goals(BenchCtx *ctx, int iters)
+{
+    for (int i = 0; i < iters; ++i) {
+        Goal g = { .target_amount = 100000, .monthly_saving = 5000 };
+        snprintf(g.name, NAME_LEN, "Bench goal %d", i);
+        snprintf(g.start_date, DATE_LEN, "%s", ctx->range_from);
+        if (add_goal(&g) != 0) return -1;
+    }
+    Goal *list = NULL;
+    int count = 0;
+    if (fetch_goals(&list, &count) != 0) return -1;
+    free(ctx->ids);
+    ctx->id_cap = count ? count : 1;
+    ctx->ids = (int*)malloc((size_t)ctx->id_cap * sizeof(int));
+    ctx->id_count = 0;
+    for (int i = 0; ctx->ids && i < count; ++i)
+        if (strncmp(list[i].name, "Bench goal", 10) == 0) ctx->ids[ctx->id_count++] = list[i].id;
+    if (count > 0) ctx->goal = list[0];
+    free(list);
+    return ctx->ids ? 0 : -1;
+}
+
+static int setup_bench_rules(BenchCtx *ctx, int iters)
+{
+    for (int i = 0; i < iters; ++i) {
+        RecurringTransaction rt = { .amount = 999, .is_active = 0 };
+        snprintf(rt.type, TYPE_LEN, "expense");
+        snprintf(rt.category, CATEGORY_LEN, "Bench");
+        snprintf(rt.frequency, sizeof(rt.frequency), "monthly");
+        snprintf(rt.start_date, DATE_LEN, "%s", ctx->range_from);
+        snprintf(rt.note, NOTE_LEN, "Bench rule %d", i);
+        if (add_recurring_transaction(&rt) != 0) return -1;
+    }
+    RecurringTransaction *list = NULL;
+    int count = 0;
+    if (fetch_recurring_transactions(&list, &count) != 0) return -1;
+    free(ctx->ids);
+    ctx->id_cap = count ? count : 1;
+    ctx->ids = (int*)malloc((size_t)ctx->id_cap * sizeof(int));
+    ctx->id_count = 0;
+    for (int i = 0; ctx->ids && i < count; ++i)
+        if (strncmp(list[i].note, "Bench rule", 10) == 0) ctx->ids[ctx->id_count++] = list[i].id;
+    if (ctx->id_count > 0)
+        for (int i = 0; i < count; ++i)
+            if (list[i].id == ctx->ids[0]) ctx->rule = list[i];
+    free(list);
+    return ctx->ids && ctx->id_count > 0 ? 0 : -1;
+}
+
+static int setup_chart(BenchCtx *ctx, int iters)
+{
+    (void)iters;
+    if (!ctx->surface) ctx->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, CHART_WIDTH, CHART_HEIGHT);
+    return cairo_surface_status(ctx->surface) == CAIRO_STATUS_SUCCESS ? 0 : -1;
+}
+
+/* ---- database.h ---- */
+
+static int run_init_database(BenchCtx *ctx, int i)
+{
+    (void)i;
+    close_database();
+    return init_database(ctx->db_path);
+}
+
+static int run_reader_acquire(BenchCtx *ctx, int i)
+{
+    (void)ctx; (void)i;
+    if (db_reader_acquire() != 0) return -1;
+    db_reader_release();
+    return 0;
+}
+
+static int run_begin_commit(BenchCtx *ctx, int i)
+{
+    (void)ctx; (void)i;
+    return db_begin_transaction() == 0 ? db_commit_transaction() : -1;
+}
+
+static int run_bulk_begin_commit(BenchCtx *ctx, int i)
+{
+    (void)ctx; (void)i;
+    return db_begin_bulk_transaction() == 0 ? db_commit_bulk_transaction() : -1;
+}
+
+static int run_add_transaction(BenchCtx *ctx, int i)
+{
+    bench_tx(&ctx->tx, "Bench", ctx->range_to, 500 + i);
+    return add_transaction(&ctx->tx);
+}
+
+static int run_edit_transaction(BenchCtx *ctx, int i)
+{
+    bench_tx(&ctx->tx, "Bench", ctx->range_to, 700 + i);
+    ctx->tx.id = ctx->ids[i % ctx->id_count];
+    return edit_transaction(&ctx->tx);
+}
+
+static int run_delete_transaction(BenchCtx *ctx, int i)
+{
+    return i < ctx->id_count ? delete_transaction(ctx->ids[i]) : 0;
+}
+
+static int run_fetch_page(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Transaction page[256];
+    TxCursor cursor = {0};
+    int n = 0;
+    int rc = fetch_transaction_page(NULL, &cursor, page, 256, &n);
+    ctx->sink += n;
+    return rc;
+}
+
+/* Pages spread over the ledger, each reached from the start by skipping rows */
+static int run_seek_page(BenchCtx *ctx, int i)
+{
+    Transaction page[128];
+    TxCursor cursor = {0};
+    int n = 0;
+    long skip = ctx->rows > 0 ? (long)((i * 7919L) % ctx->rows) : 0;
+    int rc = seek_transaction_page(NULL, &cursor, skip, page, 128, &n);
+    ctx->sink += n;
+    return rc;
+}
+
+static int count_visit(const Transaction *t, void *user_data)
+{
+    ((BenchCtx*)user_data)->sink += t->amount != 0;
+    return 0;
+}
+
+static int run_visit_transactions(BenchCtx *ctx, int i)
+{
+    (void)i;
+    return visit_transactions(NULL, count_visit, ctx);
+}
+
+static int finish_list(BenchCtx *ctx, int rc, Transaction *list, int count)
+{
+    ctx->sink += count;
+    free(list);
+    return rc;
+}
+
+static int run_fetch_all(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Transaction *list = NULL; int n = 0;
+    int rc = fetch_transactions_all(&list, &n);
+    return finish_list(ctx, rc, list, n);
+}
+
+static int run_fetch_by_month(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Transaction *list = NULL; int n = 0;
+    int rc = fetch_transactions_by_month(ctx->month, &list, &n);
+    return finish_list(ctx, rc, list, n);
+}
+
+static int run_fetch_by_category(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Transaction *list = NULL; int n = 0;
+    int rc = fetch_transactions_by_category(synth_rare_category, &list, &n);
+    return finish_list(ctx, rc, list, n);
+}
+
+static int run_fetch_by_date_range(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Transaction *list = NULL; int n = 0;
+    int rc = fetch_transactions_by_date_range(ctx->range_from, ctx->range_to, &list, &n);
+    return finish_list(ctx, rc, list, n);
+}
+
+static int run_fetch_search(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Transaction *list = NULL; int n = 0;
+    int rc = fetch_transactions_search("bakery", &list, &n);
+    return finish_list(ctx, rc, list, n);
+}
+
+static int run_search_transactions(BenchCtx *ctx, int i)
+{
+    static const char *const queries[] = { "coffee", "whole foods", "\"gift card\"", "hotel", "pizz" };
+    SearchHit *hits = NULL; int n = 0;
+    int rc = search_transactions(queries[i % 5], 50, &hits, &n);
+    ctx->sink += n;
+    free(hits);
+    return rc;
+}
+
+static int run_add_or_update_budget(BenchCtx *ctx, int i)
+{
+    (void)ctx;
+    Budget b = { .monthly_limit = 10000 + i };
+    snprintf(b.category, CATEGORY_LEN, "Bench");
+    return add_or_update_budget(&b);
+}
+
+static int run_get_budget(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Budget b;
+    return get_budget_by_category(synth_busy_category, &b) == 0 ? (ctx->sink += b.id, 0) : -1;
+}
+
+static int run_fetch_budgets(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Budget *list = NULL; int n = 0;
+    int rc = fetch_budgets(&list, &n);
+    ctx->sink += n;
+    free(list);
+    return rc;
+}
+
+static int run_budget_status_all(BenchCtx *ctx, int i)
+{
+    (void)i;
+    BudgetStatus *list = NULL; int n = 0;
+    int rc = fetch_budget_status(ctx->month, &list, &n);
+    ctx->sink += n;
+    free(list);
+    return rc;
+}
+
+static int run_update_budget(BenchCtx *ctx, int i)
+{
+    Budget b = ctx->budget;
+    b.monthly_limit += i % 2;
+    return update_budget(b.id, &b);
+}
+
+static int run_delete_budget(BenchCtx *ctx, int i)
+{
+    return i < ctx->id_count ? delete_budget(ctx->ids[i]) : 0;
+}
+
+static int run_add_goal(BenchCtx *ctx, int i)
+{
+    Goal g = { .target_amount = 50000 + i, .monthly_saving = 2500 };
+    snprintf(g.name, NAME_LEN, "Bench goal");
+    snprintf(g.start_date, DATE_LEN, "%s", ctx->range_from);
+    return add_goal(&g);
+}
+
+static int run_edit_goal(BenchCtx *ctx, int i)
+{
+    Goal g = ctx->goal;
+    g.monthly_saving += i % 2;
+    return edit_goal(&g);
+}
+
+static int run_fetch_goals(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Goal *list = NULL; int n = 0;
+    int rc = fetch_goals(&list, &n);
+    ctx->sink += n;
+    free(list);
+    return rc;
+}
+
+static int run_delete_goal(BenchCtx *ctx, int i)
+{
+    return i < ctx->id_count ? delete_goal(ctx->ids[i]) : 0;
+}
+
+static int run_total_by_type(BenchCtx *ctx, int i)
+{
+    ctx->sink += get_total_by_type_for_month(ctx->month, i % 2 ? "income" : "expense") != 0;
+    return 0;
+}
+
+static int run_spent_in_category(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ctx->sink += get_spent_in_category_month(synth_busy_category, ctx->month) != 0;
+    return 0;
+}
+
+static int run_count_transactions(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ctx->sink += count_transactions(NULL) > 0;
+    return 0;
+}
+
+static int run_expense_totals(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ResultSet rs;
+    if (fetch_expense_totals_by_category(ctx->month, &rs) != 0) return -1;
+    ctx->sink += rs.count;
+    result_set_free(&rs);
+    return 0;
+}
+
+static int run_rebuild_summary(BenchCtx *ctx, int i)
+{
+    (void)ctx; (void)i;
+    return rebuild_monthly_summary();
+}
+
+static int run_verify_summary(BenchCtx *ctx, int i)
+{
+    (void)ctx; (void)i;
+    return verify_monthly_summary() == 0 ? 0 : -1;
+}
+
+static int run_category_intern(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ctx->sink += category_intern(synth_busy_category);
+    return 0;
+}
+
+/* Back and forth, so an even count leaves the name as it was */
+static int run_rename_category(BenchCtx *ctx, int i)
+{
+    (void)ctx;
+    return i % 2 ? rename_category("Coffee shops", "Coffee") : rename_category("Coffee", "Coffee shops");
+}
+
+static int run_get_setting(BenchCtx *ctx, int i)
+{
+    (void)i;
+    char value[64];
+    ctx->sink += get_setting("currency", value, sizeof(value)) >= 0;
+    return 0;
+}
+
+static int run_set_setting(BenchCtx *ctx, int i)
+{
+    (void)ctx;
+    char value[32];
+    snprintf(value, sizeof(value), "%d", i);
+    return set_setting("bench_counter", value);
+}
+
+static int run_add_rule(BenchCtx *ctx, int i)
+{
+    RecurringTransaction rt = ctx->rule;
+    snprintf(rt.note, NOTE_LEN, "Bench added rule %d", i);
+    return add_recurring_transaction(&rt);
+}
+
+static int run_edit_rule(BenchCtx *ctx, int i)
+{
+    RecurringTransaction rt = ctx->rule;
+    rt.amount += i % 2;
+    return edit_recurring_transaction(&rt);
+}
+
+static int run_delete_rule(BenchCtx *ctx, int i)
+{
+    return i < ctx->id_count ? delete_recurring_transaction(ctx->ids[i]) : 0;
+}
+
+static int run_fetch_rules(BenchCtx *ctx, int i)
+{
+    RecurringTransaction *list = NULL; int n = 0;
+    int rc = i % 2 ? fetch_active_recurring_transactions(&list, &n) : fetch_recurring_transactions(&list, &n);
+    ctx->sink += n;
+    free(list);
+    return rc;
+}
+
+static int run_fetch_active_rules(BenchCtx *ctx, int i)
+{
+    (void)i;
+    RecurringTransaction *list = NULL; int n = 0;
+    int rc = fetch_active_recurring_transactions(&list, &n);
+    ctx->sink += n;
+    free(list);
+    return rc;
+}
+
+/* One new day per iteration, counting back from the range start */
+static int run_add_occurrence(BenchCtx *ctx, int i)
+{
+    int key = (day_key_from_date(ctx->range_from) / 10000 - 1 - i / 336) * 10000 + (i / 28 % 12 + 1) * 100 + i % 28 + 1;
+    char date[DATE_LEN];
+    snprintf(date, DATE_LEN, "%04d-%02d-%02d", key / 10000, key / 100 % 100, key % 100);
+    bench_tx(&ctx->tx, "Bench", date, 999);
+    return add_recurring_occurrence(ctx->rule.id, &ctx->tx) < 0 ? -1 : 0;
+}
+
+static int run_set_watermark(BenchCtx *ctx, int i)
+{
+    return set_recurring_watermark(ctx->rule.id, i % 2 ? ctx->range_from : ctx->range_to);
+}
+
+static int run_monthly_aggregate(BenchCtx *ctx, int i)
+{
+    ResultSet rs;
+    if (fetch_monthly_aggregate(12, i % 2 ? synth_busy_category : NULL, &rs) != 0) return -1;
+    ctx->sink += rs.count;
+    result_set_free(&rs);
+    return 0;
+}
+
+static int run_monthly_totals(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ResultSet rs;
+    if (get_monthly_totals(24, &rs) != 0) return -1;
+    ctx->sink += rs.count;
+    result_set_free(&rs);
+    return 0;
+}
+
+static int run_category_trends(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ResultSet rs;
+    if (get_category_trends(synth_busy_category, 24, &rs) != 0) return -1;
+    ctx->sink += rs.count;
+    result_set_free(&rs);
+    return 0;
+}
+
+static int run_after_restore(BenchCtx *ctx, int i)
+{
+    (void)ctx; (void)i;
+    return db_after_restore();
+}
+
+/* ---- analytics.h, budget.h, goal.h ---- */
+
+static int run_spending_trend(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Money avg = 0, trend = 0;
+    int rc = calculate_spending_trend(synth_busy_category, 12, &avg, &trend);
+    ctx->sink += avg != 0;
+    return rc;
+}
+
+static int run_forecast(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ResultSet rs;
+    if (generate_forecast(6, &rs) != 0) return -1;
+    ctx->sink += rs.count;
+    result_set_free(&rs);
+    return 0;
+}
+
+static int run_category_average(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ctx->sink += calculate_category_average(synth_busy_category, 6) != 0;
+    return 0;
+}
+
+static int run_budget_alerts(BenchCtx *ctx, int i)
+{
+    (void)i;
+    ResultSet rs;
+    if (check_budget_alerts(&rs) != 0) return -1;
+    ctx->sink += rs.count;
+    result_set_free(&rs);
+    return 0;
+}
+
+static int run_budget_status(BenchCtx *ctx, int i)
+{
+    (void)i;
+    Money spent, limit;
+    double progress;
+    int rc = check_budget_status(synth_busy_category, ctx->month, &spent, &limit, &progress);
+    ctx->sink += spent != 0;
+    return rc < 0 ? -1 : 0;
+}
+
+static int run_goal_projection(BenchCtx *ctx, int i)
+{
+    Goal g = ctx->goal;
+    g.monthly_saving = 1000 + i % 5000;
+    int months = 0;
+    char date[DATE_LEN];
+    int rc = calculate_goal_projection(&g, &months, date);
+    ctx->sink += months;
+    return rc;
+}
+
+/* ---- chart.h, drawn offscreen ---- */
+
+static int draw_and_flush(BenchCtx *ctx, int which)
+{
+    cairo_t *cr = cairo_create(ctx->surface);
+    switch (which) {
+    case 0: draw_expense_chart(cr, CHART_WIDTH, CHART_HEIGHT, ctx->month); break;
+    case 1: draw_bar_chart(cr, CHART_WIDTH, CHART_HEIGHT, 12); break;
+    case 2: draw_line_chart(cr, CHART_WIDTH, CHART_HEIGHT, synth_busy_category, 12); break;
+    default: draw_forecast_chart(cr, CHART_WIDTH, CHART_HEIGHT, 6); break;
+    }
+    cairo_destroy(cr);
+    cairo_surface_flush(ctx->surface);
+    return 0;
+}
+
+static int run_expense_chart(BenchCtx *ctx, int i) { (void)i; return draw_and_flush(ctx, 0); }
+static int run_bar_chart(BenchCtx *ctx, int i) { (void)i; return draw_and_flush(ctx, 1); }
+static int run_line_chart(BenchCtx *ctx, int i) { (void)i; return draw_and_flush(ctx, 2); }
+static int run_forecast_chart(BenchCtx *ctx, int i) { (void)i; return draw_and_flush(ctx, 3); }
+
+/* Order matters where a setup makes rows for the cases after it */
+static const BenchCase k_cases[] = {
+    { "init_database",                       "database", NULL, run_init_database, 5 },
+    { "db_reader_acquire+release",           "database", NULL, run_reader_acquire, 0 },
+    { "db_begin+commit_transaction",         "database", NULL, run_begin_commit, 0 },
+    { "db_begin+commit_bulk_transaction",    "database", NULL, run_bulk_begin_commit, 200 },
+    { "add_transaction",                     "database", NULL, run_add_transaction, 0 },
+    { "edit_transaction",                    "database", setup_bench_rows, run_edit_transaction, 0 },
+    { "delete_transaction",                  "database", setup_bench_rows, run_delete_transaction, 0 },
+    { "fetch_transaction_page",              "database", NULL, run_fetch_page, 0 },
+    { "seek_transaction_page",               "database", NULL, run_seek_page, 0 },
+    { "visit_transactions",                  "database", NULL, run_visit_transactions, 5 },
+    { "fetch_transactions_all",              "database", NULL, run_fetch_all, 5 },
+    { "fetch_transactions_by_month",         "database", NULL, run_fetch_by_month, 50 },
+    { "fetch_transactions_by_category",      "database", NULL, run_fetch_by_category, 20 },
+    { "fetch_transactions_by_date_range",    "database", NULL, run_fetch_by_date_range, 50 },
+    { "fetch_transactions_search",           "database", NULL, run_fetch_search, 5 },
+    { "search_transactions",                 "database", NULL, run_search_transactions, 0 },
+    { "add_or_update_budget",                "database", NULL, run_add_or_update_budget, 0 },
+    { "get_budget_by_category",              "database", NULL, run_get_budget, 0 },
+    { "fetch_budgets",                       "database", NULL, run_fetch_budgets, 0 },
+    { "fetch_budget_status",                 "database", NULL, run_budget_status_all, 0 },
+    { "update_budget",                       "database", setup_bench_budgets, run_update_budget, 0 },
+    { "delete_budget",                       "database", setup_bench_budgets, run_delete_budget, 500 },
+    { "add_goal",                            "database", NULL, run_add_goal, 500 },
+    { "edit_goal",                           "database", setup_bench_goals, run_edit_goal, 0 },
+    { "fetch_goals",                         "database", NULL, run_fetch_goals, 0 },
+    { "delete_goal",                         "database", setup_bench_goals, run_delete_goal, 1000 },
+    { "get_total_by_type_for_month",         "database", NULL, run_total_by_type, 0 },
+    { "get_spent_in_category_month",         "database", NULL, run_spent_in_category, 0 },
+    { "count_transactions",                  "database", NULL, run_count_transactions, 0 },
+    { "fetch_expense_totals_by_category",    "database", NULL, run_expense_totals, 0 },
+    { "rebuild_monthly_summary",             "database", NULL, run_rebuild_summary, 3 },
+    { "verify_monthly_summary",              "database", NULL, run_verify_summary, 3 },
+    { "category_intern",                     "database", NULL, run_category_intern, 0 },
+    { "rename_category",                     "database", NULL, run_rename_category, 4 },
+    { "get_setting",                         "database", NULL, run_get_setting, 0 },
+    { "set_setting",                         "database", NULL, run_set_setting, 0 },
+    { "add_recurring_transaction",           "database", setup_bench_rules, run_add_rule, 500 },
+    { "edit_recurring_transaction",          "database", setup_bench_rules, run_edit_rule, 0 },
+    { "fetch_recurring_transactions",        "database", NULL, run_fetch_rules, 0 },
+    { "fetch_active_recurring_transactions", "database", NULL, run_fetch_active_rules, 0 },
+    { "add_recurring_occurrence",            "database", setup_bench_rules, run_add_occurrence, 1000 },
+    { "set_recurring_watermark",             "database", setup_bench_rules, run_set_watermark, 0 },
+    { "delete_recurring_transaction",        "database", setup_bench_rules, run_delete_rule, 1000 },
+    { "fetch_monthly_aggregate",             "database", NULL, run_monthly_aggregate, 0 },
+    { "get_monthly_totals",                  "database", NULL, run_monthly_totals, 0 },
+    { "get_category_trends",                 "database", NULL, run_category_trends, 0 },
+    { "db_after_restore",                    "database", NULL, run_after_restore, 20 },
+    { "calculate_spending_trend",            "analytics", NULL, run_spending_trend, 0 },
+    { "generate_forecast",                   "analytics", NULL, run_forecast, 0 },
+    { "calculate_category_average",          "analytics", NULL, run_category_average, 0 },
+    { "check_budget_alerts",                 "analytics", NULL, run_budget_alerts, 0 },
+    { "check_budget_status",                 "budget", NULL, run_budget_status, 0 },
+    { "calculate_goal_projection",           "goal", setup_bench_goals, run_goal_projection, 0 },
+    { "draw_expense_chart",                  "chart", setup_chart, run_expense_chart, 200 },
+    { "draw_bar_chart",                      "chart", setup_chart, run_bar_chart, 200 },
+    { "draw_line_chart",                     "chart", setup_chart, run_line_chart, 200 },
+    { "draw_forecast_chart",                 "chart", setup_chart, run_forecast_chart, 200 },
+};
+#define N_CASES ((int)(sizeof(k_cases) / sizeof(k_cases[0])))
+
+typedef struct BenchResult {
+    int iterations;
+    double total_ms, mean_us, min_us, p50_us, p95_us, max_us;
+    const char *error;        /* NULL when the case ran */
+} BenchResult;
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_case(const BenchCase *c, BenchCtx *ctx, BenchResult *out)
+{
+    memset(out, 0, sizeof(*out));
+    int cap = c->max_iters ? c->max_iters : BENCH_DEFAULT_ITERS;
+    if (strcmp(c->name, "fetch_transactions_all") == 0 && ctx->rows > BENCH_MAX_MATERIALIZE) {
+        out->error = "skipped: ledger too large to hold in memory";
+        return;
+    }
+    if (c->setup && c->setup(ctx, cap) != 0) { out->error = "setup failed"; return; }
+    uint64_t *samples = (uint64_t*)malloc((size_t)cap * sizeof(uint64_t));
+    if (!samples) { out->error = "out of memory"; return; }
+    uint64_t budget = (uint64_t)(BENCH_MIN_SECONDS * 1e9), spent = 0;
+    int n = 0;
+    while (n < cap && (n == 0 || spent < budget)) {
+        uint64_t t0 = profile_now_ns();
+        int rc = c->run(ctx, n);
+        uint64_t dt = profile_now_ns() - t0;
+        if (rc != 0) { out->error = "call failed"; break; }
+        samples[n++] = dt;
+        spent += dt;
+    }
+    if (n > 0) {
+        qsort(samples, n, sizeof(uint64_t), cmp_u64);
+        out->iterations = n;
+        out->total_ms = spent / 1e6;
+        out->mean_us = spent / 1e3 / n;
+        out->min_us = samples[0] / 1e3;
+        out->p50_us = samples[(n - 1) / 2] / 1e3;
+        out->p95_us = samples[(int)((n - 1) * 0.95)] / 1e3;
+        out->max_us = samples[n - 1] / 1e3;
+    }
+    free(samples);
+}
+
+static long parse_count(const char *s)
+{
+    char *end = NULL;
+    double v = strtod(s, &end);
+    if (end && (*end == 'k' || *end == 'K')) v *= 1e3;
+    else if (end && (*end == 'm' || *end == 'M')) v *= 1e6;
+    return (long)v;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [--rows N] [--seed S] [--months M] [--db PATH] [--reuse] [--out FILE] [--filter TEXT]\n"
+        "  --rows    ledger size, %ld to %ld (k and M suffixes work; default 100k)\n"
+        "  --reuse   keep an existing database instead of generating a fresh one\n"
+        "  --filter  only run cases whose name contains TEXT\n", argv0, SYNTH_MIN_ROWS, SYNTH_MAX_ROWS);
+}
+
+int main(int argc, char **argv)
+{
+    SynthConfig cfg = { .rows = 100000, .seed = 42, .months = 60 };
+    const char *db_path = "bench.db", *out_path = NULL, *filter = NULL;
+    int reuse = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--reuse") == 0) { reuse = 1; continue; }
+        if (!v) { usage(argv[0]); return 2; }
+        if (strcmp(a, "--rows") == 0) cfg.rows = parse_count(v);
+        else if (strcmp(a, "--seed") == 0) cfg.seed = strtoull(v, NULL, 10);
+        else if (strcmp(a, "--months") == 0) cfg.months = atoi(v);
+        else if (strcmp(a, "--db") == 0) db_path = v;
+        else if (strcmp(a, "--out") == 0) out_path = v;
+        else if (strcmp(a, "--filter") == 0) filter = v;
+        else { usage(argv[0]); return 2; }
+        ++i;
+    }
+    if (cfg.rows < SYNTH_MIN_ROWS || cfg.rows > SYNTH_MAX_ROWS || cfg.months < 1 || cfg.months > 600) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *probe = fopen(db_path, "rb");
+    int exists = probe != NULL;
+    if (probe) fclose(probe);
+    if (exists && !reuse) {
+        char side[1024];
+        remove(db_path);
+        snprintf(side, sizeof(side), "%s-wal", db_path); remove(side);
+        snprintf(side, sizeof(side), "%s-shm", db_path); remove(side);
+    }
+    if (init_database(db_path) != 0) { fprintf(stderr, "cannot open %s\n", db_path); return 1; }
+
+    double generate_s = 0;
+    long generated = 0;
+    if (!(exists && reuse)) {
+        fprintf(stderr, "generating %ld rows (seed %llu, %d months)...\n", cfg.rows, (unsigned long long)cfg.seed, cfg.months);
+        uint64_t t0 = profile_now_ns();
+        generated = synth_generate(&cfg);
+        generate_s = (profile_now_ns() - t0) / 1e9;
+        if (generated < 0) { fprintf(stderr, "generation failed\n"); close_database(); return 1; }
+    }
+
+    BenchCtx ctx = { .rows = cfg.rows, .db_path = db_path };
+    get_current_yyyymm(ctx.month);
+    get_current_yyyymmdd(ctx.range_to);
+    snprintf(ctx.range_from, DATE_LEN, "%.7s-01", ctx.month);
+
+    BenchResult results[N_CASES];
+    int ran[N_CASES] = {0};
+    for (int i = 0; i < N_CASES; ++i) {
+        if (filter && !strstr(k_cases[i].name, filter)) continue;
+        run_case(&k_cases[i], &ctx, &results[i]);
+        ran[i] = 1;
+        if (results[i].error) fprintf(stderr, "%-38s %s\n", k_cases[i].name, results[i].error);
+        else fprintf(stderr, "%-38s %7d x  p50 %10.1f us  p95 %10.1f us\n",
+                     k_cases[i].name, results[i].iterations, results[i].p50_us, results[i].p95_us);
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) { fprintf(stderr, "cannot write %s\n", out_path); close_database(); return 1; }
+    fprintf(out, "{\n  \"rows\": %ld,\n  \"seed\": %llu,\n  \"months\": %d,\n  \"sqlite_version\": \"%s\",\n",
+            cfg.rows, (unsigned long long)cfg.seed, cfg.months, sqlite3_libversion());
+    fprintf(out, "  \"generate\": {\"rows\": %ld, \"seconds\": %.3f, \"rows_per_sec\": %.0f},\n",
+            generated, generate_s, generate_s > 0 ? generated / generate_s : 0.0);
+    fprintf(out, "  \"results\": [");
+    int first = 1;
+    for (int i = 0; i < N_CASES; ++i) {
+        if (!ran[i]) continue;
+        const BenchResult *r = &results[i];
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"group\": \"%s\", ", first ? "" : ",", k_cases[i].name, k_cases[i].group);
+        if (r->error) fprintf(out, "\"error\": \"%s\"}", r->error);
+        else fprintf(out, "\"iterations\": %d, \"total_ms\": %.3f, \"mean_us\": %.2f, \"min_us\": %.2f, "
+                          "\"p50_us\": %.2f, \"p95_us\": %.2f, \"max_us\": %.2f}",
+                     r->iterations, r->total_ms, r->mean_us, r->min_us, r->p50_us, r->p95_us, r->max_us);
+        first = 0;
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) fclose(out);
+
+    if (ctx.surface) cairo_surface_destroy(ctx.surface);
+    free(ctx.ids);
+    close_database();
+    return 0;
+}
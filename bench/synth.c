@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "synth.h"
+#include "database.h"
+
+#define SYNTH_COMMIT_ROWS 200000L  /* rows per bulk transaction, so the WAL stays bounded */
+#define SYNTH_INCOME_SHARE 0.02    /* of the day-to-day rows */
+
+typedef struct Rng { uint64_t state; } Rng;
+
+/* splitmix64: tiny, fast and identical on every platform */
+static uint64_t rng_next(Rng *r)
+{
+    uint64_t z = (r->state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static double rng_unit(Rng *r)
+{
+    return (double)(rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int rng_below(Rng *r, int n)
+{
+    return (int)(rng_unit(r) * n);
+}
+
+static double rng_normal(Rng *r)
+{
+    double u = rng_unit(r), v = rng_unit(r);
+    if (u < 1e-300) u = 1e-300;
+    return sqrt(-2.0 * log(u)) * cos(2.0 * 3.14159265358979323846 * v);
+}
+
+typedef struct SpendCategory {
+    const char *name;
+    double weight;
+    double median;                /* in currency units */
+    double sigma;                 /* spread of the log-normal amount */
+    const char *merchants[5];
+} SpendCategory;
+
+static const SpendCategory k_spend[] = {
+    { "Groceries",     28, 42.0,  0.6, { "Whole Foods Market", "Trader Joe's", "Aldi", "Costco", "Farmers market" } },
+    { "Dining",        16, 24.0,  0.7, { "Thai Basil", "Pizzeria Roma", "Burger Barn", "Sushi Go", "Taco Stand" } },
+    { "Transport",     14, 18.0,  0.8, { "Metro card top-up", "Shell fuel", "Uber ride", "Parking garage", "Bike repair" } },
+    { "Shopping",      10, 55.0,  0.9, { "Amazon order", "Target", "IKEA", "Electronics store", "Bookshop" } },
+    { "Coffee",         9,  4.8,  0.3, { "Blue Bottle coffee", "Starbucks", "Corner cafe", "Espresso bar", "Bakery" } },
+    { "Entertainment",  7, 22.0,  0.7, { "Cinema tickets", "Concert", "Bowling night", "Museum", "Game store" } },
+    { "Utilities",      6, 65.0,  0.4, { "Electricity bill", "Water bill", "Gas bill", "Internet", "Trash service" } },
+    { "Health",         4, 35.0,  0.8, { "Pharmacy", "Dentist copay", "Doctor visit", "Optician", "Vitamins" } },
+    { "Travel",         4, 140.0, 1.0, { "Airline ticket", "Hotel stay", "Car rental", "Train ticket", "Travel insurance" } },
+    { "Gifts",          2, 45.0,  0.8, { "Birthday present", "Flowers", "Wedding gift", "Holiday gifts", "Gift card" } },
+};
+#define N_SPEND ((int)(sizeof(k_spend) / sizeof(k_spend[0])))
+
+const char *const synth_busy_category = "Groceries";
+const char *const synth_rare_category = "Gifts";
+
+static const struct { const char *name; double median; const char *merchants[3]; } k_income[] = {
+    { "Freelance", 650.0, { "Freelance invoice", "Consulting day", "Design project" } },
+    { "Refunds",    38.0, { "Store refund", "Deposit returned", "Overcharge refund" } },
+    { "Interest",   12.0, { "Savings interest", "Cashback reward", "Dividend" } },
+};
+#define N_INCOME ((int)(sizeof(k_income) / sizeof(k_income[0])))
+
+/* Monthly rules, materialized as occurrences of a recurring rule */
+static const struct { const char *type, *category, *note; double amount; int day; } k_recurring[] = {
+    { "income",  "Salary",        "Monthly salary",     4200.00, 25 },
+    { "expense", "Housing",       "Rent",               1450.00,  1 },
+    { "expense", "Subscriptions", "Streaming service",    15.99, 12 },
+    { "expense", "Subscriptions", "Phone plan",           45.00,  5 },
+    { "expense", "Health",        "Gym membership",       39.00,  3 },
+};
+#define N_RECURRING ((int)(sizeof(k_recurring) / sizeof(k_recurring[0])))
+
+/* Spending rises towards the holidays and over the summer and dips in January */
+static const double k_season[12] = { 0.85, 0.9, 0.95, 1.0, 1.0, 1.05, 1.15, 1.15, 1.0, 1.0, 1.1, 1.35 };
+
+static double category_boost(const char *name, int month)
+{
+    if (strcmp(name, "Travel") == 0 && (month == 7 || month == 8 || month == 12)) return 3.0;
+    if (strcmp(name, "Gifts") == 0 && month == 12) return 5.0;
+    return 1.0;
+}
+
+static int is_leap(int y)
+{
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+static int month_days(int y, int m)
+{
+    static const int dim[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    return m == 2 && is_leap(y) ? 29 : dim[m - 1];
+}
+
+/* 0 = Sunday (Sakamoto) */
+static int weekday(int y, int m, int d)
+{
+    static const int t[12] = {0,3,2,5,0,3,5,1,4,6,2,4};
+    if (m < 3) y -= 1;
+    return (y + y / 4 - y / 100 + y / 400 + t[m - 1] + d) % 7;
+}
+
+static Money amount_near(Rng *r, double median, double sigma)
+{
+    double v = median * exp(sigma * rng_normal(r));
+    if (v < 0.5) v = 0.5;
+    return money_from_double(v);
+}
+
+typedef struct Day { int y, m, d; double weight; } Day;
+
+/* Through a YYYYMMDD key, as recurring.c does, so each field has a known width */
+static void format_date(char out[DATE_LEN], int y, int m, int d)
+{
+    int key = y * 10000 + m * 100 + d;
+    snprintf(out, DATE_LEN, "%04d-%02d-%02d", key / 10000, key / 100 % 100, key % 100);
+}
+
+static void fill_tx(Transaction *t, const char *type, const char *category, Money amount, const Day *day, const char *note)
+{
+    snprintf(t->type, TYPE_LEN, "%s", type);
+    snprintf(t->category, CATEGORY_LEN, "%s", category);
+    t->amount = amount;
+    format_date(t->date, day->y, day->m, day->d);
+    snprintf(t->note, NOTE_LEN, "%s", note);
+}
+
+static int add_rules(const Day *first, int rule_ids[N_RECURRING])
+{
+    for (int i = 0; i < N_RECURRING; ++i) {
+        RecurringTransaction rt = {0};
+        snprintf(rt.type, TYPE_LEN, "%s", k_recurring[i].type);
+        snprintf(rt.category, CATEGORY_LEN, "%s", k_recurring[i].category);
+        rt.amount = money_from_double(k_recurring[i].amount);
+        snprintf(rt.frequency, sizeof(rt.frequency), "monthly");
+        format_date(rt.start_date, first->y, first->m, k_recurring[i].day);
+        snprintf(rt.note, NOTE_LEN, "%s", k_recurring[i].note);
+        rt.is_active = 1;
+        if (add_recurring_transaction(&rt) != 0) return -1;
+    }
+    RecurringTransaction *list = NULL;
+    int count = 0;
+    if (fetch_recurring_transactions(&list, &count) != 0) return -1;
+    for (int i = 0; i < N_RECURRING; ++i) {
+        rule_ids[i] = 0;
+        for (int j = 0; j < count && !rule_ids[i]; ++j)
+            if (strcmp(list[j].note, k_recurring[i].note) == 0) rule_ids[i] = list[j].id;
+    }
+    free(list);
+    return 0;
+}
+
+static int add_budgets_and_goals(long spend_rows, int months, const Day *first)
+{
+    double total_weight = 0;
+    for (int i = 0; i < N_SPEND; ++i) total_weight += k_spend[i].weight;
+    for (int i = 0; i < N_SPEND; ++i) {
+        /* about 10% above the category's average month, rounded to tens */
+        double per_month = spend_rows / (double)months * k_spend[i].weight / total_weight;
+        double mean = k_spend[i].median * exp(k_spend[i].sigma * k_spend[i].sigma / 2);
+        Budget b = {0};
+        snprintf(b.category, CATEGORY_LEN, "%s", k_spend[i].name);
+        b.monthly_limit = money_from_double(ceil(per_month * mean * 1.1 / 10.0) * 10.0);
+        if (add_or_update_budget(&b) != 0) return -1;
+    }
+    Budget rent = { .monthly_limit = money_from_double(1500.0) };
+    snprintf(rent.category, CATEGORY_LEN, "Housing");
+    if (add_or_update_budget(&rent) != 0) return -1;
+
+    static const struct { const char *name; double target, monthly; } goals[] = {
+        { "Emergency fund", 15000.0, 500.0 },
+        { "Summer vacation", 4000.0, 250.0 },
+        { "New car", 22000.0, 600.0 },
+    };
+    for (int i = 0; i < 3; ++i) {
+        Goal g = {0};
+        snprintf(g.name, NAME_LEN, "%s", goals[i].name);
+        g.target_amount = money_from_double(goals[i].target);
+        g.monthly_saving = money_from_double(goals[i].monthly);
+        format_date(g.start_date, first->y, first->m, 1);
+        if (add_goal(&g) != 0) return -1;
+    }
+    return 0;
+}
+
+long synth_generate(const SynthConfig *cfg)
+{
+    if (cfg->rows < 1 || cfg->months < 1) return -1;
+    char today[DATE_LEN];
+    get_current_yyyymmdd(today);
+    int today_key = day_key_from_date(today);
+    int ty = today_key / 10000, tm = today_key / 100 % 100;
+
+    /* every day of the span up to today, weighted by season and weekday */
+    long total_months = (long)ty * 12 + (tm - 1) - (cfg->months - 1);
+    Day first = { (int)(total_months / 12), (int)(total_months % 12) + 1, 1, 0 };
+    Day *days = (Day*)malloc((size_t)cfg->months * 31 * sizeof(Day));
+    if (!days) return -1;
+    int ndays = 0;
+    double total_weight = 0;
+    for (int y = first.y, m = first.m; y * 100 + m <= ty * 100 + tm; m == 12 ? (y++, m = 1) : m++) {
+        for (int d = 1; d <= month_days(y, m) && y * 10000 + m * 100 + d <= today_key; ++d) {
+            int wd = weekday(y, m, d);
+            Day *day = &days[ndays++];
+            day->y = y; day->m = m; day->d = d;
+            day->weight = k_season[m - 1] * (wd == 0 || wd == 6 ? 1.3 : 1.0);
+            total_weight += day->weight;
+        }
+    }
+
+    /* recurring occurrences first, the rest is spread over the days by weight */
+    long recurring_rows = 0;
+    for (int i = 0; i < ndays; ++i)
+        for (int r = 0; r < N_RECURRING; ++r) recurring_rows += days[i].d == k_recurring[r].day;
+    long daily_rows = cfg->rows > recurring_rows ? cfg->rows - recurring_rows : 0;
+
+    Rng rng = { cfg->seed };
+    int rule_ids[N_RECURRING];
+    if (add_rules(&first, rule_ids) != 0 || add_budgets_and_goals(daily_rows, cfg->months, &first) != 0) {
+        free(days);
+        return -1;
+    }
+
+    long written = 0, daily_written = 0;
+    double expected = 0;
+    int failed = db_begin_bulk_transaction() != 0;
+    for (int i = 0; i < ndays && !failed; ++i) {
+        const Day *day = &days[i];
+        Transaction t = {0};
+        for (int r = 0; r < N_RECURRING && !failed; ++r) {
+            if (day->d != k_recurring[r].day || written >= cfg->rows) continue;
+            double amount = k_recurring[r].amount;
+            if (strcmp(k_recurring[r].category, "Salary") == 0)
+                amount *= pow(1.03, (double)(i / 365));  /* yearly raise */
+            fill_tx(&t, k_recurring[r].type, k_recurring[r].category, money_from_double(amount), day, k_recurring[r].note);
+            failed = add_recurring_occurrence(rule_ids[r], &t) < 0;
+            written++;
+        }
+
+        /* a running target keeps the total exact however the weights round */
+        expected += daily_rows * day->weight / total_weight;
+        long n = i == ndays - 1 ? daily_rows - daily_written : (long)expected - daily_written;
+        double month_weight = 0;
+        for (int c = 0; c < N_SPEND; ++c) month_weight += k_spend[c].weight * category_boost(k_spend[c].name, day->m);
+        for (long k = 0; k < n && !failed; ++k, ++daily_written) {
+            if (rng_unit(&rng) < SYNTH_INCOME_SHARE) {
+                int c = rng_below(&rng, N_INCOME);
+                fill_tx(&t, "income", k_income[c].name, amount_near(&rng, k_income[c].median, 0.6), day,
+                        k_income[c].merchants[rng_below(&rng, 3)]);
+            } else {
+                double pick = rng_unit(&rng) * month_weight;
+                int c = 0;
+                while (c < N_SPEND - 1 && (pick -= k_spend[c].weight * category_boost(k_spend[c].name, day->m)) >= 0) c++;
+                fill_tx(&t, "expense", k_spend[c].name, amount_near(&rng, k_spend[c].median, k_spend[c].sigma), day,
+                        k_spend[c].merchants[rng_below(&rng, 5)]);
+            }
+            failed = add_transaction(&t) != 0;
+            if (++written % SYNTH_COMMIT_ROWS == 0 && !failed)
+                failed = db_commit_bulk_transaction() != 0 || db_begin_bulk_transaction() != 0;
+        }
+    }
+    if (failed) {
+        db_rollback_transaction();
+        free(days);
+        return -1;
+    }
+    if (db_commit_bulk_transaction() != 0) { free(days); return -1; }
+
+    /* the rules are caught up to today */
+    for (int r = 0; r < N_RECURRING; ++r) {
+        int last = -1;
+        for (int i = 0; i < ndays; ++i)
+            if (days[i].d == k_recurring[r].day) last = i;
+        if (last < 0) continue;
+        char date[DATE_LEN];
+        format_date(date, days[last].y, days[last].m, days[last].d);
+        if (set_recurring_watermark(rule_ids[r], date) != 0) { free(days); return -1; }
+    }
+    free(days);
+    return written;
+}
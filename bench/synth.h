@@ -0,0 +1,28 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdint.h>
+
+/* Synthetic ledger for benchmarks. The same seed, size and span always produce
+ * the same rows; dates are laid out backwards from today so the month-relative
+ * reports and forecasts have data to work on. */
+typedef struct SynthConfig {
+    long rows;        /* transactions to write, recurring ones included */
+    uint64_t seed;
+    int months;       /* span ending in the current month */
+} SynthConfig;
+
+#define SYNTH_MIN_ROWS 10000L
+#define SYNTH_MAX_ROWS 10000000L
+
+/* Fill the open, empty database: monthly salary, rent and subscriptions as
+ * recurring rules with their occurrences, day-to-day spending weighted by
+ * weekday and season, plus a budget per spending category and a few goals.
+ * Returns the number of transactions written, or -1. */
+long synth_generate(const SynthConfig *cfg);
+
+/* Categories the generator uses, busiest first; handy for picking query arguments */
+extern const char *const synth_busy_category;
+extern const char *const synth_rare_category;
+
+#endif /* SYNTH_H */
@@ -4,12 +4,14 @@
 #include "utils.h"
 
 /* Financial forecasting and trend analysis */
-int calculate_spending_trend(const char *category, int months_back, double *out_avg, double *out_trend);
-int generate_forecast(int months_ahead, Forecast **out_forecasts, int *out_count);
-double calculate_category_average(const char *category, int months_back);
+int calculate_spending_trend(const char *category, int months_back, Money *out_avg, Money *out_trend);
+/* Rows are the coming months (YYYY-MM); columns RS_INCOME, RS_EXPENSE, RS_BALANCE */
+int generate_forecast(int months_ahead, ResultSet *out);
+Money calculate_category_average(const char *category, int months_back);
 
 /* Budget alerts */
-int check_budget_alerts(char ***out_categories, double **out_percentages, int *out_count);
+/* Rows are categories at 80% of their budget or more; real holds the percentage used */
+int check_budget_alerts(ResultSet *out);
 
 #endif /* ANALYTICS_H */
 
@@ -0,0 +1,19 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include "utils.h"
+
+/* A zeroed Arena is empty and ready to use. Allocations are zeroed and
+ * 16-byte aligned; there is no per-allocation free. */
+void *arena_alloc(Arena *a, size_t size);
+char *arena_strdup(Arena *a, const char *s);
+void arena_free(Arena *a);
+
+/* Start an empty result set with room for capacity rows. with_real adds the real column. */
+int result_set_init(ResultSet *rs, int capacity, int money_columns, int with_real);
+/* Append a row with zeroed columns; returns its index, or -1 when out of memory. */
+int result_set_add_row(ResultSet *rs, const char *label);
+void result_set_free(ResultSet *rs);
+
+#endif /* ARENA_H */
@@ -0,0 +1,33 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include "utils.h"
+
+/* Online backups through SQLite's backup API. The copy is taken from the writer
+ * connection a batch of pages at a time, so the caller can interleave it with
+ * other work (the GUI steps it from an idle source). Writes made meanwhile on
+ * that connection are carried into the copy; a commit from the write queue's
+ * connection restarts it at the next step. Main thread only. */
+#define BACKUP_PAGES_PER_STEP 256
+#define BACKUP_DEFAULT_GENERATIONS 5
+
+typedef struct BackupJob BackupJob;
+
+/* Start copying into a temporary file next to path. Returns NULL on error. */
+BackupJob *backup_begin(const char *path, int generations);
+/* Copy the next batch: 1 while pages remain, 0 once the copy is complete, -1 on error */
+int backup_step(BackupJob *job);
+void backup_progress(const BackupJob *job, int *pages_done, int *pages_total);
+/* Release the job. A complete copy is rotated in as path, older ones shift to
+ * path.1 .. path.N-1 and the oldest is dropped; anything else is discarded and
+ * returns -1. */
+int backup_finish(BackupJob *job);
+/* The whole sequence in one call */
+int backup_database(const char *path, int generations);
+
+/* Replace the open database with a backup after checking its integrity, then bring
+ * the schema up to date and reload the caches. Returns 0 on success, 1 if path is
+ * not a usable backup, -1 if the copy itself failed. */
+int backup_restore(const char *path);
+
+#endif /* BACKUP_H */
@@ -0,0 +1,28 @@
+#ifndef CATEGORY_H
+#define CATEGORY_H
+
+#include "utils.h"
+
+/* Process-wide interner mirroring the categories table: O(1) name <-> id in
+ * both directions. database.c keeps it in sync; everything else only reads.
+ * Thread-safe. Ids are the table's integer keys and are always > 0. */
+void category_interner_clear(void);
+int category_interner_add(int id, const char *name);
+int category_interner_rename(int id, const char *name);
+void category_interner_remove(int id);
+
+/* One category created, renamed or removed inside a transaction. */
+typedef struct CategoryChange {
+    int id;
+    int removed;
+    char name[CATEGORY_LEN];
+} CategoryChange;
+
+/* Publishes a committed transaction's changes under one lock, so readers
+ * see all of them or none. */
+int category_interner_apply(const CategoryChange *changes, int count);
+
+int category_lookup(const char *name);                   /* 0 when unknown */
+int category_name(int id, char *out_name, int out_size);  /* 0 on success, 1 when unknown */
+
+#endif /* CATEGORY_H */
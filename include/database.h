@@ -3,16 +3,60 @@
 
 #include "utils.h"
 
+/* Every function below that touches the database is timed under its own name,
+ * and each cached statement under "sql:<name>" (profile.h). */
+
 /* Database lifecycle */
 int init_database(const char *db_path);
 void close_database(void);
 
+/* Read-only connection pool for worker threads. While a thread holds a reader,
+ * every query in this module it makes runs on that connection; writes fail.
+ * acquire blocks until one is free and returns -1 if the pool is empty. */
+#define DB_READER_POOL_SIZE 3
+int db_reader_acquire(void);
+void db_reader_release(void);
+/* The same for one background writer thread, on a second read-write connection:
+ * SQLite serializes its commits with the main writer's. -1 if already taken. */
+int db_writer_thread_attach(void);
+void db_writer_thread_detach(void);
+
+/* The writer's SQLite handle, for modules driving APIs this one does not wrap (backup.c) */
+struct sqlite3 *db_writer_handle(void);
+/* After the file's contents were replaced underneath the writer: migrate and reload caches */
+int db_after_restore(void);
+
+/* Explicit transactions: batch writes into one commit, or pin a reader to one snapshot */
+int db_begin_transaction(void);
+int db_commit_transaction(void);
+int db_rollback_transaction(void);
+/* Same, for loading many transactions: search indexing and monthly_summary upkeep
+ * for new rows are deferred to the commit, so only insert inside one. Writer
+ * connections only (the main one or db_writer_thread_attach's); end it with
+ * db_commit_bulk_transaction or db_rollback_transaction. A failed bulk commit has
+ * already rolled back unless the COMMIT itself failed; roll back anyway. */
+int db_begin_bulk_transaction(void);
+int db_commit_bulk_transaction(void);
+
 /* Transaction CRUD */
 int add_transaction(const Transaction *t);
 int edit_transaction(const Transaction *t);
 int delete_transaction(int id);
 
 /* Transaction queries */
+/* Streaming: fill at most max rows after *cursor and advance it; *out_count 0 means the end.
+ * Statements are reset between pages, so visitors may call back into this module.
+ * A visitor returns non-zero to stop early; visit_transactions then returns that value. */
+typedef int (*TransactionVisitor)(const Transaction *t, void *user_data);
+int fetch_transaction_page(const TxQuery *q, TxCursor *cursor, Transaction *out, int max, int *out_count);
+/* The same, after first passing over skip rows: one walk of the order's index, so a
+ * position far from any cursor can be reached without reading the rows before it. */
+int seek_transaction_page(const TxQuery *q, TxCursor *cursor, long skip, Transaction *out, int max, int *out_count);
+int visit_transactions(const TxQuery *q, TransactionVisitor visit, void *user_data);
+/* Page boundaries in one pass: out[k] is the cursor after row (k + 1) * stride - 1
+ * of q's order, i.e. the one that starts page k + 1 of stride rows. At most max. */
+int fetch_page_anchors(const TxQuery *q, int stride, TxCursor *out, long max, long *out_count);
+/* Whole result set in one array, for callers that need random access */
 int fetch_transactions_all(Transaction **out_list, int *out_count);
 int fetch_transactions_by_month(const char *yyyymm, Transaction **out_list, int *out_count);
 
@@ -22,6 +66,11 @@ int get_budget_by_category(const char *category, Budget *out_budget);
 int fetch_budgets(Budget **out_list, int *out_count);
 int delete_budget(int id);
 int update_budget(int id, const Budget *b);
+/* Every budget with its spending in yyyymm, ordered by category: one query over
+ * the monthly summaries however many budgets there are. */
+int fetch_budget_status(const char *yyyymm, BudgetStatus **out_list, int *out_count);
+/* The same for one category's budget; 1 when it has none */
+int get_budget_status(const char *category, const char *yyyymm, BudgetStatus *out);
 
 /* Goals */
 int add_goal(const Goal *g);
@@ -30,9 +79,22 @@ int delete_goal(int id);
 int fetch_goals(Goal **out_list, int *out_count);
 
 /* Aggregations */
-double get_total_by_type_for_month(const char *yyyymm, const char *type);
-double get_spent_in_category_month(const char *category, const char *yyyymm);
-int fetch_expense_totals_by_category(const char *yyyymm, char ***out_categories, double **out_totals, int *out_count);
+Money get_total_by_type_for_month(const char *yyyymm, const char *type);
+Money get_spent_in_category_month(const char *category, const char *yyyymm);
+/* Number of transactions matching q (NULL for all); -1 on error. Without a search or
+ * date bounds it comes from the monthly summaries rather than a scan. */
+long count_transactions(const TxQuery *q);
+/* Functions filling a ResultSet leave it empty on error; release it with result_set_free (arena.h).
+ * Here labels are category names and RS_TOTAL the month's expense total, largest first. */
+int fetch_expense_totals_by_category(const char *yyyymm, ResultSet *out);
+/* monthly_summary maintenance: rebuild from transactions, or count rows that drifted from them (-1 on error). */
+int rebuild_monthly_summary(void);
+int verify_monthly_summary(void);
+
+/* Categories: name -> id, creating the row if needed (-1 on error). Renaming onto an
+ * existing name merges the two. rename_category returns 1 if from does not exist. */
+int category_intern(const char *name);
+int rename_category(const char *from, const char *to);
 
 /* Settings (key/value) */
 int get_setting(const char *key, char *out_value, int out_size);
@@ -44,14 +106,29 @@ int edit_recurring_transaction(const RecurringTransaction *rt);
 int delete_recurring_transaction(int id);
 int fetch_recurring_transactions(RecurringTransaction **out_list, int *out_count);
 int fetch_active_recurring_transactions(RecurringTransaction **out_list, int *out_count);
-int process_recurring_transactions(void); /* Auto-create transactions based on schedule */
+/* Insert one occurrence of rule recurring_id; 1 if that rule already has a row on t->date. */
+int add_recurring_occurrence(int recurring_id, const Transaction *t);
+/* Record the last materialized occurrence ("" or NULL clears it) */
+int set_recurring_watermark(int id, const char *last_run);
 
 /* Advanced Queries */
 int fetch_transactions_by_category(const char *category, Transaction **out_list, int *out_count);
 int fetch_transactions_by_date_range(const char *start_date, const char *end_date, Transaction **out_list, int *out_count);
+/* Substring match on category or note, newest first; scans every row */
 int fetch_transactions_search(const char *search_term, Transaction **out_list, int *out_count);
-int get_monthly_totals(int months_back, char ***out_months, double **out_income, double **out_expense, int *out_count);
-int get_category_trends(const char *category, int months_back, char ***out_months, double **out_amounts, int *out_count);
+/* Full-text search over note and category name, best match first; every match is
+ * ranked. Words match as prefixes and "quoted text" as a phrase; snippets mark matched
+ * terms with SEARCH_MARK_OPEN/CLOSE. Falls back to a substring scan when the query has no searchable words. */
+#define SEARCH_MARK_OPEN "\x02"
+#define SEARCH_MARK_CLOSE "\x03"
+int search_transactions(const char *query, int limit, SearchHit **out_hits, int *out_count);
+/* One grouped scan over the last months_back months; category NULL means all categories.
+ * Row 0 is the current month, row i is i months back, labelled YYYY-MM; columns
+ * RS_INCOME and RS_EXPENSE, zero for months without transactions. */
+int fetch_monthly_aggregate(int months_back, const char *category, ResultSet *out);
+int get_monthly_totals(int months_back, ResultSet *out);
+/* RS_EXPENSE is the category's spending per month */
+int get_category_trends(const char *category, int months_back, ResultSet *out);
 
 #endif /* DATABASE_H */
 
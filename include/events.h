@@ -0,0 +1,51 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "utils.h"
+
+/* Change notifications from the database mutators: one event per row they
+ * insert, update or delete, published once the write is committed (straight
+ * away outside a transaction, at db_commit_transaction inside one, never for a
+ * rollback). Subscribers run on the committing thread, which may be the write
+ * queue's writer, so GUI subscribers hop to the main loop themselves; they must
+ * not write to the database. Subscribing and publishing are thread-safe. */
+
+typedef enum ChangeKind {
+    CHANGE_INSERT,
+    CHANGE_UPDATE,
+    CHANGE_DELETE,
+    CHANGE_RESET     /* too much changed to list (bulk loads, merges, restore): reload the table */
+} ChangeKind;
+
+typedef enum ChangeTable {
+    CHANGE_TRANSACTIONS,
+    CHANGE_BUDGETS,
+    CHANGE_GOALS,
+    CHANGE_TABLE_COUNT
+} ChangeTable;
+
+typedef struct ChangeEvent {
+    ChangeTable table;
+    ChangeKind kind;
+    int id;                         /* row id; 0 for CHANGE_RESET */
+    union {
+        /* before: updates and deletes; after: inserts and updates */
+        struct { Transaction before, after; } tx;
+        /* budgets and goals: the row as written; only the id for deletes */
+        Budget budget;
+        Goal goal;
+    } u;
+} ChangeEvent;
+
+typedef void (*ChangeFn)(const ChangeEvent *event, void *user_data);
+
+#define EVENTS_MAX_SUBSCRIBERS 8
+
+int events_subscribe(ChangeFn fn, void *user_data);    /* -1 when full */
+void events_unsubscribe(ChangeFn fn, void *user_data);
+/* Nonzero while anyone listens; the mutators skip building events otherwise */
+int events_has_subscribers(void);
+/* For database.c; the event is only borrowed for the length of the call */
+void events_publish(const ChangeEvent *event);
+
+#endif /* EVENTS_H */
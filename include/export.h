@@ -0,0 +1,46 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "utils.h"
+
+typedef enum ExportFormat {
+    EXPORT_CSV,                /* header row, RFC 4180 quoting, amounts as plain decimals */
+    EXPORT_JSONL,              /* one JSON object per line */
+    EXPORT_BINARY              /* columnar blocks, see below */
+} ExportFormat;
+
+/* Binary layout, all integers little-endian:
+ *   "FINLEDG1"                              8-byte magic and version
+ *   block*                                  up to EXPORT_CHUNK_ROWS rows each
+ *   u32 0                                   end marker
+ * block:
+ *   u32 rows
+ *   i32 id[rows], i32 day[rows] (YYYYMMDD), i64 amount[rows] (cents)
+ *   u8 type[rows] (0 expense, 1 income, 2 other)
+ *   u32 category_end[rows], category bytes  end offsets into the bytes that follow
+ *   u32 note_end[rows], note bytes
+ */
+#define EXPORT_CHUNK_ROWS 4096
+
+typedef struct ExportStats {
+    long rows_written;
+    long long bytes_written;
+    double seconds;
+    double rows_per_sec;
+    double mb_per_sec;
+} ExportStats;
+
+/* Pick a format from the file extension (.jsonl/.json, .fmlb/.bin); anything else is CSV. */
+ExportFormat export_format_from_path(const char *path);
+
+/* Called on the exporting thread after every chunk written; nonzero stops the export. */
+typedef int (*ExportProgressFn)(long rows_written, void *user_data);
+
+/* Stream the transactions matching filter (NULL for all) to path, newest first.
+ * Rows are fetched in chunks on the calling thread, formatted by worker threads
+ * and written in order. on_progress may be NULL. Returns 0 on success, -1 on
+ * I/O or database errors or when on_progress stopped it. */
+int export_transactions(const char *path, ExportFormat format, const TxQuery *filter,
+                        ExportProgressFn on_progress, void *user_data, ExportStats *out_stats);
+
+#endif /* EXPORT_H */
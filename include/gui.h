@@ -4,14 +4,33 @@
 #include <gtk/gtk.h>
 #include "utils.h"
 
+/* Notebook pages: transactions, budgets, goals, settings, diagnostics */
+#define APP_PAGE_COUNT 5
+
 typedef struct AppWidgets {
     GtkWidget *window;
     GtkWidget *notebook;
     GtkWidget *stack; /* top-level stack to switch between dashboard and main notebook */
+    /* Each notebook page starts as an empty slot and is built the first time it is shown */
+    GtkWidget *page_slots[APP_PAGE_COUNT];
+    gboolean page_built[APP_PAGE_COUNT];
+
+    /* Startup timing, profile_now_ns() clock: main sets the start before gtk_init */
+    guint64 startup_ns;
+    gulong first_frame_handler;
 
     /* Transactions tab */
     GtkWidget *transactions_view;
-    GtkListStore *transactions_store;
+    struct _TxModel *transactions_model;  /* every transaction, read from the database as it is shown */
+    GtkListStore *transactions_store;     /* search results */
+    TxOrder transactions_order;
+    GtkWidget *transactions_search;
+    GtkWidget *transactions_progress;
+    struct TxLoader *tx_loader;  /* list load in flight, NULL if none */
+    GtkWidget *import_button;          /* insensitive while an import runs */
+    GtkWidget *export_button;
+    GtkWidget *transfer_progress;      /* shown while an export runs */
+    struct ExportTask *export_task;    /* export in flight, NULL if none */
 
     /* Budgets tab */
     GtkWidget *budgets_view;
@@ -33,6 +52,21 @@ typedef struct AppWidgets {
     /* Settings */
     GtkWidget *currency_entry;
     GtkWidget *currency_label;
+
+    guint recurring_timer; /* source for the next due recurring occurrence, 0 if none */
+    /* Views a change event (events.h) could not patch, reloaded together from one idle */
+    guint reload_source;
+    unsigned pending_reloads;
+
+    /* Backups */
+    GtkWidget *backup_progress;
+    struct BackupJob *backup_job;  /* running backup, NULL if none */
+    guint backup_source;
+
+    /* Diagnostics tab: profile.h counters */
+    GtkWidget *diagnostics_view;
+    GtkListStore *diagnostics_store;
+    guint diagnostics_source;
 } AppWidgets;
 
 GtkWidget* build_main_window(AppWidgets *app);
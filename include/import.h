@@ -0,0 +1,23 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include "utils.h"
+
+typedef struct ImportStats {
+    long rows_read;            /* non-empty records after the header */
+    long rows_imported;
+    long rows_failed;
+    double seconds;
+    double rows_per_sec;
+} ImportStats;
+
+/* Called on the importing thread for every rejected row, in file order. line is 1-based. */
+typedef void (*ImportErrorFn)(long line, const char *message, void *user_data);
+
+/* Import transactions from a CSV file with a header row. Columns are matched by name
+ * (type, category, amount, date, note; id is ignored). Without a type column the sign
+ * of amount decides: negative rows become expenses. Returns 0 when the file was read
+ * and committed, even if individual rows were rejected; -1 on I/O or database errors. */
+int import_csv(const char *filename, ImportErrorFn on_error, void *user_data, ImportStats *out_stats);
+
+#endif /* IMPORT_H */
@@ -0,0 +1,37 @@
+#ifndef LEDGER_CACHE_H
+#define LEDGER_CACHE_H
+
+#include <stdint.h>
+#include "utils.h"
+
+/* In-memory columnar copy of the transactions table for analytics: one
+ * contiguous array per field (day, cents, category id) plus type bitmaps.
+ * The first query starts a load on a background thread with a pooled reader,
+ * then the database mutators keep it current as their writes commit.
+ * All functions are thread-safe. */
+
+void ledger_cache_invalidate(void);    /* drop contents; the next query starts a reload */
+void ledger_cache_free(void);          /* also waits for a load in flight */
+/* Off: never load, so monthly aggregates go straight to SQL. For short-lived
+ * processes that would spend longer loading the cache than querying. On by default. */
+void ledger_cache_set_enabled(int enabled);
+
+typedef enum { LEDGER_UPSERT, LEDGER_DELETE, LEDGER_RENAME } LedgerWriteKind;
+typedef struct LedgerWrite {
+    LedgerWriteKind kind;
+    union {
+        Transaction t;                                          /* upsert */
+        int id;                                                 /* delete */
+        struct { char from[CATEGORY_LEN], to[CATEGORY_LEN]; } rename;  /* or merge */
+    } u;
+} LedgerWrite;
+
+/* Called by database.c with committed writes, in commit order. Idempotent, and
+ * no-ops while the cache is not loaded. */
+void ledger_cache_apply(const LedgerWrite *writes, int count);
+
+/* Same contract as fetch_monthly_aggregate, computed from the cache. Returns -1
+ * while it is not loaded (starting the load), so callers fall back to SQL. */
+int ledger_cache_monthly(int months_back, const char *category, ResultSet *out);
+
+#endif /* LEDGER_CACHE_H */
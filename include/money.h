@@ -0,0 +1,12 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <stddef.h>
+#include "utils.h"
+
+/* Summation kernels over contiguous Money arrays. Integer addition is
+ * associative, so these split the work across independent accumulators the
+ * compiler can keep in vector lanes and still give the exact total. */
+Money money_sum(const Money *values, size_t n);
+
+#endif /* MONEY_H */
@@ -0,0 +1,80 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Call counters and latency histograms for named probes, safe to update from any
+ * thread. Histograms are HDR-style: each power of two of nanoseconds is split
+ * into PROFILE_SUB_BUCKETS linear steps, so a percentile is within about 6% of
+ * the true value at any magnitude, in a fixed few kilobytes per probe. */
+#define PROFILE_SUB_BITS 4
+#define PROFILE_SUB_BUCKETS (1 << PROFILE_SUB_BITS)
+#define PROFILE_MAX_EXP 40  /* 2^40 ns is about 18 minutes; anything longer lands in the top bucket */
+#define PROFILE_BUCKETS ((PROFILE_MAX_EXP - PROFILE_SUB_BITS + 1) * PROFILE_SUB_BUCKETS)
+
+/* A probe joins the registry on its first sample; a zeroed static one is ready to use. */
+typedef struct ProfileProbe {
+    const char *name;
+    struct ProfileProbe *next;
+    atomic_int registered;
+    atomic_uint_least64_t calls;
+    atomic_uint_least64_t rows;
+    atomic_uint_least64_t total_ns;
+    atomic_uint_least64_t max_ns;
+    atomic_uint_least64_t buckets[PROFILE_BUCKETS];
+} ProfileProbe;
+
+uint64_t profile_now_ns(void);
+/* Add one sample; name (static storage) labels the probe on first use. */
+void profile_record(ProfileProbe *probe, const char *name, uint64_t elapsed_ns, uint64_t rows);
+
+/* Timed region that ends when it goes out of scope, so every return is covered. */
+typedef struct ProfileScope {
+    ProfileProbe *probe;
+    const char *name;
+    uint64_t start_ns;
+    uint64_t rows;
+    struct ProfileScope *parent;
+} ProfileScope;
+
+void profile_scope_begin(ProfileScope *scope, ProfileProbe *probe, const char *name);
+void profile_scope_end(ProfileScope *scope);
+/* Count rows against the innermost open scope on this thread */
+void profile_add_rows(uint64_t rows);
+
+#if defined(__GNUC__)
+#define PROFILE_SCOPE(label) \
+    static ProfileProbe profile_probe_; \
+    ProfileScope profile_scope_ __attribute__((cleanup(profile_scope_end))); \
+    profile_scope_begin(&profile_scope_, &profile_probe_, (label))
+#define PROFILE_ROWS(n) profile_add_rows((uint64_t)(n))
+#else
+#define PROFILE_SCOPE(label) ((void)0)
+#define PROFILE_ROWS(n) ((void)(n))
+#endif
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+
+/* One probe's numbers at the time of the snapshot; latencies in microseconds */
+typedef struct ProfileStats {
+    const char *name;
+    uint64_t calls;
+    uint64_t rows;
+    double total_ms;
+    double mean_us;
+    double p50_us;
+    double p95_us;
+    double p99_us;
+    double max_us;
+} ProfileStats;
+
+/* Every probe with at least one call, most total time first; free() the list. */
+int profile_snapshot(ProfileStats **out_list, int *out_count);
+void profile_reset(void);
+/* Print the snapshot as a table */
+void profile_dump(FILE *f);
+/* With FINANCE_PROFILE=1 in the environment, dump to stderr at exit */
+void profile_init_from_env(void);
+
+#endif /* PROFILE_H */
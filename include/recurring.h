@@ -0,0 +1,37 @@
+#ifndef RECURRING_H
+#define RECURRING_H
+
+#include "utils.h"
+
+/* Occurrence n of a rule, counted from its start date (n = 0): weekly adds 7n days,
+ * monthly n months and yearly 12n months, each clamped to the end of shorter months
+ * so a rule starting on the 31st stays on month ends. Returns a YYYYMMDD key, 0 if
+ * the start date or frequency is invalid. */
+int recurring_occurrence_key(const RecurringTransaction *rt, int n);
+
+/* First occurrence strictly after after_key (0 for the first one ever) that is not past
+ * the rule's end date. Returns its YYYYMMDD key, 0 if there is none. */
+int recurring_next_key(const RecurringTransaction *rt, int after_key);
+
+/* Due-date schedule: a min-heap of the active rules keyed by their next occurrence,
+ * built by recurring_schedule_load and kept current by the recurring CRUD functions
+ * in database.c. Like the writer connection, it belongs to the main thread. */
+typedef void (*RecurringScheduleFn)(void *user_data);
+int recurring_schedule_load(void);
+void recurring_schedule_free(void);
+void recurring_schedule_update(const RecurringTransaction *rt);  /* added or edited rule */
+void recurring_schedule_remove(int id);
+/* YYYYMMDD of the earliest pending occurrence, 0 if nothing is scheduled */
+int recurring_next_due(void);
+/* fn runs whenever recurring_next_due changes, so a timer can be re-armed */
+void recurring_schedule_set_listener(RecurringScheduleFn fn, void *user_data);
+
+/* Catch up the rules due today or earlier: insert each occurrence after its watermark,
+ * all in one transaction, then advance the watermarks and requeue the rules.
+ * Occurrences already in the ledger are skipped by the (rule, day) unique key.
+ * Returns the number of transactions created, -1 on error. */
+int recurring_run_due(void);
+/* Reload the schedule from the database, then recurring_run_due */
+int process_recurring_transactions(void);
+
+#endif /* RECURRING_H */
@@ -3,9 +3,9 @@
 
 #include "utils.h"
 
-double get_total_income(const char *yyyymm);
-double get_total_expense(const char *yyyymm);
-double get_balance(const char *yyyymm);
+Money get_total_income(const char *yyyymm);
+Money get_total_expense(const char *yyyymm);
+Money get_balance(const char *yyyymm);
 
 #endif /* STATS_H */
 
@@ -0,0 +1,42 @@
+#ifndef TX_LOADER_H
+#define TX_LOADER_H
+
+#include "utils.h"
+
+/* Background loading of transaction search results for the GTK views; the
+ * whole ledger is paged by TxModel instead. A GTask worker checks out a pooled
+ * reader, runs the search on one snapshot and queues the hits page by page; an
+ * idle handler on the main loop hands them over one batch per iteration, so
+ * input and redraws get in between. At most TX_LOADER_MAX_PENDING batches wait
+ * at a time: the worker pauses until the main loop catches up. */
+#define TX_LOADER_BATCH_ROWS 500
+#define TX_LOADER_MAX_PENDING 8
+
+typedef struct TxLoader TxLoader;
+
+typedef struct TxLoaderBatch {
+    const Transaction *rows;
+    const char *const *snippets;  /* one excerpt per row (see search_transactions) */
+    int count;
+    long loaded;                  /* rows delivered so far, this batch included */
+    long total;                   /* expected rows, -1 if unknown */
+} TxLoaderBatch;
+
+/* Both run on the main loop. done gets 0 once every row was delivered, -1 if the
+ * load failed (e.g. no reader connection); it is the last call for that loader. */
+typedef void (*TxLoaderBatchFn)(const TxLoaderBatch *batch, void *user_data);
+typedef void (*TxLoaderDoneFn)(int rc, void *user_data);
+
+/* Load the ranked search_transactions matches for search (at most limit).
+ * Main thread only. on_batch may
+ * cancel its own loader; either callback may start another. */
+TxLoader *tx_loader_start(const char *search, int limit, TxLoaderBatchFn on_batch, TxLoaderDoneFn on_done, void *user_data);
+/* Abandon a load that has not finished: no callback runs for it after this
+ * returns. The worker stops at its next page and frees the loader. */
+void tx_loader_cancel(TxLoader *loader);
+/* Block until every worker has released its reader; cancel running loads first,
+ * since a worker waiting for the main loop to take its batches never finishes.
+ * Call before close_database. */
+void tx_loader_shutdown(void);
+
+#endif /* TX_LOADER_H */
@@ -0,0 +1,46 @@
+#ifndef TX_MODEL_H
+#define TX_MODEL_H
+
+#include <gtk/gtk.h>
+#include "utils.h"
+
+/* Columns of the transaction list; the list store holding search results uses the same */
+enum { COL_T_ID, COL_T_TYPE, COL_T_CATEGORY, COL_T_AMOUNT, COL_T_DATE, COL_T_NOTE, COL_T_NOTE_MARKUP, N_COL_T };
+
+/* GtkTreeModel over the transactions table that reads rows when a view asks for
+ * them, a page of TX_MODEL_PAGE_ROWS at a time, and keeps the TX_MODEL_CACHE_PAGES
+ * most recently used pages. Filtering and order are the page queries' (TxQuery),
+ * so nothing is sorted or matched in memory. Besides the cache it remembers one
+ * keyset cursor per page, so any page starts with an index seek: after a reload
+ * a worker reads them all with one fetch_page_anchors on a pooled reader, and
+ * until it is back a page is reached from the nearest page read so far, or
+ * backwards from the end when that is nearer.
+ * Main thread only, on the writer connection. */
+#define TX_MODEL_PAGE_ROWS 128
+#define TX_MODEL_CACHE_PAGES 16
+
+#define TX_TYPE_MODEL (tx_model_get_type())
+G_DECLARE_FINAL_TYPE(TxModel, tx_model, TX, MODEL, GObject)
+
+/* Empty until the first tx_model_reload */
+TxModel *tx_model_new(void);
+/* Filter and order for the next reload; q's strings are copied */
+void tx_model_set_query(TxModel *model, const TxQuery *q);
+/* Recount and drop every cached page. The row count change is signalled at the
+ * end of the list and the rows that were cached as changed, so a view keeps its
+ * scroll position; attach views afterwards when the count may jump by a lot.
+ * With no view attached the count is just set, without signals.
+ * -1 if the count failed, leaving the model as it was. */
+int tx_model_reload(TxModel *model);
+/* The same in two steps, so a caller can look at the new count before the
+ * signals go out: rows as tx_model_count returned it (-1 on failure). */
+long tx_model_count(TxModel *model);
+int tx_model_reload_rows(TxModel *model, long rows);
+/* A transaction was edited (events.h). When the edit cannot move the row or take
+ * it out of the query, the cached copy is patched and signalled changed, and 0 is
+ * returned; otherwise 1, and the caller reloads. */
+int tx_model_row_updated(TxModel *model, const Transaction *before, const Transaction *after);
+/* Block until the anchor workers have released their readers. Call before close_database. */
+void tx_model_shutdown(void);
+
+#endif /* TX_MODEL_H */
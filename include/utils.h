@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
 #include <time.h>
 #ifdef _WIN32
 #include <malloc.h>
@@ -19,11 +20,15 @@
 #define NOTE_LEN 128
 #define NAME_LEN 64
 
+/* Money in minor units (cents). Stored as INTEGER in the database, so sums are exact. */
+typedef int64_t Money;
+#define MONEY_SCALE 100
+
 typedef struct Transaction {
     int id;
     char type[TYPE_LEN];       /* "income" or "expense" */
     char category[CATEGORY_LEN];
-    double amount;
+    Money amount;
     char date[DATE_LEN];       /* YYYY-MM-DD */
     char note[NOTE_LEN];
 } Transaction;
@@ -31,14 +36,20 @@ typedef struct Transaction {
 typedef struct Budget {
     int id;
     char category[CATEGORY_LEN];
-    double monthly_limit;
+    Money monthly_limit;
 } Budget;
 
+typedef struct BudgetStatus {
+    Budget budget;
+    Money spent;               /* expenses in the month asked for */
+    double progress;           /* spent / limit; 0 without a limit */
+} BudgetStatus;
+
 typedef struct Goal {
     int id;
     char name[NAME_LEN];
-    double target_amount;
-    double monthly_saving;
+    Money target_amount;
+    Money monthly_saving;
     char start_date[DATE_LEN]; /* YYYY-MM-DD */
 } Goal;
 
@@ -46,41 +57,103 @@ typedef struct RecurringTransaction {
     int id;
     char type[TYPE_LEN];       /* "income" or "expense" */
     char category[CATEGORY_LEN];
-    double amount;
+    Money amount;
     char frequency[16];        /* "weekly", "monthly", "yearly" */
     char start_date[DATE_LEN];
     char end_date[DATE_LEN];   /* NULL or date */
     char note[NOTE_LEN];
     int is_active;             /* 1 = active, 0 = inactive */
+    char last_run[DATE_LEN];   /* last materialized occurrence, "" if none yet */
 } RecurringTransaction;
 
-typedef struct Forecast {
-    char month[8];             /* YYYY-MM */
-    double predicted_income;
-    double predicted_expense;
-    double predicted_balance;
-} Forecast;
+/* Row order for streamed transactions; ties are broken by id in the same direction */
+typedef enum TxOrder {
+    TX_ORDER_NEWEST = 0,       /* day DESC */
+    TX_ORDER_OLDEST,           /* day ASC */
+    TX_ORDER_LARGEST,          /* amount DESC */
+    TX_ORDER_SMALLEST          /* amount ASC */
+} TxOrder;
+
+/* Filter for streaming transactions, newest first unless order says otherwise. Zeroed means everything. */
+typedef struct TxQuery {
+    const char *category;      /* exact match, NULL for any */
+    int day_from;              /* YYYYMMDD inclusive bounds, 0 for open */
+    int day_to;
+    const char *search;        /* substring of category or note, NULL for none */
+    TxOrder order;
+} TxQuery;
+
+#define SNIPPET_LEN 256
+
+/* One full-text search result */
+typedef struct SearchHit {
+    Transaction tx;
+    double score;              /* higher is a better match */
+    char snippet[SNIPPET_LEN]; /* note excerpt around the matched terms */
+} SearchHit;
+
+/* Keyset position: the next page starts strictly after (day, id), or (amount, id)
+ * for the amount orders. Zeroed means the start. */
+typedef struct TxCursor {
+    int day;
+    int id;
+    Money amount;
+    int done;
+} TxCursor;
+
+/* Bump allocator: carves allocations out of a chain of blocks, all released at once. */
+typedef struct ArenaBlock ArenaBlock;
+typedef struct Arena {
+    ArenaBlock *head;
+} Arena;
+
+/* Rows of an aggregation query: a label per row (YYYY-MM or a category name)
+ * and numeric columns, all allocated from one arena and released together by
+ * result_set_free. The function that fills it documents its columns. */
+#define RESULT_MAX_COLUMNS 3
+typedef struct ResultSet {
+    int count;
+    const char **labels;
+    Money *money[RESULT_MAX_COLUMNS];   /* NULL past the columns in use */
+    double *real;                       /* NULL unless the query has one */
+    int capacity;
+    int money_columns;
+    Arena arena;
+} ResultSet;
+
+/* ResultSet.money columns: monthly aggregates and forecasts */
+enum { RS_INCOME = 0, RS_EXPENSE = 1, RS_BALANCE = 2 };
+/* ResultSet.money column for one amount per label */
+enum { RS_TOTAL = 0 };
 
 /* Date helpers */
 void get_current_yyyymm(char out_yyyymm[8 + 1]);
 void get_current_yyyymmdd(char out_date[DATE_LEN]);
 int yyyymm_from_date(const char *yyyy_mm_dd, char out_yyyymm[8 + 1]);
 int add_months_to_yyyymmdd(const char *yyyy_mm_dd, int months, char out_date[DATE_LEN]);
+/* Integer keys used by the indexed date columns: YYYYMMDD and YYYYMM. Both return 0 if unparseable. */
+int day_key_from_date(const char *yyyy_mm_dd);
+int month_key_from_yyyymm(const char *yyyymm);
 
 /* Misc helpers */
 void color_from_category(const char *category, double *r, double *g, double *b);
 
-/* Optional: CSV export */
-int export_to_csv(const char *filename);
+/* Money helpers */
+/* Parse "1234", "-12.5", "1,234.56"; more than two decimals round half away from zero. 0 on success, -1 if invalid. */
+int money_parse(const char *s, Money *out);
+Money money_from_double(double value);
+double money_to_double(Money amount);
+/* Plain "-1234.56", for CSV and edit fields */
+void money_to_string(Money amount, char *out, int out_size);
 
 /* Formatting helpers */
-void format_amount_currency(double amount, const char *currency, char *out, int out_size);
+void format_money(Money amount, const char *currency, char *out, int out_size);
 int is_valid_currency_string(const char *s);
 
 /* Analytics and forecasting */
-int calculate_spending_trend(const char *category, int months_back, double *out_avg, double *out_trend);
-int generate_forecast(int months_ahead, Forecast **out_forecasts, int *out_count);
-double calculate_category_average(const char *category, int months_back);
+int calculate_spending_trend(const char *category, int months_back, Money *out_avg, Money *out_trend);
+int generate_forecast(int months_ahead, ResultSet *out);
+Money calculate_category_average(const char *category, int months_back);
 
 #endif /* UTILS_H */
 
@@ -0,0 +1,43 @@
+#ifndef WRITE_QUEUE_H
+#define WRITE_QUEUE_H
+
+#include "utils.h"
+
+/* Write-behind queue: callers enqueue mutations without blocking and one writer
+ * thread applies them on its own connection, committing everything that is
+ * waiting in a single transaction. Enqueueing is lock-free and safe from any
+ * thread. Until write_queue_start succeeds, the enqueue functions apply the write
+ * immediately on the calling thread and call done before returning. */
+
+/* Completion: rc is the database function's result (0 on success) */
+typedef void (*WriteDoneFn)(int rc, void *user_data);
+/* Runs fn(arg) on the thread that should see completions, e.g. via the main loop */
+typedef void (*WriteDispatchFn)(void (*fn)(void *arg), void *arg);
+
+#define WRITE_QUEUE_BATCH_MAX 512  /* most mutations per commit */
+
+/* dispatch NULL runs completions on the writer thread. Returns -1 if the writer
+ * connection or thread cannot be started; writes then stay synchronous. */
+int write_queue_start(WriteDispatchFn dispatch);
+/* Commit whatever is queued, then join the writer. Call before close_database. */
+void write_queue_stop(void);
+/* Block until every mutation enqueued before the call is committed. */
+void write_queue_flush(void);
+/* Flush, then hold the writer idle (no open transaction) until write_queue_resume,
+ * e.g. around replacing the database. Mutations enqueued meanwhile wait. */
+void write_queue_pause(void);
+void write_queue_resume(void);
+
+/* Return 0 when queued (or applied synchronously), -1 if out of memory. done may be NULL. */
+int write_queue_add_transaction(const Transaction *t, WriteDoneFn done, void *user_data);
+int write_queue_edit_transaction(const Transaction *t, WriteDoneFn done, void *user_data);
+int write_queue_delete_transaction(int id, WriteDoneFn done, void *user_data);
+int write_queue_set_setting(const char *key, const char *value, WriteDoneFn done, void *user_data);
+
+/* Run fn(arg) on the writer thread between two batches, outside any transaction,
+ * e.g. a bulk load that commits in its own chunks (db_begin_bulk_transaction).
+ * Mutations enqueued meanwhile wait until it returns; done gets its result. */
+typedef int (*WriteRunFn)(void *arg);
+int write_queue_run(WriteRunFn fn, void *arg, WriteDoneFn done, void *user_data);
+
+#endif /* WRITE_QUEUE_H */
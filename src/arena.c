@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE 4096
+#define ARENA_ALIGN 16
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used, size;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+void *arena_alloc(Arena *a, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock *b = a->head;
+    if (!b || b->size - b->used < size) {
+        /* oversized requests get a block of their own */
+        size_t bsize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        b = (ArenaBlock*)malloc(sizeof(ArenaBlock) + bsize);
+        if (!b) return NULL;
+        b->used = 0;
+        b->size = bsize;
+        b->next = a->head;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+char *arena_strdup(Arena *a, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *p = (char*)arena_alloc(a, len);
+    if (p) memcpy(p, s, len);
+    return p;
+}
+
+void arena_free(Arena *a)
+{
+    while (a->head) {
+        ArenaBlock *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+/* Move the row arrays to new storage for capacity rows. The old arrays stay
+ * in the arena until it is freed; doubling keeps that under half the total. */
+static int result_set_grow(ResultSet *rs, int capacity)
+{
+    const char **labels = (const char**)arena_alloc(&rs->arena, capacity * sizeof(char*));
+    if (!labels) return -1;
+    if (rs->count) memcpy(labels, rs->labels, rs->count * sizeof(char*));
+    rs->labels = labels;
+    for (int c = 0; c < rs->money_columns; ++c) {
+        Money *col = (Money*)arena_alloc(&rs->arena, capacity * sizeof(Money));
+        if (!col) return -1;
+        if (rs->count) memcpy(col, rs->money[c], rs->count * sizeof(Money));
+        rs->money[c] = col;
+    }
+    if (rs->real) {
+        double *col = (double*)arena_alloc(&rs->arena, capacity * sizeof(double));
+        if (!col) return -1;
+        if (rs->count) memcpy(col, rs->real, rs->count * sizeof(double));
+        rs->real = col;
+    }
+    rs->capacity = capacity;
+    return 0;
+}
+
+int result_set_init(ResultSet *rs, int capacity, int money_columns, int with_real)
+{
+    memset(rs, 0, sizeof(*rs));
+    if (money_columns < 0 || money_columns > RESULT_MAX_COLUMNS) return -1;
+    rs->money_columns = money_columns;
+    if (with_real) rs->real = (double*)arena_alloc(&rs->arena, sizeof(double));  /* marks the column; grown below */
+    if (result_set_grow(rs, capacity > 0 ? capacity : 8) != 0) {
+        result_set_free(rs);
+        return -1;
+    }
+    return 0;
+}
+
+int result_set_add_row(ResultSet *rs, const char *label)
+{
+    if (rs->count == rs->capacity && result_set_grow(rs, rs->capacity * 2) != 0) return -1;
+    const char *copy = arena_strdup(&rs->arena, label ? label : "");
+    if (!copy) return -1;
+    rs->labels[rs->count] = copy;
+    return rs->count++;
+}
+
+void result_set_free(ResultSet *rs)
+{
+    if (!rs) return;
+    arena_free(&rs->arena);
+    memset(rs, 0, sizeof(*rs));
+}
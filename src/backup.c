@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+#include <sqlite3.h>
+#include "backup.h"
+#include "database.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define BACKUP_MAX_GENERATIONS 50
+
+struct BackupJob {
+    sqlite3 *dest;
+    sqlite3_backup *backup;
+    char *path;
+    char *tmp_path;
+    int generations;
+    int complete;
+};
+
+static char *path_with_suffix(const char *path, const char *suffix)
+{
+    size_t n = strlen(path) + strlen(suffix) + 1;
+    char *out = (char*)malloc(n);
+    if (out) snprintf(out, n, "%s%s", path, suffix);
+    return out;
+}
+
+/* Make the finished copy durable before it replaces anything */
+static void sync_file(const char *path)
+{
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+/* path -> path.1 -> ... -> path.N-1, dropping the oldest, then tmp -> path */
+static int rotate_generations(const char *path, const char *tmp_path, int generations)
+{
+    char older[4096], newer[4096];
+    for (int i = generations - 1; i >= 1; --i) {
+        snprintf(older, sizeof(older), "%s.%d", path, i);
+        if (i == 1) snprintf(newer, sizeof(newer), "%s", path);
+        else snprintf(newer, sizeof(newer), "%s.%d", path, i - 1);
+        remove(older);
+        rename(newer, older);  /* missing generations are fine */
+    }
+    return rename(tmp_path, path) == 0 ? 0 : -1;
+}
+
+static void job_free(BackupJob *job)
+{
+    if (job->backup) sqlite3_backup_finish(job->backup);
+    sqlite3_close(job->dest);
+    free(job->path);
+    free(job->tmp_path);
+    free(job);
+}
+
+BackupJob *backup_begin(const char *path, int generations)
+{
+    sqlite3 *src = db_writer_handle();
+    if (!path || !src) return NULL;
+    BackupJob *job = (BackupJob*)calloc(1, sizeof(BackupJob));
+    if (!job) return NULL;
+    job->generations = generations < 1 ? 1 : generations > BACKUP_MAX_GENERATIONS ? BACKUP_MAX_GENERATIONS : generations;
+    job->path = path_with_suffix(path, "");
+    job->tmp_path = path_with_suffix(path, ".tmp");
+    if (!job->path || !job->tmp_path) { job_free(job); return NULL; }
+    remove(job->tmp_path);  /* left over from an interrupted run */
+    if (sqlite3_open(job->tmp_path, &job->dest) != SQLITE_OK ||
+        /* a scratch file until it is renamed into place; sync_file makes it durable once */
+        sqlite3_exec(job->dest, "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF", NULL, NULL, NULL) != SQLITE_OK ||
+        !(job->backup = sqlite3_backup_init(job->dest, "main", src, "main"))) {
+        fprintf(stderr, "Cannot start backup: %s\n", job->dest ? sqlite3_errmsg(job->dest) : "out of memory");
+        sqlite3_close(job->dest);
+        job->dest = NULL;
+        remove(job->tmp_path);
+        job_free(job);
+        return NULL;
+    }
+    return job;
+}
+
+int backup_step(BackupJob *job)
+{
+    if (!job || !job->backup) return -1;
+    if (job->complete) return 0;
+    int rc = sqlite3_backup_step(job->backup, BACKUP_PAGES_PER_STEP);
+    if (rc == SQLITE_DONE) { job->complete = 1; return 0; }
+    if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) return 1;
+    fprintf(stderr, "Backup failed: %s\n", sqlite3_errstr(rc));
+    return -1;
+}
+
+void backup_progress(const BackupJob *job, int *pages_done, int *pages_total)
+{
+    int total = job && job->backup ? sqlite3_backup_pagecount(job->backup) : 0;
+    int remaining = job && job->backup ? sqlite3_backup_remaining(job->backup) : 0;
+    if (pages_total) *pages_total = total;
+    if (pages_done) *pages_done = job && job->complete ? total : total - remaining;
+}
+
+int backup_finish(BackupJob *job)
+{
+    if (!job) return -1;
+    int rc = job->complete ? 0 : -1;
+    if (sqlite3_backup_finish(job->backup) != SQLITE_OK) rc = -1;
+    job->backup = NULL;
+    /* the copy carries the source's WAL flag; make it a self-contained file */
+    if (rc == 0 && sqlite3_exec(job->dest, "PRAGMA journal_mode=DELETE", NULL, NULL, NULL) != SQLITE_OK) rc = -1;
+    if (sqlite3_close(job->dest) != SQLITE_OK) rc = -1;
+    job->dest = NULL;
+    if (rc == 0) {
+        sync_file(job->tmp_path);
+        rc = rotate_generations(job->path, job->tmp_path, job->generations);
+    }
+    if (rc != 0) remove(job->tmp_path);
+    job_free(job);
+    return rc;
+}
+
+int backup_database(const char *path, int generations)
+{
+    BackupJob *job = backup_begin(path, generations);
+    if (!job) return -1;
+    int rc;
+    while ((rc = backup_step(job)) == 1) {}
+    if (rc < 0) { backup_finish(job); return -1; }
+    return backup_finish(job);
+}
+
+/* A usable backup opens, passes quick_check and has a transactions table. */
+static int check_backup(sqlite3 *db)
+{
+    sqlite3_stmt *stmt = NULL;
+    int ok = sqlite3_prepare_v2(db, "PRAGMA quick_check", -1, &stmt, NULL) == SQLITE_OK &&
+             sqlite3_step(stmt) == SQLITE_ROW &&
+             strcmp((const char*)sqlite3_column_text(stmt, 0), "ok") == 0;
+    sqlite3_finalize(stmt);
+    if (!ok) return -1;
+    ok = sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type='table' AND name='transactions'", -1, &stmt, NULL) == SQLITE_OK &&
+         sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return ok ? 0 : -1;
+}
+
+int backup_restore(const char *path)
+{
+    sqlite3 *dest = db_writer_handle();
+    if (!path || !dest) return -1;
+    sqlite3 *src = NULL;
+    if (sqlite3_open_v2(path, &src, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK || check_backup(src) != 0) {
+        sqlite3_close(src);
+        return 1;
+    }
+    sqlite3_backup *backup = sqlite3_backup_init(dest, "main", src, "main");
+    int rc = backup ? sqlite3_backup_step(backup, -1) : SQLITE_ERROR;
+    if (backup) sqlite3_backup_finish(backup);
+    sqlite3_close(src);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Restore failed: %s\n", sqlite3_errmsg(dest));
+        return -1;
+    }
+    return db_after_restore() == 0 ? 0 : -1;
+}
@@ -0,0 +1,170 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdint.h>
+#include "category.h"
+
+/* by_id[id] owns the name; slots is an open-addressing table of ids keyed by
+ * the name's hash, rebuilt on the rare rename or removal. */
+static char **g_by_id = NULL;
+static int g_id_cap = 0;
+static int *g_slots = NULL;
+static int g_slot_cap = 0;
+static int g_count = 0;
+static pthread_rwlock_t g_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static uint32_t hash_name(const char *s)
+{
+    uint32_t h = 2166136261u;  /* FNV-1a */
+    for (; *s; ++s) { h ^= (unsigned char)*s; h *= 16777619u; }
+    return h;
+}
+
+static void slot_insert(int *slots, int cap, const char *name, int id)
+{
+    uint32_t h = hash_name(name) & (cap - 1);
+    while (slots[h]) h = (h + 1) & (cap - 1);
+    slots[h] = id;
+}
+
+static int rehash(int cap)
+{
+    int *slots = (int*)calloc(cap, sizeof(int));
+    if (!slots) return -1;
+    for (int id = 1; id < g_id_cap; ++id)
+        if (g_by_id[id]) slot_insert(slots, cap, g_by_id[id], id);
+    free(g_slots);
+    g_slots = slots;
+    g_slot_cap = cap;
+    return 0;
+}
+
+static int find_locked(const char *name)
+{
+    if (!g_slot_cap) return 0;
+    for (uint32_t h = hash_name(name) & (g_slot_cap - 1); g_slots[h]; h = (h + 1) & (g_slot_cap - 1))
+        if (strcmp(g_by_id[g_slots[h]], name) == 0) return g_slots[h];
+    return 0;
+}
+
+void category_interner_clear(void)
+{
+    pthread_rwlock_wrlock(&g_lock);
+    for (int i = 0; i < g_id_cap; ++i) free(g_by_id[i]);
+    free(g_by_id); free(g_slots);
+    g_by_id = NULL; g_slots = NULL;
+    g_id_cap = g_slot_cap = g_count = 0;
+    pthread_rwlock_unlock(&g_lock);
+}
+
+int category_interner_add(int id, const char *name)
+{
+    if (id <= 0 || !name) return -1;
+    int rc = 0;
+    pthread_rwlock_wrlock(&g_lock);
+    if (id >= g_id_cap) {
+        int ncap = g_id_cap ? g_id_cap : 64;
+        while (ncap <= id) ncap *= 2;
+        char **p = (char**)realloc(g_by_id, ncap * sizeof(char*));
+        if (!p) { rc = -1; goto out; }
+        memset(p + g_id_cap, 0, (ncap - g_id_cap) * sizeof(char*));
+        g_by_id = p;
+        g_id_cap = ncap;
+    }
+    if (g_by_id[id]) goto out;  /* already known */
+    size_t len = strlen(name) + 1;
+    if (!(g_by_id[id] = (char*)malloc(len))) { rc = -1; goto out; }
+    memcpy(g_by_id[id], name, len);
+    g_count++;
+    if (g_count * 2 > g_slot_cap) rc = rehash(g_slot_cap ? g_slot_cap * 2 : 128);
+    else slot_insert(g_slots, g_slot_cap, name, id);
+out:
+    pthread_rwlock_unlock(&g_lock);
+    return rc;
+}
+
+int category_interner_rename(int id, const char *name)
+{
+    if (!name) return -1;
+    int rc = -1;
+    pthread_rwlock_wrlock(&g_lock);
+    if (id > 0 && id < g_id_cap && g_by_id[id]) {
+        size_t len = strlen(name) + 1;
+        char *copy = (char*)malloc(len);
+        if (copy) {
+            memcpy(copy, name, len);
+            free(g_by_id[id]);
+            g_by_id[id] = copy;
+            rc = rehash(g_slot_cap);
+        }
+    }
+    pthread_rwlock_unlock(&g_lock);
+    return rc;
+}
+
+void category_interner_remove(int id)
+{
+    pthread_rwlock_wrlock(&g_lock);
+    if (id > 0 && id < g_id_cap && g_by_id[id]) {
+        free(g_by_id[id]);
+        g_by_id[id] = NULL;
+        g_count--;
+        rehash(g_slot_cap);
+    }
+    pthread_rwlock_unlock(&g_lock);
+}
+
+int category_interner_apply(const CategoryChange *changes, int count)
+{
+    if (count <= 0) return 0;
+    int rc = 0;
+    pthread_rwlock_wrlock(&g_lock);
+    for (int i = 0; i < count && rc == 0; ++i) {
+        int id = changes[i].id;
+        if (id <= 0) continue;
+        if (id >= g_id_cap) {
+            if (changes[i].removed) continue;
+            int ncap = g_id_cap ? g_id_cap : 64;
+            while (ncap <= id) ncap *= 2;
+            char **p = (char**)realloc(g_by_id, ncap * sizeof(char*));
+            if (!p) { rc = -1; break; }
+            memset(p + g_id_cap, 0, (ncap - g_id_cap) * sizeof(char*));
+            g_by_id = p;
+            g_id_cap = ncap;
+        }
+        char *copy = NULL;
+        if (!changes[i].removed) {
+            size_t len = strlen(changes[i].name) + 1;
+            if (!(copy = (char*)malloc(len))) { rc = -1; break; }
+            memcpy(copy, changes[i].name, len);
+        }
+        g_count += (copy != NULL) - (g_by_id[id] != NULL);
+        free(g_by_id[id]);
+        g_by_id[id] = copy;
+    }
+    /* names may have swapped between ids, so rebuild the table once at the end */
+    int cap = g_slot_cap ? g_slot_cap : 128;
+    while (g_count * 2 > cap) cap *= 2;
+    if (rehash(cap) != 0) rc = -1;
+    pthread_rwlock_unlock(&g_lock);
+    return rc;
+}
+
+int category_lookup(const char *name)
+{
+    pthread_rwlock_rdlock(&g_lock);
+    int id = find_locked(name ? name : "");
+    pthread_rwlock_unlock(&g_lock);
+    return id;
+}
+
+int category_name(int id, char *out_name, int out_size)
+{
+    int rc = 1;
+    pthread_rwlock_rdlock(&g_lock);
+    if (id > 0 && id < g_id_cap && g_by_id[id]) {
+        snprintf(out_name, out_size, "%s", g_by_id[id]);
+        rc = 0;
+    }
+    pthread_rwlock_unlock(&g_lock);
+    return rc;
+}
@@ -5,6 +5,7 @@
 #include "chart.h"
 #include "database.h"
 #include "utils.h"
+#include "arena.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -40,8 +41,9 @@ void draw_expense_chart(cairo_t *cr, int width, int height, const char *yyyymm)
         get_current_yyyymm(month);
     }
 
-    char **cats = NULL; double *totals = NULL; int count = 0;
-    if (fetch_expense_totals_by_category(month, &cats, &totals, &count) != 0 || count == 0) {
+    ResultSet rs;
+    if (fetch_expense_totals_by_category(month, &rs) != 0 || rs.count == 0) {
+        result_set_free(&rs);
         /* Draw subtle placeholder circle */
         cairo_set_source_rgba(cr, 0.9, 0.9, 0.9, 1.0);
         double cx = width / 2.0;
@@ -79,8 +81,12 @@ void draw_expense_chart(cairo_t *cr, int width, int height, const char *yyyymm)
         return;
     }
 
+    const char **cats = rs.labels;
+    const Money *totals = rs.money[RS_TOTAL];
+    int count = rs.count;
+
     double sum = 0.0;
-    for (int i = 0; i < count; ++i) sum += totals[i];
+    for (int i = 0; i < count; ++i) sum += money_to_double(totals[i]);
     if (sum <= 0.0) sum = 1.0;
 
     double cx = width / 2.0;
@@ -93,7 +99,7 @@ void draw_expense_chart(cairo_t *cr, int width, int height, const char *yyyymm)
     double angle = -M_PI / 2.0;
     for (int i = 0; i < count; ++i) {
         double r, g, b; color_from_category(cats[i], &r, &g, &b);
-        double sweep = (totals[i] / sum) * 2 * M_PI;
+        double sweep = (money_to_double(totals[i]) / sum) * 2 * M_PI;
         cairo_set_source_rgb(cr, r, g, b);
         cairo_move_to(cr, cx, cy);
         cairo_arc(cr, cx, cy, radius, angle, angle + sweep);
@@ -116,14 +122,15 @@ void draw_expense_chart(cairo_t *cr, int width, int height, const char *yyyymm)
     char label[256];
     char currency[32] = "$";
     if (get_setting("currency", currency, sizeof(currency)) != 0) strncpy(currency, "$", sizeof(currency));
-    snprintf(label, sizeof(label), "%s: %s%.2f", cats[i], currency, totals[i]);
+    char amount[64];
+    format_money(totals[i], currency, amount, sizeof(amount));
+    snprintf(label, sizeof(label), "%s: %s", cats[i], amount);
         cairo_move_to(cr, x + 18, y);
         cairo_show_text(cr, label);
         y += 18;
     }
 
-    for (int i = 0; i < count; ++i) free(cats[i]);
-    free(cats); free(totals);
+    result_set_free(&rs);
 }
 
 void draw_bar_chart(cairo_t *cr, int width, int height, int months_back)
@@ -132,11 +139,9 @@ void draw_bar_chart(cairo_t *cr, int width, int height, int months_back)
     cairo_set_source_rgb(cr, 1, 1, 1);
     cairo_paint(cr);
     
-    char **months = NULL;
-    double *income = NULL;
-    double *expense = NULL;
-    int count = 0;
-    if (get_monthly_totals(months_back, &months, &income, &expense, &count) != 0 || count == 0) {
+    ResultSet agg;
+    if (fetch_monthly_aggregate(months_back, NULL, &agg) != 0 || agg.count == 0) {
+        result_set_free(&agg);
         cairo_set_source_rgb(cr, 0.2, 0.2, 0.2);
         cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
         cairo_set_font_size(cr, 14);
@@ -144,11 +149,14 @@ void draw_bar_chart(cairo_t *cr, int width, int height, int months_back)
         cairo_show_text(cr, "No data available for bar chart.");
         return;
     }
+    const Money *income = agg.money[RS_INCOME];
+    const Money *expense = agg.money[RS_EXPENSE];
+    int count = agg.count;
     
     double max_val = 0.0;
     for (int i = 0; i < count; ++i) {
-        if (income[i] > max_val) max_val = income[i];
-        if (expense[i] > max_val) max_val = expense[i];
+        if (money_to_double(income[i]) > max_val) max_val = money_to_double(income[i]);
+        if (money_to_double(expense[i]) > max_val) max_val = money_to_double(expense[i]);
     }
     if (max_val <= 0.0) max_val = 1.0;
     
@@ -160,8 +168,8 @@ void draw_bar_chart(cairo_t *cr, int width, int height, int months_back)
     
     for (int i = 0; i < count; ++i) {
         double x = margin + i * (bar_width * 2 + spacing);
-        double income_height = (income[i] / max_val) * chart_height;
-        double expense_height = (expense[i] / max_val) * chart_height;
+        double income_height = (money_to_double(income[i]) / max_val) * chart_height;
+        double expense_height = (money_to_double(expense[i]) / max_val) * chart_height;
         
         /* Income bar (green) */
         cairo_set_source_rgb(cr, 0.2, 0.8, 0.2);
@@ -178,9 +186,9 @@ void draw_bar_chart(cairo_t *cr, int width, int height, int months_back)
         cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
         cairo_set_font_size(cr, 10);
         cairo_text_extents_t ext;
-        cairo_text_extents(cr, months[i], &ext);
+        cairo_text_extents(cr, agg.labels[i], &ext);
         cairo_move_to(cr, x + bar_width - ext.width / 2, height - margin + 15);
-        cairo_show_text(cr, months[i]);
+        cairo_show_text(cr, agg.labels[i]);
     }
     
     /* Y-axis labels */
@@ -195,8 +203,7 @@ void draw_bar_chart(cairo_t *cr, int width, int height, int months_back)
         cairo_show_text(cr, label);
     }
     
-    for (int i = 0; i < count; ++i) free(months[i]);
-    free(months); free(income); free(expense);
+    result_set_free(&agg);
 }
 
 void draw_line_chart(cairo_t *cr, int width, int height, const char *category, int months_back)
@@ -205,10 +212,9 @@ void draw_line_chart(cairo_t *cr, int width, int height, const char *category, i
     cairo_set_source_rgb(cr, 1, 1, 1);
     cairo_paint(cr);
     
-    char **months = NULL;
-    double *amounts = NULL;
-    int count = 0;
-    if (get_category_trends(category, months_back, &months, &amounts, &count) != 0 || count == 0) {
+    ResultSet agg;
+    if (fetch_monthly_aggregate(months_back, category, &agg) != 0 || agg.count == 0) {
+        result_set_free(&agg);
         cairo_set_source_rgb(cr, 0.2, 0.2, 0.2);
         cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
         cairo_set_font_size(cr, 14);
@@ -216,10 +222,12 @@ void draw_line_chart(cairo_t *cr, int width, int height, const char *category, i
         cairo_show_text(cr, "No data available for this category.");
         return;
     }
+    const Money *amounts = agg.money[RS_EXPENSE];
+    int count = agg.count;
     
     double max_val = 0.0;
     for (int i = 0; i < count; ++i) {
-        if (amounts[i] > max_val) max_val = amounts[i];
+        if (money_to_double(amounts[i]) > max_val) max_val = money_to_double(amounts[i]);
     }
     if (max_val <= 0.0) max_val = 1.0;
     
@@ -241,7 +249,7 @@ void draw_line_chart(cairo_t *cr, int width, int height, const char *category, i
     cairo_set_line_width(cr, 2.0);
     for (int i = 0; i < count; ++i) {
         double x = margin + (chart_width * i / (count - 1));
-        double y = margin + chart_height - (amounts[i] / max_val) * chart_height;
+        double y = margin + chart_height - (money_to_double(amounts[i]) / max_val) * chart_height;
         if (i == 0) {
             cairo_move_to(cr, x, y);
         } else {
@@ -254,7 +262,7 @@ void draw_line_chart(cairo_t *cr, int width, int height, const char *category, i
     cairo_set_source_rgb(cr, 0.2, 0.4, 0.8);
     for (int i = 0; i < count; ++i) {
         double x = margin + (chart_width * i / (count - 1));
-        double y = margin + chart_height - (amounts[i] / max_val) * chart_height;
+        double y = margin + chart_height - (money_to_double(amounts[i]) / max_val) * chart_height;
         cairo_arc(cr, x, y, 4, 0, 2 * M_PI);
         cairo_fill(cr);
     }
@@ -266,13 +274,12 @@ void draw_line_chart(cairo_t *cr, int width, int height, const char *category, i
     for (int i = 0; i < count; i += (count > 6 ? 2 : 1)) {
         double x = margin + (chart_width * i / (count - 1));
         cairo_text_extents_t ext;
-        cairo_text_extents(cr, months[i], &ext);
+        cairo_text_extents(cr, agg.labels[i], &ext);
         cairo_move_to(cr, x - ext.width / 2, height - margin + 15);
-        cairo_show_text(cr, months[i]);
+        cairo_show_text(cr, agg.labels[i]);
     }
     
-    for (int i = 0; i < count; ++i) free(months[i]);
-    free(months); free(amounts);
+    result_set_free(&agg);
 }
 
 void draw_forecast_chart(cairo_t *cr, int width, int height, int months_ahead)
@@ -281,9 +288,9 @@ void draw_forecast_chart(cairo_t *cr, int width, int height, int months_ahead)
     cairo_set_source_rgb(cr, 1, 1, 1);
     cairo_paint(cr);
     
-    Forecast *forecasts = NULL;
-    int count = 0;
-    if (generate_forecast(months_ahead, &forecasts, &count) != 0 || count == 0) {
+    ResultSet forecast;
+    if (generate_forecast(months_ahead, &forecast) != 0 || forecast.count == 0) {
+        result_set_free(&forecast);
         cairo_set_source_rgb(cr, 0.2, 0.2, 0.2);
         cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
         cairo_set_font_size(cr, 14);
@@ -292,10 +299,14 @@ void draw_forecast_chart(cairo_t *cr, int width, int height, int months_ahead)
         return;
     }
     
+    const Money *income = forecast.money[RS_INCOME];
+    const Money *expense = forecast.money[RS_EXPENSE];
+    int count = forecast.count;
+
     double max_val = 0.0;
     for (int i = 0; i < count; ++i) {
-        if (forecasts[i].predicted_income > max_val) max_val = forecasts[i].predicted_income;
-        if (forecasts[i].predicted_expense > max_val) max_val = forecasts[i].predicted_expense;
+        if (money_to_double(income[i]) > max_val) max_val = money_to_double(income[i]);
+        if (money_to_double(expense[i]) > max_val) max_val = money_to_double(expense[i]);
     }
     if (max_val <= 0.0) max_val = 1.0;
     
@@ -309,8 +320,8 @@ void draw_forecast_chart(cairo_t *cr, int width, int height, int months_ahead)
     
     for (int i = 0; i < count; ++i) {
         double x = margin + i * (bar_width * 2 + spacing);
-        double income_height = (forecasts[i].predicted_income / max_val) * chart_height;
-        double expense_height = (forecasts[i].predicted_expense / max_val) * chart_height;
+        double income_height = (money_to_double(income[i]) / max_val) * chart_height;
+        double expense_height = (money_to_double(expense[i]) / max_val) * chart_height;
         
         /* Predicted income (light green) */
         cairo_set_source_rgba(cr, 0.4, 0.9, 0.4, 0.7);
@@ -327,12 +338,12 @@ void draw_forecast_chart(cairo_t *cr, int width, int height, int months_ahead)
         cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
         cairo_set_font_size(cr, 10);
         cairo_text_extents_t ext;
-        cairo_text_extents(cr, forecasts[i].month, &ext);
+        cairo_text_extents(cr, forecast.labels[i], &ext);
         cairo_move_to(cr, x + bar_width - ext.width / 2, height - margin + 15);
-        cairo_show_text(cr, forecasts[i].month);
+        cairo_show_text(cr, forecast.labels[i]);
     }
     
-    free(forecasts);
+    result_set_free(&forecast);
 }
 
 
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "database.h"
+#include "analytics.h"
+#include "stats.h"
+#include "arena.h"
+#include "import.h"
+#include "export.h"
+#include "recurring.h"
+#include "ledger_cache.h"
+#include "profile.h"
+
+/* Headless front-end for scripts and cron: one subcommand per run, tab-separated
+ * output on stdout, diagnostics on stderr. Exit status 0 on success, 1 when the
+ * work failed (import: when any row was rejected), 2 on bad usage. */
+
+#define CLI_DEFAULT_DB "finance.db"
+
+static void usage(FILE *f)
+{
+    fprintf(f,
+        "usage: finance_cli [--db PATH] COMMAND [ARGS]\n"
+        "\n"
+        "commands:\n"
+        "  report [YYYY-MM]                 income, expense, balance, spending and budgets for a month\n"
+        "  totals [MONTHS]                  income and expense per month, newest first (default 12)\n"
+        "  forecast [MONTHS]                projected income, expense and balance (default 6)\n"
+        "  alerts                           budgets at 80%% or more of their limit this month\n"
+        "  import FILE                      add the transactions in a CSV file\n"
+        "  export FILE [--month YYYY-MM] [--category NAME]\n"
+        "                                   write transactions; the extension picks CSV, JSONL or binary\n"
+        "  recurring                        add any recurring transactions that have come due\n"
+        "\n"
+        "The database defaults to %s in the working directory.\n", CLI_DEFAULT_DB);
+}
+
+/* Positive count argument, or fallback when absent; -1 if malformed */
+static int parse_months(const char *arg, int fallback)
+{
+    if (!arg) return fallback;
+    char *end = NULL;
+    long v = strtol(arg, &end, 10);
+    if (!end || *end || v < 1 || v > 1200) return -1;
+    return (int)v;
+}
+
+static void print_money(const char *label, Money amount)
+{
+    char buf[32];
+    money_to_string(amount, buf, sizeof(buf));
+    printf("%s\t%s\n", label, buf);
+}
+
+static int cmd_report(int argc, char **argv)
+{
+    char month[9];
+    if (argc > 1) return 2;
+    if (argc == 1) {
+        if (month_key_from_yyyymm(argv[0]) == 0) { fprintf(stderr, "report: expected YYYY-MM, got '%s'\n", argv[0]); return 2; }
+        snprintf(month, sizeof(month), "%.7s", argv[0]);
+    } else {
+        get_current_yyyymm(month);
+    }
+
+    printf("month\t%s\n", month);
+    print_money("income", get_total_income(month));
+    print_money("expense", get_total_expense(month));
+    print_money("balance", get_balance(month));
+
+    ResultSet rs;
+    if (fetch_expense_totals_by_category(month, &rs) != 0) return 1;
+    printf("\ncategory\tspent\n");
+    for (int i = 0; i < rs.count; ++i) print_money(rs.labels[i], rs.money[RS_TOTAL][i]);
+    result_set_free(&rs);
+
+    BudgetStatus *budgets = NULL;
+    int count = 0;
+    if (fetch_budget_status(month, &budgets, &count) != 0) return 1;
+    if (count > 0) printf("\nbudget\tspent\tlimit\tused%%\n");
+    for (int i = 0; i < count; ++i) {
+        char s[32], l[32];
+        money_to_string(budgets[i].spent, s, sizeof(s));
+        money_to_string(budgets[i].budget.monthly_limit, l, sizeof(l));
+        printf("%s\t%s\t%s\t%.1f\n", budgets[i].budget.category, s, l, budgets[i].progress * 100.0);
+    }
+    free(budgets);
+    return 0;
+}
+
+static int cmd_totals(int argc, char **argv)
+{
+    int months = parse_months(argc > 0 ? argv[0] : NULL, 12);
+    if (argc > 1 || months < 0) return 2;
+    ResultSet rs;
+    if (get_monthly_totals(months, &rs) != 0) return 1;
+    printf("month\tincome\texpense\tnet\n");
+    for (int i = 0; i < rs.count; ++i) {
+        Money in = rs.money[RS_INCOME][i], out = rs.money[RS_EXPENSE][i];
+        char a[32], b[32], c[32];
+        money_to_string(in, a, sizeof(a));
+        money_to_string(out, b, sizeof(b));
+        money_to_string(in - out, c, sizeof(c));
+        printf("%s\t%s\t%s\t%s\n", rs.labels[i], a, b, c);
+    }
+    result_set_free(&rs);
+    return 0;
+}
+
+static int cmd_forecast(int argc, char **argv)
+{
+    int months = parse_months(argc > 0 ? argv[0] : NULL, 6);
+    if (argc > 1 || months < 0) return 2;
+    ResultSet rs;
+    if (generate_forecast(months, &rs) != 0) return 1;
+    printf("month\tincome\texpense\tbalance\n");
+    for (int i = 0; i < rs.count; ++i) {
+        char a[32], b[32], c[32];
+        money_to_string(rs.money[RS_INCOME][i], a, sizeof(a));
+        money_to_string(rs.money[RS_EXPENSE][i], b, sizeof(b));
+        money_to_string(rs.money[RS_BALANCE][i], c, sizeof(c));
+        printf("%s\t%s\t%s\t%s\n", rs.labels[i], a, b, c);
+    }
+    result_set_free(&rs);
+    return 0;
+}
+
+static int cmd_alerts(int argc, char **argv)
+{
+    (void)argv;
+    if (argc > 0) return 2;
+    ResultSet rs;
+    if (check_budget_alerts(&rs) != 0) return 1;
+    for (int i = 0; i < rs.count; ++i) printf("%s\t%.1f\n", rs.labels[i], rs.real[i]);
+    result_set_free(&rs);
+    return 0;
+}
+
+static void report_import_error(long line, const char *message, void *user_data)
+{
+    fprintf(stderr, "%s:%ld: %s\n", (const char*)user_data, line, message);
+}
+
+static int cmd_import(int argc, char **argv)
+{
+    if (argc != 1) return 2;
+    ImportStats st;
+    if (import_csv(argv[0], report_import_error, argv[0], &st) != 0) {
+        fprintf(stderr, "import: cannot import %s\n", argv[0]);
+        return 1;
+    }
+    printf("imported\t%ld\nfailed\t%ld\n", st.rows_imported, st.rows_failed);
+    return st.rows_failed > 0 ? 1 : 0;
+}
+
+static int cmd_export(int argc, char **argv)
+{
+    if (argc < 1) return 2;
+    TxQuery q = {0};
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 >= argc) return 2;
+        if (strcmp(argv[i], "--category") == 0) {
+            q.category = argv[i + 1];
+        } else if (strcmp(argv[i], "--month") == 0) {
+            int key = month_key_from_yyyymm(argv[i + 1]);
+            if (key == 0) { fprintf(stderr, "export: expected YYYY-MM, got '%s'\n", argv[i + 1]); return 2; }
+            q.day_from = key * 100 + 1;
+            q.day_to = key * 100 + 31;
+        } else {
+            return 2;
+        }
+    }
+    ExportStats st;
+    const TxQuery *filter = (q.category || q.day_from) ? &q : NULL;
+    if (export_transactions(argv[0], export_format_from_path(argv[0]), filter, NULL, NULL, &st) != 0) {
+        fprintf(stderr, "export: cannot write %s\n", argv[0]);
+        return 1;
+    }
+    printf("exported\t%ld\n", st.rows_written);
+    return 0;
+}
+
+static int cmd_recurring(int argc, char **argv)
+{
+    (void)argv;
+    if (argc > 0) return 2;
+    int created = process_recurring_transactions();
+    if (created < 0) return 1;
+    printf("created\t%d\n", created);
+    return 0;
+}
+
+static const struct {
+    const char *name;
+    int (*run)(int argc, char **argv);
+} k_commands[] = {
+    { "report", cmd_report },
+    { "totals", cmd_totals },
+    { "forecast", cmd_forecast },
+    { "alerts", cmd_alerts },
+    { "import", cmd_import },
+    { "export", cmd_export },
+    { "recurring", cmd_recurring },
+};
+
+int main(int argc, char *argv[])
+{
+    const char *db_path = CLI_DEFAULT_DB;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) { usage(stdout); return 0; }
+        if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) { db_path = argv[++i]; continue; }
+        usage(stderr);
+        return 2;
+    }
+    if (i >= argc) { usage(stderr); return 2; }
+
+    const char *name = argv[i];
+    int (*run)(int, char **) = NULL;
+    for (size_t c = 0; c < sizeof(k_commands) / sizeof(k_commands[0]); ++c)
+        if (strcmp(k_commands[c].name, name) == 0) run = k_commands[c].run;
+    if (!run) {
+        fprintf(stderr, "finance_cli: unknown command '%s'\n", name);
+        usage(stderr);
+        return 2;
+    }
+
+    profile_init_from_env();
+    /* One query per run: loading the whole ledger into memory would cost more than it saves */
+    ledger_cache_set_enabled(0);
+    if (init_database(db_path) != 0) {
+        fprintf(stderr, "Failed to initialize database.\n");
+        return 1;
+    }
+    int rc = run(argc - i - 1, argv + i + 1);
+    if (rc == 2) {
+        fprintf(stderr, "finance_cli: bad arguments for '%s'\n", name);
+        usage(stderr);
+    }
+    close_database();
+    return rc;
+}
@@ -1,16 +1,640 @@
+#define _POSIX_C_SOURCE 200809L
 #include <sqlite3.h>
 #include <stdio.h>
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
 #include "database.h"
+#include "ledger_cache.h"
+#include "category.h"
+#include "arena.h"
+#include "recurring.h"
+#include "profile.h"
+#include "events.h"
 
-static sqlite3 *g_db = NULL;
+/* Every statement this module runs, prepared once per connection by init_database
+ * and reused for the lifetime of that connection. */
+typedef enum {
+    STMT_TX_INSERT,
+    STMT_TX_UPDATE,
+    STMT_TX_DELETE,
+    STMT_TX_BY_ID,
+    STMT_TX_PAGE,
+    STMT_TX_PAGE_CATEGORY,
+    STMT_TX_PAGE_OLDEST,
+    STMT_TX_PAGE_LARGEST,
+    STMT_TX_PAGE_SMALLEST,
+    STMT_BUDGET_UPSERT,
+    STMT_BUDGET_BY_CATEGORY,
+    STMT_BUDGET_ALL,
+    STMT_BUDGET_DELETE,
+    STMT_BUDGET_UPDATE,
+    STMT_BUDGET_STATUS,
+    STMT_BUDGET_STATUS_CATEGORY,
+    STMT_GOAL_INSERT,
+    STMT_GOAL_UPDATE,
+    STMT_GOAL_DELETE,
+    STMT_GOAL_ALL,
+    STMT_TOTAL_BY_TYPE_MONTH,
+    STMT_SPENT_IN_CATEGORY_MONTH,
+    STMT_EXPENSE_BY_CATEGORY,
+    STMT_MONTHLY_TOTALS,
+    STMT_MONTHLY_CATEGORY_TOTALS,
+    STMT_SUMMARY_VERIFY,
+    STMT_SETTING_GET,
+    STMT_SETTING_SET,
+    STMT_RT_INSERT,
+    STMT_RT_UPDATE,
+    STMT_RT_DELETE,
+    STMT_RT_ALL,
+    STMT_RT_ACTIVE,
+    STMT_RT_OCCURRENCE_INSERT,
+    STMT_RT_SET_WATERMARK,
+    STMT_CATEGORY_INTERN,
+    STMT_CATEGORY_ALL,
+    STMT_CATEGORY_RENAME,
+    STMT_CATEGORY_MATCH,
+    STMT_TX_SEARCH,
+    STMT_TX_COUNT,
+    STMT_TX_COUNT_CATEGORY,
+    STMT_TX_COUNT_MATCHING,
+    STMT_TX_ANCHORS_NEWEST,
+    STMT_TX_ANCHORS_OLDEST,
+    STMT_TX_ANCHORS_LARGEST,
+    STMT_TX_ANCHORS_SMALLEST,
+    STMT_COUNT
+} StmtId;
 
-static int exec_sql(const char *sql)
+#define TX_ANCHORS_SQL(source, order) \
+    "SELECT day, id, amount FROM (SELECT day, id, amount, ROW_NUMBER() OVER (ORDER BY " order ") AS rn " \
+    "FROM " source " WHERE (?3 = 0 OR day >= ?3) AND (?7 = 0 OR day <= ?7) AND (?6 = 0 OR category_id = ?6) " \
+    "AND (?4 IS NULL OR note LIKE ?4 OR category_id IN (SELECT id FROM categories WHERE name LIKE ?4))) " \
+    "WHERE rn % ?5 = 0 ORDER BY rn"
+
+static const char *const k_stmt_sql[STMT_COUNT] = {
+    [STMT_TX_INSERT] = "INSERT INTO transactions(type, category_id, amount, date, note, month_key, day) VALUES(?,?,?,?,?,?,?)",
+    [STMT_TX_UPDATE] = "UPDATE transactions SET type=?, category_id=?, amount=?, date=?, note=?, month_key=?, day=? WHERE id=?",
+    [STMT_TX_DELETE] = "DELETE FROM transactions WHERE id=?",
+    [STMT_TX_BY_ID] = "SELECT id, type, category_id, amount, date, note FROM transactions WHERE id=?",
+    /* keyset pages: ?1/?2 = exclusive (day, id) or (amount, id) bound, ?3/?7 = lowest/highest day,
+     * ?4 = LIKE pattern or NULL, ?5 = limit, ?6 = category id or 0, ?8 = rows to skip first.
+     * The newest-first pages fold the highest day into ?1 and leave ?7 unused. */
+    [STMT_TX_PAGE] =
+        "SELECT id, type, category_id, amount, date, note, day FROM transactions "
+        "WHERE (day, id) < (?1, ?2) AND day >= ?3 AND (?4 IS NULL OR note LIKE ?4 OR category_id IN (SELECT id FROM categories WHERE name LIKE ?4)) "
+        "ORDER BY day DESC, id DESC LIMIT ?5 OFFSET ?8",
+    [STMT_TX_PAGE_CATEGORY] =
+        "SELECT id, type, category_id, amount, date, note, day FROM transactions INDEXED BY idx_transactions_category_day "
+        "WHERE category_id = ?6 AND (day, id) < (?1, ?2) AND day >= ?3 AND (?4 IS NULL OR note LIKE ?4 OR category_id IN (SELECT id FROM categories WHERE name LIKE ?4)) "
+        "ORDER BY day DESC, id DESC LIMIT ?5 OFFSET ?8",
+    [STMT_TX_PAGE_OLDEST] =
+        "SELECT id, type, category_id, amount, date, note, day FROM transactions "
+        "WHERE (day, id) > (?1, ?2) AND day <= ?7 AND (?6 = 0 OR category_id = ?6) "
+        "AND (?4 IS NULL OR note LIKE ?4 OR category_id IN (SELECT id FROM categories WHERE name LIKE ?4)) "
+        "ORDER BY day, id LIMIT ?5 OFFSET ?8",
+    [STMT_TX_PAGE_LARGEST] =
+        "SELECT id, type, category_id, amount, date, note, day FROM transactions INDEXED BY idx_transactions_amount "
+        "WHERE (amount, id) < (?1, ?2) AND (?3 = 0 OR day >= ?3) AND (?7 = 0 OR day <= ?7) AND (?6 = 0 OR category_id = ?6) "
+        "AND (?4 IS NULL OR note LIKE ?4 OR category_id IN (SELECT id FROM categories WHERE name LIKE ?4)) "
+        "ORDER BY amount DESC, id DESC LIMIT ?5 OFFSET ?8",
+    [STMT_TX_PAGE_SMALLEST] =
+        "SELECT id, type, category_id, amount, date, note, day FROM transactions INDEXED BY idx_transactions_amount "
+        "WHERE (amount, id) > (?1, ?2) AND (?3 = 0 OR day >= ?3) AND (?7 = 0 OR day <= ?7) AND (?6 = 0 OR category_id = ?6) "
+        "AND (?4 IS NULL OR note LIKE ?4 OR category_id IN (SELECT id FROM categories WHERE name LIKE ?4)) "
+        "ORDER BY amount, id LIMIT ?5 OFFSET ?8",
+    [STMT_BUDGET_UPSERT] = "INSERT INTO budgets(category_id, monthly_limit) VALUES(?, ?) ON CONFLICT(category_id) DO UPDATE SET monthly_limit=excluded.monthly_limit",
+    [STMT_BUDGET_BY_CATEGORY] = "SELECT id, category_id, monthly_limit FROM budgets WHERE category_id=?",
+    [STMT_BUDGET_ALL] = "SELECT b.id, b.category_id, b.monthly_limit FROM budgets b JOIN categories c ON c.id = b.category_id ORDER BY c.name",
+    [STMT_BUDGET_DELETE] = "DELETE FROM budgets WHERE id=?",
+    [STMT_BUDGET_UPDATE] = "UPDATE budgets SET category_id=?, monthly_limit=? WHERE id=?",
+    /* ?1 = month key; the summary has at most one row per (month, category, type) */
+    [STMT_BUDGET_STATUS] =
+        "SELECT b.id, b.category_id, b.monthly_limit, COALESCE(s.total, 0) FROM budgets b "
+        "JOIN categories c ON c.id = b.category_id "
+        "LEFT JOIN monthly_summary s ON s.month = ?1 AND s.category_id = b.category_id AND s.type = 'expense' "
+        "ORDER BY c.name",
+    [STMT_BUDGET_STATUS_CATEGORY] =
+        "SELECT b.id, b.category_id, b.monthly_limit, COALESCE(s.total, 0) FROM budgets b "
+        "LEFT JOIN monthly_summary s ON s.month = ?1 AND s.category_id = b.category_id AND s.type = 'expense' "
+        "WHERE b.category_id = ?2",
+    [STMT_GOAL_INSERT] = "INSERT INTO goals(name, target_amount, monthly_saving, start_date) VALUES(?,?,?,?)",
+    [STMT_GOAL_UPDATE] = "UPDATE goals SET name=?, target_amount=?, monthly_saving=?, start_date=? WHERE id=?",
+    [STMT_GOAL_DELETE] = "DELETE FROM goals WHERE id=?",
+    [STMT_GOAL_ALL] = "SELECT id, name, target_amount, monthly_saving, start_date FROM goals ORDER BY id DESC",
+    [STMT_TOTAL_BY_TYPE_MONTH] = "SELECT COALESCE(SUM(total),0) FROM monthly_summary WHERE type=? AND month=?",
+    [STMT_SPENT_IN_CATEGORY_MONTH] = "SELECT COALESCE(SUM(total),0) FROM monthly_summary WHERE type='expense' AND category_id=? AND month=?",
+    [STMT_EXPENSE_BY_CATEGORY] = "SELECT category_id, total FROM monthly_summary WHERE type='expense' AND month=? ORDER BY 2 DESC",
+    [STMT_MONTHLY_TOTALS] = "SELECT month, type, SUM(total) FROM monthly_summary WHERE month BETWEEN ? AND ? GROUP BY month, type",
+    [STMT_MONTHLY_CATEGORY_TOTALS] = "SELECT month, type, total FROM monthly_summary WHERE category_id=?1 AND month BETWEEN ?2 AND ?3",
+    [STMT_SUMMARY_VERIFY] =
+        "WITH fresh AS (SELECT month_key AS month, category_id, COALESCE(type,'') AS type, SUM(amount) AS total, COUNT(*) AS count "
+        "               FROM transactions GROUP BY 1, 2, 3) "
+        "SELECT (SELECT COUNT(*) FROM fresh f LEFT JOIN monthly_summary s USING (month, category_id, type) "
+        "        WHERE s.month IS NULL OR s.count <> f.count OR s.total <> f.total) "
+        "     + (SELECT COUNT(*) FROM monthly_summary s LEFT JOIN fresh f USING (month, category_id, type) WHERE f.month IS NULL)",
+    [STMT_SETTING_GET] = "SELECT value FROM settings WHERE key=?",
+    [STMT_SETTING_SET] = "INSERT INTO settings(key, value) VALUES(?, ?) ON CONFLICT(key) DO UPDATE SET value=excluded.value",
+    [STMT_RT_INSERT] = "INSERT INTO recurring_transactions(type, category_id, amount, frequency, start_date, end_date, note, is_active) VALUES(?,?,?,?,?,?,?,?)",
+    /* a new schedule restarts from its first occurrence; the unique key skips days already materialized */
+    [STMT_RT_UPDATE] =
+        "UPDATE recurring_transactions SET type=?1, category_id=?2, amount=?3, frequency=?4, start_date=?5, end_date=?6, note=?7, is_active=?8, "
+        "last_run = CASE WHEN frequency IS ?4 AND start_date IS ?5 THEN last_run END WHERE id=?9 RETURNING last_run",
+    [STMT_RT_DELETE] = "DELETE FROM recurring_transactions WHERE id=?",
+    [STMT_RT_ALL] = "SELECT id, type, category_id, amount, frequency, start_date, end_date, note, is_active, last_run FROM recurring_transactions ORDER BY id DESC",
+    [STMT_RT_ACTIVE] = "SELECT id, type, category_id, amount, frequency, start_date, end_date, note, is_active, last_run FROM recurring_transactions WHERE is_active=1 ORDER BY id DESC",
+    [STMT_RT_OCCURRENCE_INSERT] = "INSERT OR IGNORE INTO transactions(type, category_id, amount, date, note, month_key, day, recurring_id) VALUES(?,?,?,?,?,?,?,?)",
+    [STMT_RT_SET_WATERMARK] = "UPDATE recurring_transactions SET last_run=? WHERE id=?",
+    [STMT_CATEGORY_INTERN] = "INSERT INTO categories(name) VALUES(?) ON CONFLICT(name) DO UPDATE SET name=excluded.name RETURNING id",
+    [STMT_CATEGORY_ALL] = "SELECT id, name FROM categories",
+    [STMT_CATEGORY_RENAME] = "UPDATE categories SET name=? WHERE id=?",
+    [STMT_CATEGORY_MATCH] = "SELECT rowid FROM categories_fts WHERE categories_fts MATCH ?",
+    /* ?1 = FTS5 query, ?2 = limit. rank is bm25 weighted towards category (migration 6)
+     * over every match; FTS5 sorts by rank itself, so snippets are only built for the
+     * rows kept. Equal scores list the newest first. */
+    [STMT_TX_SEARCH] =
+        "SELECT t.id, t.type, t.category_id, t.amount, t.date, t.note, w.score, w.snip "
+        "FROM (SELECT rowid, rank AS score, snippet(transactions_fts, 1, char(2), char(3), '...', 12) AS snip "
+        "      FROM transactions_fts WHERE transactions_fts MATCH ?1 ORDER BY rank LIMIT ?2) w "
+        "JOIN transactions t ON t.id = w.rowid ORDER BY w.score, w.rowid DESC",
+    [STMT_TX_COUNT] = "SELECT COALESCE(SUM(count),0) FROM monthly_summary",
+    [STMT_TX_COUNT_CATEGORY] = "SELECT COALESCE(SUM(count),0) FROM monthly_summary WHERE category_id = ?",
+    /* same filter parameters as the keyset pages */
+    [STMT_TX_COUNT_MATCHING] =
+        "SELECT COUNT(*) FROM transactions WHERE day BETWEEN ?3 AND ?7 AND (?6 = 0 OR category_id = ?6) "
+        "AND (?4 IS NULL OR note LIKE ?4 OR category_id IN (SELECT id FROM categories WHERE name LIKE ?4))",
+    /* page boundaries: the sort key of every ?5-th row in page order, same filter again;
+     * the window reads its order's index instead of sorting */
+    [STMT_TX_ANCHORS_NEWEST] = TX_ANCHORS_SQL("transactions", "day DESC, id DESC"),
+    [STMT_TX_ANCHORS_OLDEST] = TX_ANCHORS_SQL("transactions", "day, id"),
+    [STMT_TX_ANCHORS_LARGEST] = TX_ANCHORS_SQL("transactions INDEXED BY idx_transactions_amount", "amount DESC, id DESC"),
+    [STMT_TX_ANCHORS_SMALLEST] = TX_ANCHORS_SQL("transactions INDEXED BY idx_transactions_amount", "amount, id"),
+};
+
+/* Probe names for the cached statements' timings (profile.h) */
+static const char *const k_stmt_probe[STMT_COUNT] = {
+    [STMT_TX_INSERT] = "sql:tx_insert",
+    [STMT_TX_UPDATE] = "sql:tx_update",
+    [STMT_TX_DELETE] = "sql:tx_delete",
+    [STMT_TX_BY_ID] = "sql:tx_by_id",
+    [STMT_TX_PAGE] = "sql:tx_page",
+    [STMT_TX_PAGE_CATEGORY] = "sql:tx_page_category",
+    [STMT_TX_PAGE_OLDEST] = "sql:tx_page_oldest",
+    [STMT_TX_PAGE_LARGEST] = "sql:tx_page_largest",
+    [STMT_TX_PAGE_SMALLEST] = "sql:tx_page_smallest",
+    [STMT_BUDGET_UPSERT] = "sql:budget_upsert",
+    [STMT_BUDGET_BY_CATEGORY] = "sql:budget_by_category",
+    [STMT_BUDGET_ALL] = "sql:budget_all",
+    [STMT_BUDGET_DELETE] = "sql:budget_delete",
+    [STMT_BUDGET_UPDATE] = "sql:budget_update",
+    [STMT_BUDGET_STATUS] = "sql:budget_status",
+    [STMT_BUDGET_STATUS_CATEGORY] = "sql:budget_status_category",
+    [STMT_GOAL_INSERT] = "sql:goal_insert",
+    [STMT_GOAL_UPDATE] = "sql:goal_update",
+    [STMT_GOAL_DELETE] = "sql:goal_delete",
+    [STMT_GOAL_ALL] = "sql:goal_all",
+    [STMT_TOTAL_BY_TYPE_MONTH] = "sql:total_by_type_month",
+    [STMT_SPENT_IN_CATEGORY_MONTH] = "sql:spent_in_category_month",
+    [STMT_EXPENSE_BY_CATEGORY] = "sql:expense_by_category",
+    [STMT_MONTHLY_TOTALS] = "sql:monthly_totals",
+    [STMT_MONTHLY_CATEGORY_TOTALS] = "sql:monthly_category_totals",
+    [STMT_SUMMARY_VERIFY] = "sql:summary_verify",
+    [STMT_SETTING_GET] = "sql:setting_get",
+    [STMT_SETTING_SET] = "sql:setting_set",
+    [STMT_RT_INSERT] = "sql:rt_insert",
+    [STMT_RT_UPDATE] = "sql:rt_update",
+    [STMT_RT_DELETE] = "sql:rt_delete",
+    [STMT_RT_ALL] = "sql:rt_all",
+    [STMT_RT_ACTIVE] = "sql:rt_active",
+    [STMT_RT_OCCURRENCE_INSERT] = "sql:rt_occurrence_insert",
+    [STMT_RT_SET_WATERMARK] = "sql:rt_set_watermark",
+    [STMT_CATEGORY_INTERN] = "sql:category_intern",
+    [STMT_CATEGORY_ALL] = "sql:category_all",
+    [STMT_CATEGORY_RENAME] = "sql:category_rename",
+    [STMT_CATEGORY_MATCH] = "sql:category_match",
+    [STMT_TX_SEARCH] = "sql:tx_search",
+    [STMT_TX_COUNT] = "sql:tx_count",
+    [STMT_TX_COUNT_CATEGORY] = "sql:tx_count_category",
+    [STMT_TX_COUNT_MATCHING] = "sql:tx_count_matching",
+    [STMT_TX_ANCHORS_NEWEST] = "sql:tx_anchors_newest",
+    [STMT_TX_ANCHORS_OLDEST] = "sql:tx_anchors_oldest",
+    [STMT_TX_ANCHORS_LARGEST] = "sql:tx_anchors_largest",
+    [STMT_TX_ANCHORS_SMALLEST] = "sql:tx_anchors_smallest",
+};
+
+/* One SQLite handle plus its statement cache. The writer is used by default;
+ * a thread that checks out a reader runs every query below on it instead. */
+typedef struct DbConn {
+    sqlite3 *db;
+    sqlite3_stmt *stmts[STMT_COUNT];
+    uint64_t acquired_ns[STMT_COUNT];  /* for the statement probes */
+    void *trace_top;                   /* statement the last top-level trace event was for */
+    int in_use;
+    /* change events of the open transaction, published by db_commit_transaction */
+    ChangeEvent *pending;
+    int pending_count, pending_cap;
+    unsigned pending_reset;            /* bit per ChangeTable: too many to list, publish CHANGE_RESET */
+    /* categories created, renamed or removed by the open transaction, published at COMMIT */
+    CategoryChange *new_categories;
+    int new_category_count, new_category_cap;
+    /* ledger cache writes of the open transaction, applied by db_commit_transaction */
+    LedgerWrite *ledger_writes;
+    int ledger_write_count, ledger_write_cap;
+    int ledger_reset;                  /* too many to hold: reload the cache instead */
+    int bulk_from_id;                  /* first row id of the open bulk transaction; 0 outside one */
+} DbConn;
+
+static DbConn g_writer;
+static DbConn g_thread_writer;    /* second read-write connection, for db_writer_thread_attach */
+static char *g_db_path = NULL;
+static DbConn g_readers[DB_READER_POOL_SIZE];
+static int g_reader_count = 0;
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_pool_cond = PTHREAD_COND_INITIALIZER;
+static _Thread_local DbConn *t_conn = NULL;
+
+static DbConn *current_conn(void)
+{
+    return t_conn ? t_conn : &g_writer;
+}
+
+/* More changes than this in one transaction are published as one CHANGE_RESET per
+ * table instead; subscribers would reload rather than patch that many rows anyway. */
+#define PENDING_CHANGES_MAX 1024
+
+/* Whether a mutator should build an event for table; skips the work (and the
+ * before-image reads) when nobody listens or the table is already being reset. */
+static int change_wanted(ChangeTable table)
+{
+    return events_has_subscribers() && !(current_conn()->pending_reset & (1u << table));
+}
+
+static void collapse_pending(DbConn *conn, ChangeTable table)
+{
+    int kept = 0;
+    for (int i = 0; i < conn->pending_count; ++i)
+        if (conn->pending[i].table != table) conn->pending[kept++] = conn->pending[i];
+    conn->pending_count = kept;
+    conn->pending_reset |= 1u << table;
+}
+
+/* Publish straight away in autocommit mode, else hold until the commit */
+static void note_change(const ChangeEvent *ev)
+{
+    DbConn *conn = current_conn();
+    if (sqlite3_get_autocommit(conn->db)) {
+        events_publish(ev);
+        return;
+    }
+    if (conn->pending_reset & (1u << ev->table)) return;
+    if (ev->kind == CHANGE_RESET) {
+        collapse_pending(conn, ev->table);
+        return;
+    }
+    if (conn->pending_count == conn->pending_cap) {
+        int ncap = conn->pending_cap ? conn->pending_cap * 2 : 16;
+        ChangeEvent *tmp = ncap <= PENDING_CHANGES_MAX ? (ChangeEvent*)realloc(conn->pending, ncap * sizeof(ChangeEvent)) : NULL;
+        if (!tmp) {
+            collapse_pending(conn, ev->table);
+            return;
+        }
+        conn->pending = tmp; conn->pending_cap = ncap;
+    }
+    conn->pending[conn->pending_count++] = *ev;
+}
+
+static void note_reset(ChangeTable table)
+{
+    if (!events_has_subscribers()) return;
+    ChangeEvent ev = { .table = table, .kind = CHANGE_RESET };
+    note_change(&ev);
+}
+
+/* The ledger cache is patched in place rather than rescanned, but only with
+ * committed writes: applied straight away in autocommit mode, else at the commit. */
+#define PENDING_LEDGER_MAX 4096
+
+static void note_ledger_write(const LedgerWrite *w)
+{
+    DbConn *conn = current_conn();
+    if (sqlite3_get_autocommit(conn->db)) {
+        ledger_cache_apply(w, 1);
+        return;
+    }
+    if (conn->ledger_reset) return;
+    if (conn->ledger_write_count == conn->ledger_write_cap) {
+        int ncap = conn->ledger_write_cap ? conn->ledger_write_cap * 2 : 16;
+        LedgerWrite *tmp = ncap <= PENDING_LEDGER_MAX ? (LedgerWrite*)realloc(conn->ledger_writes, ncap * sizeof(LedgerWrite)) : NULL;
+        if (!tmp) {
+            conn->ledger_reset = 1;
+            conn->ledger_write_count = 0;
+            return;
+        }
+        conn->ledger_writes = tmp; conn->ledger_write_cap = ncap;
+    }
+    conn->ledger_writes[conn->ledger_write_count++] = *w;
+}
+
+static void note_ledger_upsert(const Transaction *t)
+{
+    LedgerWrite w = { .kind = LEDGER_UPSERT };
+    w.u.t = *t;
+    note_ledger_write(&w);
+}
+
+static void note_ledger_delete(int id)
+{
+    LedgerWrite w = { .kind = LEDGER_DELETE, .u.id = id };
+    note_ledger_write(&w);
+}
+
+static void finish_ledger(DbConn *conn, int committed)
+{
+    int count = conn->ledger_write_count, reset = conn->ledger_reset;
+    conn->ledger_write_count = 0;
+    conn->ledger_reset = 0;
+    if (!committed) return;
+    if (reset) ledger_cache_invalidate();
+    else ledger_cache_apply(conn->ledger_writes, count);
+}
+
+/* End of a transaction: publish its category changes, or drop them on rollback */
+static void finish_new_categories(DbConn *conn, int committed)
+{
+    if (committed && category_interner_apply(conn->new_categories, conn->new_category_count) != 0)
+        fprintf(stderr, "category interner out of sync after commit\n");
+    conn->new_category_count = 0;
+}
+
+/* End of a transaction: publish what it changed, or drop it on rollback */
+static void finish_pending(DbConn *conn, int committed)
+{
+    int count = conn->pending_count;
+    unsigned reset = conn->pending_reset;
+    conn->pending_count = 0;
+    conn->pending_reset = 0;
+    if (!committed) return;
+    for (int i = 0; i < count; ++i) events_publish(&conn->pending[i]);
+    for (int t = 0; t < CHANGE_TABLE_COUNT; ++t) {
+        if (!(reset & (1u << t))) continue;
+        ChangeEvent ev = { .table = (ChangeTable)t, .kind = CHANGE_RESET };
+        events_publish(&ev);
+    }
+}
+
+static int prepare_statements(DbConn *conn)
+{
+    for (int i = 0; i < STMT_COUNT; ++i) {
+        if (sqlite3_prepare_v3(conn->db, k_stmt_sql[i], -1, SQLITE_PREPARE_PERSISTENT, &conn->stmts[i], NULL) != SQLITE_OK) {
+            fprintf(stderr, "Cannot prepare statement %d: %s\n", i, sqlite3_errmsg(conn->db));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void finalize_statements(DbConn *conn)
+{
+    for (int i = 0; i < STMT_COUNT; ++i) {
+        sqlite3_finalize(conn->stmts[i]);
+        conn->stmts[i] = NULL;
+    }
+}
+
+static ProfileProbe g_stmt_probes[STMT_COUNT];
+static ProfileProbe g_other_sql_probe;
+
+/* Hand out a cached statement with bindings cleared, ready to bind and step. */
+static sqlite3_stmt *stmt_acquire(StmtId id)
+{
+    DbConn *conn = current_conn();
+    sqlite3_stmt *stmt = conn->stmts[id];
+    if (!stmt) return NULL;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    conn->acquired_ns[id] = profile_now_ns();
+    return stmt;
+}
+
+/* Reset after use so the statement does not keep a read transaction open. */
+static void stmt_release(sqlite3_stmt *stmt)
+{
+    if (!stmt) return;
+    sqlite3_reset(stmt);
+    DbConn *conn = current_conn();
+    for (int i = 0; i < STMT_COUNT; ++i) {
+        if (conn->stmts[i] == stmt) {
+            profile_record(&g_stmt_probes[i], k_stmt_probe[i], profile_now_ns() - conn->acquired_ns[i], 0);
+            return;
+        }
+    }
+}
+
+/* SQLite's own profile events only have millisecond resolution, so they are
+ * used for the SQL run outside the statement cache (migrations, bulk commits,
+ * exec_sql); cached statements are timed from acquire to release instead.
+ * Statements run from inside another, such as FTS5's shadow table writes,
+ * count towards the outer one's time rather than as calls of their own. */
+static int trace_statement(unsigned type, void *ctx, void *p, void *x)
+{
+    DbConn *conn = (DbConn*)ctx;
+    if (type == SQLITE_TRACE_STMT) {
+        /* SQLite prefixes nested statements and trigger programs with "--" */
+        if (strncmp((const char*)x, "--", 2) != 0) conn->trace_top = p;
+        return 0;
+    }
+    if (p != conn->trace_top) return 0;
+    conn->trace_top = NULL;
+    for (int i = 0; i < STMT_COUNT; ++i)
+        if (conn->stmts[i] == p) return 0;
+    profile_record(&g_other_sql_probe, "sql:other", (uint64_t)*(const sqlite3_int64*)x, 0);
+    return 0;
+}
+
+/* Shared with the bulk-insert path, which drops these for the length of a load. */
+#define SUMMARY_INSERT_TRIGGER_SQL \
+    "CREATE TRIGGER trg_summary_insert AFTER INSERT ON transactions BEGIN " \
+    "  INSERT INTO monthly_summary(month, category_id, type, total, count) VALUES (NEW.month_key, NEW.category_id, COALESCE(NEW.type,''), NEW.amount, 1) " \
+    "    ON CONFLICT(month, category_id, type) DO UPDATE SET total = total + excluded.total, count = count + 1; " \
+    "END;"
+/* The category column holds a token for the category's id ('c' || id), not its
+ * name, so a rename never touches the index; search_transactions maps name
+ * terms to ids through categories_fts. */
+#define FTS_INSERT_TRIGGER_SQL \
+    "CREATE TRIGGER trg_fts_insert AFTER INSERT ON transactions BEGIN " \
+    "  INSERT INTO transactions_fts(rowid, category, note) VALUES (NEW.id, 'c' || NEW.category_id, COALESCE(NEW.note,'')); " \
+    "END;"
+
+/* Schema migrations, applied in order on top of the base tables created in
+ * init_database. PRAGMA user_version records how many have run, so each
+ * entry executes exactly once per database file. Append only. */
+static const char *const k_migrations[] = {
+    /* 1: integer day (YYYYMMDD) and month (YYYYMM) keys so date filters can use indexes */
+    "ALTER TABLE transactions ADD COLUMN month_key INTEGER NOT NULL DEFAULT 0;"
+    "ALTER TABLE transactions ADD COLUMN day INTEGER NOT NULL DEFAULT 0;"
+    "UPDATE transactions SET day = day_key(date), month_key = day_key(date) / 100;"
+    "CREATE INDEX IF NOT EXISTS idx_transactions_type_month ON transactions(type, month_key);"
+    "CREATE INDEX IF NOT EXISTS idx_transactions_category_month ON transactions(category, month_key);"
+    "CREATE INDEX IF NOT EXISTS idx_transactions_day ON transactions(day, id);",
+    /* 2: per (month, category, type) totals kept current by triggers, so reports never scan transactions */
+    "CREATE TABLE IF NOT EXISTS monthly_summary (month INTEGER NOT NULL, category TEXT NOT NULL, type TEXT NOT NULL, total REAL NOT NULL DEFAULT 0, count INTEGER NOT NULL DEFAULT 0, PRIMARY KEY (month, category, type)) WITHOUT ROWID;"
+    "CREATE TRIGGER IF NOT EXISTS trg_summary_insert AFTER INSERT ON transactions BEGIN "
+    "  INSERT INTO monthly_summary(month, category, type, total, count) VALUES (NEW.month_key, COALESCE(NEW.category,''), COALESCE(NEW.type,''), NEW.amount, 1) "
+    "    ON CONFLICT(month, category, type) DO UPDATE SET total = total + excluded.total, count = count + 1; "
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS trg_summary_delete AFTER DELETE ON transactions BEGIN "
+    "  UPDATE monthly_summary SET total = total - OLD.amount, count = count - 1 WHERE month = OLD.month_key AND category = COALESCE(OLD.category,'') AND type = COALESCE(OLD.type,''); "
+    "  DELETE FROM monthly_summary WHERE month = OLD.month_key AND category = COALESCE(OLD.category,'') AND type = COALESCE(OLD.type,'') AND count <= 0; "
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS trg_summary_update AFTER UPDATE OF type, category, amount, month_key ON transactions BEGIN "
+    "  UPDATE monthly_summary SET total = total - OLD.amount, count = count - 1 WHERE month = OLD.month_key AND category = COALESCE(OLD.category,'') AND type = COALESCE(OLD.type,''); "
+    "  DELETE FROM monthly_summary WHERE month = OLD.month_key AND category = COALESCE(OLD.category,'') AND type = COALESCE(OLD.type,'') AND count <= 0; "
+    "  INSERT INTO monthly_summary(month, category, type, total, count) VALUES (NEW.month_key, COALESCE(NEW.category,''), COALESCE(NEW.type,''), NEW.amount, 1) "
+    "    ON CONFLICT(month, category, type) DO UPDATE SET total = total + excluded.total, count = count + 1; "
+    "END;"
+    "DELETE FROM monthly_summary;"
+    "INSERT INTO monthly_summary(month, category, type, total, count) "
+    "  SELECT month_key, COALESCE(category,''), COALESCE(type,''), SUM(amount), COUNT(*) FROM transactions GROUP BY 1, 2, 3;",
+    /* 3: keyset pages filtered by category walk this instead of sorting the category's rows */
+    "CREATE INDEX IF NOT EXISTS idx_transactions_category_day ON transactions(category, day, id);",
+    /* 4: categories become rows of their own; every other table stores the integer id */
+    "CREATE TABLE IF NOT EXISTS categories (id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE);"
+    "INSERT OR IGNORE INTO categories(name) "
+    "  SELECT COALESCE(category,'') FROM transactions UNION SELECT COALESCE(category,'') FROM budgets "
+    "  UNION SELECT COALESCE(category,'') FROM recurring_transactions;"
+    "DROP TRIGGER IF EXISTS trg_summary_insert;"
+    "DROP TRIGGER IF EXISTS trg_summary_delete;"
+    "DROP TRIGGER IF EXISTS trg_summary_update;"
+    "DROP INDEX IF EXISTS idx_transactions_category_month;"
+    "DROP INDEX IF EXISTS idx_transactions_category_day;"
+    "ALTER TABLE transactions ADD COLUMN category_id INTEGER NOT NULL DEFAULT 0;"
+    "UPDATE transactions SET category_id = (SELECT id FROM categories WHERE name = COALESCE(transactions.category,''));"
+    "ALTER TABLE transactions DROP COLUMN category;"
+    "CREATE INDEX idx_transactions_category_month ON transactions(category_id, month_key);"
+    "CREATE INDEX idx_transactions_category_day ON transactions(category_id, day, id);"
+    "ALTER TABLE recurring_transactions ADD COLUMN category_id INTEGER NOT NULL DEFAULT 0;"
+    "UPDATE recurring_transactions SET category_id = (SELECT id FROM categories WHERE name = COALESCE(recurring_transactions.category,''));"
+    "ALTER TABLE recurring_transactions DROP COLUMN category;"
+    "CREATE TABLE budgets_new (id INTEGER PRIMARY KEY AUTOINCREMENT, category_id INTEGER NOT NULL UNIQUE, monthly_limit REAL);"
+    "INSERT INTO budgets_new(id, category_id, monthly_limit) "
+    "  SELECT b.id, c.id, b.monthly_limit FROM budgets b JOIN categories c ON c.name = COALESCE(b.category,'');"
+    "DROP TABLE budgets;"
+    "ALTER TABLE budgets_new RENAME TO budgets;"
+    "DROP TABLE monthly_summary;"
+    "CREATE TABLE monthly_summary (month INTEGER NOT NULL, category_id INTEGER NOT NULL, type TEXT NOT NULL, total REAL NOT NULL DEFAULT 0, count INTEGER NOT NULL DEFAULT 0, PRIMARY KEY (month, category_id, type)) WITHOUT ROWID;"
+    "CREATE TRIGGER trg_summary_insert AFTER INSERT ON transactions BEGIN "
+    "  INSERT INTO monthly_summary(month, category_id, type, total, count) VALUES (NEW.month_key, NEW.category_id, COALESCE(NEW.type,''), NEW.amount, 1) "
+    "    ON CONFLICT(month, category_id, type) DO UPDATE SET total = total + excluded.total, count = count + 1; "
+    "END;"
+    "CREATE TRIGGER trg_summary_delete AFTER DELETE ON transactions BEGIN "
+    "  UPDATE monthly_summary SET total = total - OLD.amount, count = count - 1 WHERE month = OLD.month_key AND category_id = OLD.category_id AND type = COALESCE(OLD.type,''); "
+    "  DELETE FROM monthly_summary WHERE month = OLD.month_key AND category_id = OLD.category_id AND type = COALESCE(OLD.type,'') AND count <= 0; "
+    "END;"
+    "CREATE TRIGGER trg_summary_update AFTER UPDATE OF type, category_id, amount, month_key ON transactions BEGIN "
+    "  UPDATE monthly_summary SET total = total - OLD.amount, count = count - 1 WHERE month = OLD.month_key AND category_id = OLD.category_id AND type = COALESCE(OLD.type,''); "
+    "  DELETE FROM monthly_summary WHERE month = OLD.month_key AND category_id = OLD.category_id AND type = COALESCE(OLD.type,'') AND count <= 0; "
+    "  INSERT INTO monthly_summary(month, category_id, type, total, count) VALUES (NEW.month_key, NEW.category_id, COALESCE(NEW.type,''), NEW.amount, 1) "
+    "    ON CONFLICT(month, category_id, type) DO UPDATE SET total = total + excluded.total, count = count + 1; "
+    "END;"
+    "INSERT INTO monthly_summary(month, category_id, type, total, count) "
+    "  SELECT month_key, category_id, COALESCE(type,''), SUM(amount), COUNT(*) FROM transactions GROUP BY 1, 2, 3;",
+    /* 5: money columns become INTEGER minor units (cents) under the same names */
+    "DROP TRIGGER IF EXISTS trg_summary_insert;"
+    "DROP TRIGGER IF EXISTS trg_summary_delete;"
+    "DROP TRIGGER IF EXISTS trg_summary_update;"
+    "ALTER TABLE transactions ADD COLUMN amount_cents INTEGER NOT NULL DEFAULT 0;"
+    "UPDATE transactions SET amount_cents = CAST(ROUND(COALESCE(amount,0) * 100) AS INTEGER);"
+    "ALTER TABLE transactions DROP COLUMN amount;"
+    "ALTER TABLE transactions RENAME COLUMN amount_cents TO amount;"
+    "ALTER TABLE recurring_transactions ADD COLUMN amount_cents INTEGER NOT NULL DEFAULT 0;"
+    "UPDATE recurring_transactions SET amount_cents = CAST(ROUND(COALESCE(amount,0) * 100) AS INTEGER);"
+    "ALTER TABLE recurring_transactions DROP COLUMN amount;"
+    "ALTER TABLE recurring_transactions RENAME COLUMN amount_cents TO amount;"
+    "ALTER TABLE budgets ADD COLUMN limit_cents INTEGER NOT NULL DEFAULT 0;"
+    "UPDATE budgets SET limit_cents = CAST(ROUND(COALESCE(monthly_limit,0) * 100) AS INTEGER);"
+    "ALTER TABLE budgets DROP COLUMN monthly_limit;"
+    "ALTER TABLE budgets RENAME COLUMN limit_cents TO monthly_limit;"
+    "ALTER TABLE goals ADD COLUMN target_cents INTEGER NOT NULL DEFAULT 0;"
+    "ALTER TABLE goals ADD COLUMN saving_cents INTEGER NOT NULL DEFAULT 0;"
+    "UPDATE goals SET target_cents = CAST(ROUND(COALESCE(target_amount,0) * 100) AS INTEGER), "
+    "  saving_cents = CAST(ROUND(COALESCE(monthly_saving,0) * 100) AS INTEGER);"
+    "ALTER TABLE goals DROP COLUMN target_amount;"
+    "ALTER TABLE goals DROP COLUMN monthly_saving;"
+    "ALTER TABLE goals RENAME COLUMN target_cents TO target_amount;"
+    "ALTER TABLE goals RENAME COLUMN saving_cents TO monthly_saving;"
+    "DROP TABLE monthly_summary;"
+    "CREATE TABLE monthly_summary (month INTEGER NOT NULL, category_id INTEGER NOT NULL, type TEXT NOT NULL, total INTEGER NOT NULL DEFAULT 0, count INTEGER NOT NULL DEFAULT 0, PRIMARY KEY (month, category_id, type)) WITHOUT ROWID;"
+    SUMMARY_INSERT_TRIGGER_SQL
+    "CREATE TRIGGER trg_summary_delete AFTER DELETE ON transactions BEGIN "
+    "  UPDATE monthly_summary SET total = total - OLD.amount, count = count - 1 WHERE month = OLD.month_key AND category_id = OLD.category_id AND type = COALESCE(OLD.type,''); "
+    "  DELETE FROM monthly_summary WHERE month = OLD.month_key AND category_id = OLD.category_id AND type = COALESCE(OLD.type,'') AND count <= 0; "
+    "END;"
+    "CREATE TRIGGER trg_summary_update AFTER UPDATE OF type, category_id, amount, month_key ON transactions BEGIN "
+    "  UPDATE monthly_summary SET total = total - OLD.amount, count = count - 1 WHERE month = OLD.month_key AND category_id = OLD.category_id AND type = COALESCE(OLD.type,''); "
+    "  DELETE FROM monthly_summary WHERE month = OLD.month_key AND category_id = OLD.category_id AND type = COALESCE(OLD.type,'') AND count <= 0; "
+    "  INSERT INTO monthly_summary(month, category_id, type, total, count) VALUES (NEW.month_key, NEW.category_id, COALESCE(NEW.type,''), NEW.amount, 1) "
+    "    ON CONFLICT(month, category_id, type) DO UPDATE SET total = total + excluded.total, count = count + 1; "
+    "END;"
+    "INSERT INTO monthly_summary(month, category_id, type, total, count) "
+    "  SELECT month_key, category_id, COALESCE(type,''), SUM(amount), COUNT(*) FROM transactions GROUP BY 1, 2, 3;",
+    /* 6: full-text index over category name and note, kept in sync by triggers */
+    "CREATE VIRTUAL TABLE transactions_fts USING fts5(category, note, tokenize='unicode61 remove_diacritics 2', prefix='2 3');"
+    "INSERT INTO transactions_fts(transactions_fts, rank) VALUES('rank', 'bm25(2.0, 1.0)');"
+    "INSERT INTO transactions_fts(rowid, category, note) "
+    "  SELECT t.id, COALESCE(c.name,''), COALESCE(t.note,'') FROM transactions t LEFT JOIN categories c ON c.id = t.category_id;"
+    "CREATE TRIGGER trg_fts_insert AFTER INSERT ON transactions BEGIN "
+    "  INSERT INTO transactions_fts(rowid, category, note) "
+    "    VALUES (NEW.id, COALESCE((SELECT name FROM categories WHERE id = NEW.category_id),''), COALESCE(NEW.note,'')); "
+    "END;"
+    "CREATE TRIGGER trg_fts_delete AFTER DELETE ON transactions BEGIN "
+    "  DELETE FROM transactions_fts WHERE rowid = OLD.id; "
+    "END;"
+    "CREATE TRIGGER trg_fts_update AFTER UPDATE OF category_id, note ON transactions BEGIN "
+    "  UPDATE transactions_fts SET category = COALESCE((SELECT name FROM categories WHERE id = NEW.category_id),''), "
+    "    note = COALESCE(NEW.note,'') WHERE rowid = NEW.id; "
+    "END;"
+    "CREATE TRIGGER trg_fts_category_rename AFTER UPDATE OF name ON categories WHEN NEW.name IS NOT OLD.name BEGIN "
+    "  UPDATE transactions_fts SET category = NEW.name WHERE rowid IN (SELECT id FROM transactions WHERE category_id = NEW.id); "
+    "END;",
+    /* 7: recurring rules remember the last occurrence they materialized, and each
+     * occurrence records its rule so a (rule, day) pair can only be inserted once */
+    "ALTER TABLE recurring_transactions ADD COLUMN last_run TEXT;"
+    "ALTER TABLE transactions ADD COLUMN recurring_id INTEGER;"
+    "CREATE UNIQUE INDEX idx_transactions_recurring ON transactions(recurring_id, day) WHERE recurring_id IS NOT NULL;",
+    /* 8: keyset pages in amount order */
+    "CREATE INDEX IF NOT EXISTS idx_transactions_amount ON transactions(amount, id);",
+    /* 9: index the category by id (FTS_INSERT_TRIGGER_SQL) and its name once in
+     * categories_fts, so a rename rewrites one index row instead of one per transaction */
+    "DROP TRIGGER IF EXISTS trg_fts_category_rename;"
+    "DROP TRIGGER IF EXISTS trg_fts_insert;"
+    "DROP TRIGGER IF EXISTS trg_fts_update;"
+    "DROP TABLE transactions_fts;"
+    "CREATE VIRTUAL TABLE transactions_fts USING fts5(category, note, tokenize='unicode61 remove_diacritics 2', prefix='2 3');"
+    "INSERT INTO transactions_fts(transactions_fts, rank) VALUES('rank', 'bm25(2.0, 1.0)');"
+    "INSERT INTO transactions_fts(rowid, category, note) SELECT id, 'c' || category_id, COALESCE(note,'') FROM transactions;"
+    FTS_INSERT_TRIGGER_SQL
+    "CREATE TRIGGER trg_fts_update AFTER UPDATE OF category_id, note ON transactions BEGIN "
+    "  UPDATE transactions_fts SET category = 'c' || NEW.category_id, note = COALESCE(NEW.note,'') WHERE rowid = NEW.id; "
+    "END;"
+    "CREATE VIRTUAL TABLE categories_fts USING fts5(name, content='categories', content_rowid='id', tokenize='unicode61 remove_diacritics 2', prefix='2 3');"
+    "INSERT INTO categories_fts(categories_fts) VALUES('rebuild');"
+    "CREATE TRIGGER trg_categories_fts_insert AFTER INSERT ON categories BEGIN "
+    "  INSERT INTO categories_fts(rowid, name) VALUES (NEW.id, NEW.name); "
+    "END;"
+    "CREATE TRIGGER trg_categories_fts_delete AFTER DELETE ON categories BEGIN "
+    "  INSERT INTO categories_fts(categories_fts, rowid, name) VALUES ('delete', OLD.id, OLD.name); "
+    "END;"
+    "CREATE TRIGGER trg_categories_fts_update AFTER UPDATE OF name ON categories WHEN NEW.name IS NOT OLD.name BEGIN "
+    "  INSERT INTO categories_fts(categories_fts, rowid, name) VALUES ('delete', OLD.id, OLD.name); "
+    "  INSERT INTO categories_fts(rowid, name) VALUES (NEW.id, NEW.name); "
+    "END;",
+};
+
+static int exec_sql_on(sqlite3 *db, const char *sql)
 {
     char *errmsg = NULL;
-    int rc = sqlite3_exec(g_db, sql, NULL, NULL, &errmsg);
+    int rc = sqlite3_exec(db, sql, NULL, NULL, &errmsg);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "SQL error: %s\n", errmsg ? errmsg : "unknown");
         sqlite3_free(errmsg);
@@ -18,13 +642,102 @@ static int exec_sql(const char *sql)
     return rc;
 }
 
+static int exec_sql(const char *sql)
+{
+    return exec_sql_on(current_conn()->db, sql);
+}
+
+/* SQL-callable day_key(date) so migrations derive keys with the same parser as the C side. */
+static void sql_day_key(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    (void)argc;
+    sqlite3_result_int(ctx, day_key_from_date((const char*)sqlite3_value_text(argv[0])));
+}
+
+static int run_migrations(void)
+{
+    sqlite3_stmt *stmt = NULL;
+    int version = 0;
+    if (sqlite3_prepare_v2(g_writer.db, "PRAGMA user_version", -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+
+    int target = (int)(sizeof(k_migrations) / sizeof(k_migrations[0]));
+    for (int v = version; v < target; ++v) {
+        char bump[64];
+        snprintf(bump, sizeof(bump), "PRAGMA user_version=%d", v + 1);
+        if (exec_sql("BEGIN") != SQLITE_OK) return -1;
+        if (exec_sql(k_migrations[v]) != SQLITE_OK || exec_sql(bump) != SQLITE_OK) {
+            fprintf(stderr, "Schema migration %d failed\n", v + 1);
+            exec_sql("ROLLBACK");
+            return -1;
+        }
+        if (exec_sql("COMMIT") != SQLITE_OK) return -1;
+    }
+    return 0;
+}
+
+/* Mirror the categories table into the process-wide interner. */
+static int load_categories(void)
+{
+    category_interner_clear();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_CATEGORY_ALL);
+    if (!stmt) return -1;
+    int rc = 0;
+    while (rc == 0 && sqlite3_step(stmt) == SQLITE_ROW)
+        rc = category_interner_add(sqlite3_column_int(stmt, 0), (const char*)sqlite3_column_text(stmt, 1));
+    stmt_release(stmt);
+    return rc;
+}
+
+/* Pragmas shared by every connection. WAL lets readers run while the writer
+ * commits, so NORMAL sync only risks the last commits on power loss, not corruption. */
+static int apply_pragmas(sqlite3 *db)
+{
+    sqlite3_busy_timeout(db, 5000);
+    return exec_sql_on(db,
+        "PRAGMA synchronous=NORMAL;"
+        "PRAGMA cache_size=-16384;"      /* 16 MB page cache */
+        "PRAGMA mmap_size=268435456;"    /* 256 MB */
+        "PRAGMA temp_store=MEMORY;") == SQLITE_OK ? 0 : -1;
+}
+
+/* Extra connection to the already-initialized file: a pooled reader, or the
+ * writer thread's connection when writable. */
+static int open_secondary(const char *db_path, DbConn *conn, int writable)
+{
+    memset(conn, 0, sizeof(*conn));
+    int flags = (writable ? SQLITE_OPEN_READWRITE : SQLITE_OPEN_READONLY) | SQLITE_OPEN_NOMUTEX;
+    if (sqlite3_open_v2(db_path, &conn->db, flags, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Cannot open %s connection: %s\n", writable ? "writer" : "reader", sqlite3_errmsg(conn->db));
+        sqlite3_close(conn->db);
+        conn->db = NULL;
+        return -1;
+    }
+    sqlite3_trace_v2(conn->db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, trace_statement, conn);
+    sqlite3_create_function(conn->db, "day_key", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, sql_day_key, NULL, NULL);
+    if (apply_pragmas(conn->db) != 0 || (!writable && exec_sql_on(conn->db, "PRAGMA query_only=ON") != SQLITE_OK) ||
+        prepare_statements(conn) != 0) {
+        finalize_statements(conn);
+        sqlite3_close(conn->db);
+        conn->db = NULL;
+        return -1;
+    }
+    return 0;
+}
+
 int init_database(const char *db_path)
 {
-    if (g_db) return 0;
-    if (sqlite3_open(db_path, &g_db) != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(g_db));
+    PROFILE_FUNCTION();
+    if (g_writer.db) return 0;
+    if (sqlite3_open(db_path, &g_writer.db) != SQLITE_OK) {
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(g_writer.db));
         return -1;
     }
+    sqlite3_trace_v2(g_writer.db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, trace_statement, &g_writer);
+    /* journal_mode is persistent in the file; readers opened below inherit it */
+    if (exec_sql("PRAGMA journal_mode=WAL") != SQLITE_OK) return -1;
+    if (apply_pragmas(g_writer.db) != 0) return -1;
     const char *schema_transactions = "CREATE TABLE IF NOT EXISTS transactions (id INTEGER PRIMARY KEY AUTOINCREMENT, type TEXT, category TEXT, amount REAL, date TEXT, note TEXT)";
     const char *schema_budgets = "CREATE TABLE IF NOT EXISTS budgets (id INTEGER PRIMARY KEY AUTOINCREMENT, category TEXT UNIQUE, monthly_limit REAL)";
     const char *schema_goals = "CREATE TABLE IF NOT EXISTS goals (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT, target_amount REAL, monthly_saving REAL, start_date TEXT)";
@@ -35,388 +748,1023 @@ int init_database(const char *db_path)
     if (exec_sql(schema_goals) != SQLITE_OK) return -1;
     if (exec_sql(schema_settings) != SQLITE_OK) return -1;
     if (exec_sql(schema_recurring) != SQLITE_OK) return -1;
+    sqlite3_create_function(g_writer.db, "day_key", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, sql_day_key, NULL, NULL);
+    if (run_migrations() != 0) return -1;
+    if (prepare_statements(&g_writer) != 0) return -1;
+    if (load_categories() != 0) return -1;
+
+    /* Readers are optional: without them db_reader_acquire just fails and callers stay on the writer. */
+    for (g_reader_count = 0; g_reader_count < DB_READER_POOL_SIZE; ++g_reader_count)
+        if (open_secondary(db_path, &g_readers[g_reader_count], 0) != 0) break;
+    g_db_path = strdup(db_path);
+    return g_db_path ? 0 : -1;
+}
+
+/* Categories */
+static const CategoryChange *pending_category(const DbConn *conn, int id)
+{
+    for (int i = 0; i < conn->new_category_count; ++i)
+        if (conn->new_categories[i].id == id) return &conn->new_categories[i];
+    return NULL;
+}
+
+/* Outside a transaction the change goes straight to the interner. Inside one
+ * it waits on the connection: other connections must not see a name before
+ * COMMIT, and a rollback frees the rowid for the next new name. */
+static int note_category(int id, const char *name, int removed)
+{
+    DbConn *conn = current_conn();
+    char old[2];
+    if (sqlite3_get_autocommit(conn->db)) {
+        if (removed) { category_interner_remove(id); return 0; }
+        if (category_name(id, old, sizeof(old)) == 0) return category_interner_rename(id, name);
+        return category_interner_add(id, name);
+    }
+    CategoryChange *c = (CategoryChange*)pending_category(conn, id);
+    if (!c) {
+        if (conn->new_category_count == conn->new_category_cap) {
+            int ncap = conn->new_category_cap ? conn->new_category_cap * 2 : 16;
+            CategoryChange *tmp = (CategoryChange*)realloc(conn->new_categories, ncap * sizeof(*tmp));
+            if (!tmp) return -1;
+            conn->new_categories = tmp; conn->new_category_cap = ncap;
+        }
+        c = &conn->new_categories[conn->new_category_count++];
+        c->id = id;
+    }
+    c->removed = removed;
+    snprintf(c->name, CATEGORY_LEN, "%s", removed ? "" : name);
+    return 0;
+}
+
+/* The interner as this connection sees it: its own uncommitted changes first */
+static int lookup_category(const char *name)
+{
+    const DbConn *conn = current_conn();
+    if (!name) name = "";
+    for (int i = 0; i < conn->new_category_count; ++i)
+        if (!conn->new_categories[i].removed && strcmp(conn->new_categories[i].name, name) == 0)
+            return conn->new_categories[i].id;
+    int id = category_lookup(name);
+    return id > 0 && pending_category(conn, id) ? 0 : id;
+}
+
+static int name_of_category(int id, char *out_name, int out_size)
+{
+    const CategoryChange *c = pending_category(current_conn(), id);
+    if (!c) return category_name(id, out_name, out_size);
+    if (c->removed) return 1;
+    snprintf(out_name, out_size, "%s", c->name);
+    return 0;
+}
+
+int category_intern(const char *name)
+{
+    PROFILE_FUNCTION();
+    if (!name) name = "";
+    int id = lookup_category(name);
+    if (id > 0) return id;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_CATEGORY_INTERN);
+    if (!stmt) return -1;
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
+    stmt_release(stmt);
+    if (id <= 0 || note_category(id, name, 0) != 0) return -1;
+    return id;
+}
+
+int rename_category(const char *from, const char *to)
+{
+    PROFILE_FUNCTION();
+    if (!from || !to || !to[0]) return -1;
+    int from_id = lookup_category(from);
+    if (from_id == 0) return 1; /* not found */
+    int to_id = lookup_category(to);
+    if (to_id == from_id) return 0;
+
+    if (to_id == 0) {
+        /* plain rename: one row, every reference follows the id */
+        sqlite3_stmt *stmt = stmt_acquire(STMT_CATEGORY_RENAME);
+        if (!stmt) return -1;
+        sqlite3_bind_text(stmt, 1, to, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, from_id);
+        int rc = sqlite3_step(stmt);
+        stmt_release(stmt);
+        if (rc != SQLITE_DONE) return -1;
+        note_category(from_id, to, 0);
+    } else {
+        /* merge into an existing category; its own budget wins over ours */
+        char sql[512];
+        snprintf(sql, sizeof(sql),
+            "UPDATE transactions SET category_id=%d WHERE category_id=%d;"
+            "UPDATE recurring_transactions SET category_id=%d WHERE category_id=%d;"
+            "UPDATE OR IGNORE budgets SET category_id=%d WHERE category_id=%d;"
+            "DELETE FROM budgets WHERE category_id=%d;"
+            "DELETE FROM categories WHERE id=%d;",
+            to_id, from_id, to_id, from_id, to_id, from_id, from_id, from_id);
+        if (exec_sql("SAVEPOINT rename_category") != SQLITE_OK) return -1;
+        if (exec_sql(sql) != SQLITE_OK) {
+            exec_sql("ROLLBACK TO rename_category");
+            exec_sql("RELEASE rename_category");
+            return -1;
+        }
+        if (exec_sql("RELEASE rename_category") != SQLITE_OK) return -1;
+        note_category(from_id, NULL, 1);
+    }
+    /* it caches names, not ids */
+    LedgerWrite w = { .kind = LEDGER_RENAME };
+    snprintf(w.u.rename.from, CATEGORY_LEN, "%s", from);
+    snprintf(w.u.rename.to, CATEGORY_LEN, "%s", to);
+    note_ledger_write(&w);
+    /* every row of the category reads differently now; a merge may also drop a budget */
+    note_reset(CHANGE_TRANSACTIONS);
+    note_reset(CHANGE_BUDGETS);
+    return 0;
+}
+
+sqlite3 *db_writer_handle(void)
+{
+    return g_writer.db;
+}
+
+int db_after_restore(void)
+{
+    PROFILE_FUNCTION();
+    /* cached statements re-prepare themselves on the schema change */
+    if (run_migrations() != 0 || load_categories() != 0) return -1;
+    ledger_cache_invalidate();
+    for (int t = 0; t < CHANGE_TABLE_COUNT; ++t) note_reset((ChangeTable)t);
+    return recurring_schedule_load();
+}
+
+int db_reader_acquire(void)
+{
+    PROFILE_FUNCTION();
+    if (t_conn) return -1; /* one checkout per thread */
+    pthread_mutex_lock(&g_pool_lock);
+    DbConn *conn = NULL;
+    while (g_reader_count > 0 && !conn) {
+        for (int i = 0; i < g_reader_count; ++i)
+            if (!g_readers[i].in_use) { conn = &g_readers[i]; break; }
+        if (!conn) pthread_cond_wait(&g_pool_cond, &g_pool_lock);
+    }
+    if (conn) conn->in_use = 1;
+    pthread_mutex_unlock(&g_pool_lock);
+    if (!conn) return -1;
+    t_conn = conn;
+    return 0;
+}
+
+int db_writer_thread_attach(void)
+{
+    PROFILE_FUNCTION();
+    if (t_conn || !g_db_path) return -1;
+    pthread_mutex_lock(&g_pool_lock);
+    int busy = g_thread_writer.in_use;
+    g_thread_writer.in_use = 1;
+    pthread_mutex_unlock(&g_pool_lock);
+    if (busy) return -1;
+    if (!g_thread_writer.db && open_secondary(g_db_path, &g_thread_writer, 1) != 0) {
+        g_thread_writer.in_use = 0;
+        return -1;
+    }
+    t_conn = &g_thread_writer;
+    return 0;
+}
+
+void db_writer_thread_detach(void)
+{
+    if (t_conn != &g_thread_writer) return;
+    if (sqlite3_get_autocommit(g_thread_writer.db) == 0) exec_sql_on(g_thread_writer.db, "ROLLBACK");
+    g_thread_writer.bulk_from_id = 0;
+    finish_new_categories(&g_thread_writer, 0);
+    finish_ledger(&g_thread_writer, 0);
+    finish_pending(&g_thread_writer, 0);
+    t_conn = NULL;
+    pthread_mutex_lock(&g_pool_lock);
+    g_thread_writer.in_use = 0;
+    pthread_mutex_unlock(&g_pool_lock);
+}
+
+void db_reader_release(void)
+{
+    DbConn *conn = t_conn;
+    if (!conn) return;
+    if (sqlite3_get_autocommit(conn->db) == 0) exec_sql_on(conn->db, "ROLLBACK");
+    t_conn = NULL;
+    pthread_mutex_lock(&g_pool_lock);
+    conn->in_use = 0;
+    pthread_cond_signal(&g_pool_cond);
+    pthread_mutex_unlock(&g_pool_lock);
+}
+
+/* With two writing connections a deferred transaction could fail to upgrade to a
+ * write lock without waiting, so writers take the lock up front. */
+static int conn_writable(const DbConn *conn)
+{
+    return conn == &g_writer || conn == &g_thread_writer;
+}
+
+int db_begin_transaction(void)
+{
+    PROFILE_FUNCTION();
+    return exec_sql(conn_writable(current_conn()) ? "BEGIN IMMEDIATE" : "BEGIN") == SQLITE_OK ? 0 : -1;
+}
+
+int db_commit_transaction(void)
+{
+    PROFILE_FUNCTION();
+    if (exec_sql("COMMIT") != SQLITE_OK) return -1;
+    finish_new_categories(current_conn(), 1);
+    finish_ledger(current_conn(), 1);
+    finish_pending(current_conn(), 1);
+    return 0;
+}
+
+int db_rollback_transaction(void)
+{
+    PROFILE_FUNCTION();
+    current_conn()->bulk_from_id = 0;  /* the rollback restores the dropped triggers */
+    int rc = exec_sql("ROLLBACK") == SQLITE_OK ? 0 : -1;
+    finish_new_categories(current_conn(), 0);
+    finish_ledger(current_conn(), 0);
+    finish_pending(current_conn(), 0);
+    return rc;
+}
+
+/* FTS5 flushes its pending terms at the end of every statement, so indexing
+ * row by row from the trigger writes a tiny segment per insert, and the
+ * summary trigger upserts one row per insert. A bulk transaction drops both
+ * insert triggers and applies the new rows in one grouped statement each at
+ * commit; all of it happens inside the transaction, so other connections
+ * never see the triggers missing. */
+int db_begin_bulk_transaction(void)
+{
+    PROFILE_FUNCTION();
+    DbConn *conn = current_conn();
+    if (!conn_writable(conn) || db_begin_transaction() != 0) return -1;
+    sqlite3_stmt *stmt = NULL;
+    int max_id = -1;
+    if (sqlite3_prepare_v2(conn->db, "SELECT COALESCE(MAX(id),0) FROM transactions", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) max_id = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    if (max_id < 0 || exec_sql("DROP TRIGGER IF EXISTS trg_fts_insert; DROP TRIGGER IF EXISTS trg_summary_insert") != SQLITE_OK) {
+        db_rollback_transaction();
+        return -1;
+    }
+    conn->bulk_from_id = max_id + 1;
     return 0;
 }
 
+int db_commit_bulk_transaction(void)
+{
+    PROFILE_FUNCTION();
+    DbConn *conn = current_conn();
+    if (!conn->bulk_from_id) return db_commit_transaction();
+    char sql[1024];
+    snprintf(sql, sizeof(sql),
+             "INSERT INTO transactions_fts(rowid, category, note) "
+             "SELECT id, 'c' || category_id, COALESCE(note,'') FROM transactions WHERE id >= %d;"
+             "INSERT INTO monthly_summary(month, category_id, type, total, count) "
+             "SELECT month_key, category_id, COALESCE(type,''), SUM(amount), COUNT(*) FROM transactions WHERE id >= %d GROUP BY 1, 2, 3 "
+             "ON CONFLICT(month, category_id, type) DO UPDATE SET total = total + excluded.total, count = count + excluded.count;",
+             conn->bulk_from_id, conn->bulk_from_id);
+    if (exec_sql(sql) != SQLITE_OK || exec_sql(FTS_INSERT_TRIGGER_SQL SUMMARY_INSERT_TRIGGER_SQL) != SQLITE_OK) {
+        db_rollback_transaction();  /* never commit the rows without their index, summaries or triggers */
+        return -1;
+    }
+    conn->bulk_from_id = 0;
+    return db_commit_transaction();
+}
+
+/* Call only once worker threads have released their readers. */
 void close_database(void)
 {
-    if (g_db) {
-        sqlite3_close(g_db);
-        g_db = NULL;
+    ledger_cache_free();
+    recurring_schedule_free();
+    category_interner_clear();
+    for (int i = 0; i < g_reader_count; ++i) {
+        finalize_statements(&g_readers[i]);
+        sqlite3_close(g_readers[i].db);
+        memset(&g_readers[i], 0, sizeof(g_readers[i]));
+    }
+    g_reader_count = 0;
+    if (g_thread_writer.db) {
+        finalize_statements(&g_thread_writer);
+        sqlite3_close(g_thread_writer.db);
+        free(g_thread_writer.pending);
+        free(g_thread_writer.new_categories);
+        free(g_thread_writer.ledger_writes);
+        memset(&g_thread_writer, 0, sizeof(g_thread_writer));
+    }
+    free(g_db_path);
+    g_db_path = NULL;
+    if (g_writer.db) {
+        finalize_statements(&g_writer);
+        sqlite3_close(g_writer.db);
+        g_writer.db = NULL;
+        free(g_writer.pending);
+        g_writer.pending = NULL;
+        g_writer.pending_count = g_writer.pending_cap = 0;
+        free(g_writer.new_categories);
+        g_writer.new_categories = NULL;
+        g_writer.new_category_count = g_writer.new_category_cap = 0;
+        free(g_writer.ledger_writes);
+        g_writer.ledger_writes = NULL;
+        g_writer.ledger_write_count = g_writer.ledger_write_cap = 0;
     }
 }
 
+/* The stored row, as the before image of an edit or delete. 1 if there is none. */
+static int read_transaction(int id, Transaction *out)
+{
+    sqlite3_stmt *stmt = stmt_acquire(STMT_TX_BY_ID);
+    if (!stmt) return -1;
+    sqlite3_bind_int(stmt, 1, id);
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        out->id = sqlite3_column_int(stmt, 0);
+        snprintf(out->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
+        name_of_category(sqlite3_column_int(stmt, 2), out->category, CATEGORY_LEN);
+        out->amount = sqlite3_column_int64(stmt, 3);
+        snprintf(out->date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 4));
+        const unsigned char *note = sqlite3_column_text(stmt, 5);
+        snprintf(out->note, NOTE_LEN, "%s", note ? (const char*)note : "");
+    }
+    stmt_release(stmt);
+    return rc == SQLITE_ROW ? 0 : (rc == SQLITE_DONE ? 1 : -1);
+}
+
+static void note_tx_change(ChangeKind kind, const Transaction *before, const Transaction *after)
+{
+    ChangeEvent ev = { .table = CHANGE_TRANSACTIONS, .kind = kind, .id = after ? after->id : before->id };
+    if (before) ev.u.tx.before = *before;
+    if (after) ev.u.tx.after = *after;
+    note_change(&ev);
+}
+
 int add_transaction(const Transaction *t)
 {
-    const char *sql = "INSERT INTO transactions(type, category, amount, date, note) VALUES(?,?,?,?,?)";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    int category_id = category_intern(t->category);
+    if (category_id <= 0) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_TX_INSERT);
+    if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, t->type, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, t->category, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 3, t->amount);
+    sqlite3_bind_int(stmt, 2, category_id);
+    sqlite3_bind_int64(stmt, 3, t->amount);
     sqlite3_bind_text(stmt, 4, t->date, -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 5, t->note, -1, SQLITE_TRANSIENT);
+    int day = day_key_from_date(t->date);
+    sqlite3_bind_int(stmt, 6, day / 100);
+    sqlite3_bind_int(stmt, 7, day);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    Transaction added = *t;
+    added.id = (int)sqlite3_last_insert_rowid(current_conn()->db);
+    note_ledger_upsert(&added);
+    if (change_wanted(CHANGE_TRANSACTIONS)) note_tx_change(CHANGE_INSERT, NULL, &added);
+    return 0;
 }
 
 int edit_transaction(const Transaction *t)
 {
-    const char *sql = "UPDATE transactions SET type=?, category=?, amount=?, date=?, note=? WHERE id=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    int category_id = category_intern(t->category);
+    if (category_id <= 0) return -1;
+    Transaction before;
+    int notify = change_wanted(CHANGE_TRANSACTIONS) && read_transaction(t->id, &before) == 0;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_TX_UPDATE);
+    if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, t->type, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, t->category, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 3, t->amount);
+    sqlite3_bind_int(stmt, 2, category_id);
+    sqlite3_bind_int64(stmt, 3, t->amount);
     sqlite3_bind_text(stmt, 4, t->date, -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 5, t->note, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 6, t->id);
+    int day = day_key_from_date(t->date);
+    sqlite3_bind_int(stmt, 6, day / 100);
+    sqlite3_bind_int(stmt, 7, day);
+    sqlite3_bind_int(stmt, 8, t->id);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (sqlite3_changes(current_conn()->db) > 0) {
+        note_ledger_upsert(t);
+        if (notify) note_tx_change(CHANGE_UPDATE, &before, t);
+    }
+    return 0;
 }
 
 int delete_transaction(int id)
 {
-    const char *sql = "DELETE FROM transactions WHERE id=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    Transaction before;
+    int notify = change_wanted(CHANGE_TRANSACTIONS) && read_transaction(id, &before) == 0;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_TX_DELETE);
+    if (!stmt) return -1;
     sqlite3_bind_int(stmt, 1, id);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (sqlite3_changes(current_conn()->db) > 0) note_ledger_delete(id);
+    if (notify && sqlite3_changes(current_conn()->db) > 0) note_tx_change(CHANGE_DELETE, &before, NULL);
+    return 0;
 }
 
-static int grow_transactions(Transaction **list, int *cap, int needed)
+#define TX_PAGE_ROWS 256
+
+static const StmtId k_page_stmt[] = {
+    [TX_ORDER_NEWEST] = STMT_TX_PAGE,
+    [TX_ORDER_OLDEST] = STMT_TX_PAGE_OLDEST,
+    [TX_ORDER_LARGEST] = STMT_TX_PAGE_LARGEST,
+    [TX_ORDER_SMALLEST] = STMT_TX_PAGE_SMALLEST,
+};
+
+/* Binds the filter parameters shared by the keyset pages and STMT_TX_COUNT_MATCHING */
+static void bind_tx_filter(sqlite3_stmt *stmt, const TxQuery *q, int category_id)
 {
-    if (*cap >= needed) return 0;
-    int ncap = (*cap == 0) ? 32 : *cap * 2;
-    while (ncap < needed) ncap *= 2;
-    Transaction *nl = (Transaction*)realloc(*list, ncap * sizeof(Transaction));
-    if (!nl) return -1;
-    *list = nl;
-    *cap = ncap;
-    return 0;
+    sqlite3_bind_int(stmt, 3, q->day_from);
+    if (q->search) {
+        char pattern[256];
+        snprintf(pattern, sizeof(pattern), "%%%s%%", q->search);
+        sqlite3_bind_text(stmt, 4, pattern, -1, SQLITE_TRANSIENT);
+    }
+    sqlite3_bind_int(stmt, 6, category_id);
+    sqlite3_bind_int(stmt, 7, q->day_to);
 }
 
-int fetch_transactions_all(Transaction **out_list, int *out_count)
+int fetch_transaction_page(const TxQuery *q, TxCursor *cursor, Transaction *out, int max, int *out_count)
 {
-    *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, type, category, amount, date, note FROM transactions ORDER BY date DESC, id DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    int cap = 0; Transaction *list = NULL; int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (grow_transactions(&list, &cap, count + 1) != 0) { sqlite3_finalize(stmt); free(list); return -1; }
-        Transaction *t = &list[count++];
+    return seek_transaction_page(q, cursor, 0, out, max, out_count);
+}
+
+int seek_transaction_page(const TxQuery *q, TxCursor *cursor, long skip, Transaction *out, int max, int *out_count)
+{
+    PROFILE_FUNCTION();
+    *out_count = 0;
+    if (cursor->done || max <= 0) return 0;
+    const TxQuery none = {0};
+    if (!q) q = &none;
+    int category_id = 0;
+    if (q->category && (category_id = lookup_category(q->category)) == 0) {
+        cursor->done = 1;  /* no such category, so no rows */
+        return 0;
+    }
+    TxOrder order = q->order <= TX_ORDER_SMALLEST ? q->order : TX_ORDER_NEWEST;
+    sqlite3_stmt *stmt = stmt_acquire(order == TX_ORDER_NEWEST && q->category ? STMT_TX_PAGE_CATEGORY : k_page_stmt[order]);
+    if (!stmt) return -1;
+    int started = cursor->day || cursor->id;
+    switch (order) {
+    case TX_ORDER_NEWEST: {
+        /* The upper bound is the cursor, or just past day_to on the first page, so
+         * every page is a single index seek rather than a rescan from the top. */
+        int hi_day = q->day_to ? q->day_to : 99999999, hi_id = 0x7fffffff;
+        if (started && cursor->day <= hi_day) {
+            hi_day = cursor->day;
+            hi_id = cursor->id;
+        }
+        sqlite3_bind_int(stmt, 1, hi_day);
+        sqlite3_bind_int(stmt, 2, hi_id);
+        break;
+    }
+    case TX_ORDER_OLDEST:
+        /* mirror image: the lower bound starts at day_from */
+        sqlite3_bind_int(stmt, 1, started ? cursor->day : q->day_from);
+        sqlite3_bind_int(stmt, 2, started ? cursor->id : 0);
+        break;
+    case TX_ORDER_LARGEST:
+        sqlite3_bind_int64(stmt, 1, started ? cursor->amount : INT64_MAX);
+        sqlite3_bind_int(stmt, 2, started ? cursor->id : 0x7fffffff);
+        break;
+    case TX_ORDER_SMALLEST:
+        sqlite3_bind_int64(stmt, 1, started ? cursor->amount : INT64_MIN);
+        sqlite3_bind_int(stmt, 2, started ? cursor->id : 0);
+        break;
+    }
+    bind_tx_filter(stmt, q, category_id);
+    if (order == TX_ORDER_OLDEST && !q->day_to) sqlite3_bind_int(stmt, 7, 99999999);
+    sqlite3_bind_int(stmt, 5, max);
+    sqlite3_bind_int64(stmt, 8, skip > 0 ? skip : 0);
+
+    int count = 0, rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        Transaction *t = &out[count++];
         t->id = sqlite3_column_int(stmt, 0);
         snprintf(t->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        snprintf(t->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 2));
-        t->amount = sqlite3_column_double(stmt, 3);
+        name_of_category(sqlite3_column_int(stmt, 2), t->category, CATEGORY_LEN);
+        t->amount = sqlite3_column_int64(stmt, 3);
         snprintf(t->date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 4));
         const unsigned char *note = sqlite3_column_text(stmt, 5);
         snprintf(t->note, NOTE_LEN, "%s", note ? (const char*)note : "");
+        cursor->day = sqlite3_column_int(stmt, 6);
+        cursor->id = t->id;
+        cursor->amount = t->amount;
     }
-    sqlite3_finalize(stmt);
-    *out_list = list; *out_count = count;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (count < max) cursor->done = 1;
+    PROFILE_ROWS(count);
+    *out_count = count;
     return 0;
 }
 
-int fetch_transactions_by_month(const char *yyyymm, Transaction **out_list, int *out_count)
+int visit_transactions(const TxQuery *q, TransactionVisitor visit, void *user_data)
 {
-    *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, type, category, amount, date, note FROM transactions WHERE date LIKE ? || '%' ORDER BY date DESC, id DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    sqlite3_bind_text(stmt, 1, yyyymm, -1, SQLITE_TRANSIENT);
-    int cap = 0; Transaction *list = NULL; int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (grow_transactions(&list, &cap, count + 1) != 0) { sqlite3_finalize(stmt); free(list); return -1; }
-        Transaction *t = &list[count++];
-        t->id = sqlite3_column_int(stmt, 0);
-        snprintf(t->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        snprintf(t->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 2));
-        t->amount = sqlite3_column_double(stmt, 3);
-        snprintf(t->date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 4));
-        const unsigned char *note = sqlite3_column_text(stmt, 5);
-        snprintf(t->note, NOTE_LEN, "%s", note ? (const char*)note : "");
+    PROFILE_FUNCTION();
+    Transaction *page = (Transaction*)malloc(TX_PAGE_ROWS * sizeof(Transaction));
+    if (!page) return -1;
+    TxCursor cursor = {0};
+    int rc = 0, n = 0;
+    while (rc == 0 && !cursor.done) {
+        if (fetch_transaction_page(q, &cursor, page, TX_PAGE_ROWS, &n) != 0) { rc = -1; break; }
+        for (int i = 0; i < n && rc == 0; ++i) rc = visit(&page[i], user_data);
+        PROFILE_ROWS(n);
     }
-    sqlite3_finalize(stmt);
-    *out_list = list; *out_count = count;
+    free(page);
+    return rc;
+}
+
+typedef struct { Transaction *list; int count; int cap; } TxCollector;
+
+static int collect_transaction(const Transaction *t, void *user_data)
+{
+    TxCollector *c = (TxCollector*)user_data;
+    if (c->count == c->cap) {
+        int ncap = c->cap ? c->cap * 2 : 32;
+        Transaction *nl = (Transaction*)realloc(c->list, ncap * sizeof(Transaction));
+        if (!nl) return -1;
+        c->list = nl; c->cap = ncap;
+    }
+    c->list[c->count++] = *t;
+    return 0;
+}
+
+static int collect_transactions(const TxQuery *q, Transaction **out_list, int *out_count)
+{
+    TxCollector c = {0};
+    *out_list = NULL; *out_count = 0;
+    if (visit_transactions(q, collect_transaction, &c) != 0) { free(c.list); return -1; }
+    *out_list = c.list; *out_count = c.count;
+    PROFILE_ROWS(c.count);  /* charged to the public function that called us */
     return 0;
 }
 
+int fetch_transactions_all(Transaction **out_list, int *out_count)
+{
+    PROFILE_FUNCTION();
+    return collect_transactions(NULL, out_list, out_count);
+}
+
+int fetch_transactions_by_month(const char *yyyymm, Transaction **out_list, int *out_count)
+{
+    PROFILE_FUNCTION();
+    int month = month_key_from_yyyymm(yyyymm);
+    TxQuery q = { .day_from = month * 100, .day_to = month * 100 + 99 };
+    return collect_transactions(&q, out_list, out_count);
+}
+
+static void note_budget_change(ChangeKind kind, int id, const Budget *b)
+{
+    ChangeEvent ev = { .table = CHANGE_BUDGETS, .kind = kind, .id = id };
+    if (b) ev.u.budget = *b;
+    ev.u.budget.id = id;
+    note_change(&ev);
+}
+
 int add_or_update_budget(const Budget *b)
 {
-    const char *sql = "INSERT INTO budgets(category, monthly_limit) VALUES(?, ?) ON CONFLICT(category) DO UPDATE SET monthly_limit=excluded.monthly_limit";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    sqlite3_bind_text(stmt, 1, b->category, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 2, b->monthly_limit);
+    PROFILE_FUNCTION();
+    int category_id = category_intern(b->category);
+    if (category_id <= 0) return -1;
+    Budget stored;
+    int notify = change_wanted(CHANGE_BUDGETS);
+    int existed = notify && get_budget_by_category(b->category, &stored) == 0;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_BUDGET_UPSERT);
+    if (!stmt) return -1;
+    sqlite3_bind_int(stmt, 1, category_id);
+    sqlite3_bind_int64(stmt, 2, b->monthly_limit);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    /* the upsert does not say which it did, nor the id of a new row */
+    if (notify && get_budget_by_category(b->category, &stored) == 0)
+        note_budget_change(existed ? CHANGE_UPDATE : CHANGE_INSERT, stored.id, &stored);
+    return 0;
 }
 
 int get_budget_by_category(const char *category, Budget *out_budget)
 {
-    const char *sql = "SELECT id, category, monthly_limit FROM budgets WHERE category=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    sqlite3_bind_text(stmt, 1, category, -1, SQLITE_TRANSIENT);
+    PROFILE_FUNCTION();
+    int category_id = lookup_category(category);
+    if (category_id == 0) return 1; /* not found */
+    sqlite3_stmt *stmt = stmt_acquire(STMT_BUDGET_BY_CATEGORY);
+    if (!stmt) return -1;
+    sqlite3_bind_int(stmt, 1, category_id);
     int rc = sqlite3_step(stmt);
     if (rc == SQLITE_ROW) {
         out_budget->id = sqlite3_column_int(stmt, 0);
-        snprintf(out_budget->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        out_budget->monthly_limit = sqlite3_column_double(stmt, 2);
-        sqlite3_finalize(stmt);
+        name_of_category(sqlite3_column_int(stmt, 1), out_budget->category, CATEGORY_LEN);
+        out_budget->monthly_limit = sqlite3_column_int64(stmt, 2);
+        stmt_release(stmt);
+        PROFILE_ROWS(1);
         return 0;
     }
-    sqlite3_finalize(stmt);
+    stmt_release(stmt);
     return 1; /* not found */
 }
 
 int fetch_budgets(Budget **out_list, int *out_count)
 {
+    PROFILE_FUNCTION();
     *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, category, monthly_limit FROM budgets ORDER BY category";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_BUDGET_ALL);
+    if (!stmt) return -1;
     int cap = 0; Budget *list = NULL; int count = 0;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         if (cap < count + 1) {
             int ncap = (cap == 0) ? 16 : cap * 2;
             while (ncap < count + 1) ncap *= 2;
             Budget *tmp = (Budget*)realloc(list, ncap * sizeof(Budget));
-            if (!tmp) { sqlite3_finalize(stmt); free(list); return -1; }
+            if (!tmp) { stmt_release(stmt); free(list); return -1; }
             list = tmp; cap = ncap;
         }
         Budget *b = &list[count++];
         b->id = sqlite3_column_int(stmt, 0);
-        snprintf(b->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        b->monthly_limit = sqlite3_column_double(stmt, 2);
+        name_of_category(sqlite3_column_int(stmt, 1), b->category, CATEGORY_LEN);
+        b->monthly_limit = sqlite3_column_int64(stmt, 2);
     }
-    sqlite3_finalize(stmt);
+    stmt_release(stmt);
+    PROFILE_ROWS(count);
     *out_list = list; *out_count = count;
     return 0;
 }
 
+static void note_goal_change(ChangeKind kind, int id, const Goal *g)
+{
+    ChangeEvent ev = { .table = CHANGE_GOALS, .kind = kind, .id = id };
+    if (g) ev.u.goal = *g;
+    ev.u.goal.id = id;
+    note_change(&ev);
+}
+
 int add_goal(const Goal *g)
 {
-    const char *sql = "INSERT INTO goals(name, target_amount, monthly_saving, start_date) VALUES(?,?,?,?)";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_GOAL_INSERT);
+    if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, g->name, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 2, g->target_amount);
-    sqlite3_bind_double(stmt, 3, g->monthly_saving);
+    sqlite3_bind_int64(stmt, 2, g->target_amount);
+    sqlite3_bind_int64(stmt, 3, g->monthly_saving);
     sqlite3_bind_text(stmt, 4, g->start_date, -1, SQLITE_TRANSIENT);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (change_wanted(CHANGE_GOALS))
+        note_goal_change(CHANGE_INSERT, (int)sqlite3_last_insert_rowid(current_conn()->db), g);
+    return 0;
 }
 
 int edit_goal(const Goal *g)
 {
-    const char *sql = "UPDATE goals SET name=?, target_amount=?, monthly_saving=?, start_date=? WHERE id=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_GOAL_UPDATE);
+    if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, g->name, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 2, g->target_amount);
-    sqlite3_bind_double(stmt, 3, g->monthly_saving);
+    sqlite3_bind_int64(stmt, 2, g->target_amount);
+    sqlite3_bind_int64(stmt, 3, g->monthly_saving);
     sqlite3_bind_text(stmt, 4, g->start_date, -1, SQLITE_TRANSIENT);
     sqlite3_bind_int(stmt, 5, g->id);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (sqlite3_changes(current_conn()->db) > 0 && change_wanted(CHANGE_GOALS)) note_goal_change(CHANGE_UPDATE, g->id, g);
+    return 0;
 }
 
 int delete_goal(int id)
 {
-    const char *sql = "DELETE FROM goals WHERE id=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_GOAL_DELETE);
+    if (!stmt) return -1;
     sqlite3_bind_int(stmt, 1, id);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (sqlite3_changes(current_conn()->db) > 0 && change_wanted(CHANGE_GOALS)) note_goal_change(CHANGE_DELETE, id, NULL);
+    return 0;
 }
 
 int delete_budget(int id)
 {
-    const char *sql = "DELETE FROM budgets WHERE id=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_BUDGET_DELETE);
+    if (!stmt) return -1;
     sqlite3_bind_int(stmt, 1, id);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (sqlite3_changes(current_conn()->db) > 0 && change_wanted(CHANGE_BUDGETS)) note_budget_change(CHANGE_DELETE, id, NULL);
+    return 0;
 }
 
 int update_budget(int id, const Budget *b)
 {
-    const char *sql = "UPDATE budgets SET category=?, monthly_limit=? WHERE id=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    sqlite3_bind_text(stmt, 1, b->category, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 2, b->monthly_limit);
+    PROFILE_FUNCTION();
+    int category_id = category_intern(b->category);
+    if (category_id <= 0) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_BUDGET_UPDATE);
+    if (!stmt) return -1;
+    sqlite3_bind_int(stmt, 1, category_id);
+    sqlite3_bind_int64(stmt, 2, b->monthly_limit);
     sqlite3_bind_int(stmt, 3, id);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (sqlite3_changes(current_conn()->db) > 0 && change_wanted(CHANGE_BUDGETS)) note_budget_change(CHANGE_UPDATE, id, b);
+    return 0;
+}
+
+static int collect_budget_status(int month, int category_id, BudgetStatus **out_list, int *out_count)
+{
+    *out_list = NULL; *out_count = 0;
+    sqlite3_stmt *stmt = stmt_acquire(category_id ? STMT_BUDGET_STATUS_CATEGORY : STMT_BUDGET_STATUS);
+    if (!stmt) return -1;
+    sqlite3_bind_int(stmt, 1, month);
+    if (category_id) sqlite3_bind_int(stmt, 2, category_id);
+    int cap = 0; BudgetStatus *list = NULL; int count = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (cap < count + 1) {
+            int ncap = (cap == 0) ? 16 : cap * 2;
+            BudgetStatus *tmp = (BudgetStatus*)realloc(list, ncap * sizeof(BudgetStatus));
+            if (!tmp) { stmt_release(stmt); free(list); return -1; }
+            list = tmp; cap = ncap;
+        }
+        BudgetStatus *st = &list[count++];
+        st->budget.id = sqlite3_column_int(stmt, 0);
+        name_of_category(sqlite3_column_int(stmt, 1), st->budget.category, CATEGORY_LEN);
+        st->budget.monthly_limit = sqlite3_column_int64(stmt, 2);
+        st->spent = sqlite3_column_int64(stmt, 3);
+        st->progress = st->budget.monthly_limit > 0 ? (double)st->spent / (double)st->budget.monthly_limit : 0.0;
+    }
+    stmt_release(stmt);
+    PROFILE_ROWS(count);
+    *out_list = list; *out_count = count;
+    return 0;
+}
+
+int fetch_budget_status(const char *yyyymm, BudgetStatus **out_list, int *out_count)
+{
+    PROFILE_FUNCTION();
+    return collect_budget_status(month_key_from_yyyymm(yyyymm), 0, out_list, out_count);
+}
+
+int get_budget_status(const char *category, const char *yyyymm, BudgetStatus *out)
+{
+    PROFILE_FUNCTION();
+    int category_id = lookup_category(category);
+    if (category_id == 0) return 1; /* not found */
+    BudgetStatus *list = NULL; int count = 0;
+    if (collect_budget_status(month_key_from_yyyymm(yyyymm), category_id, &list, &count) != 0) return -1;
+    if (count > 0) *out = list[0];
+    free(list);
+    return count > 0 ? 0 : 1;
 }
 
 int fetch_goals(Goal **out_list, int *out_count)
 {
+    PROFILE_FUNCTION();
     *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, name, target_amount, monthly_saving, start_date FROM goals ORDER BY id DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_GOAL_ALL);
+    if (!stmt) return -1;
     int cap = 0; Goal *list = NULL; int count = 0;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         if (cap < count + 1) {
             int ncap = (cap == 0) ? 16 : cap * 2;
             while (ncap < count + 1) ncap *= 2;
             Goal *tmp = (Goal*)realloc(list, ncap * sizeof(Goal));
-            if (!tmp) { sqlite3_finalize(stmt); free(list); return -1; }
+            if (!tmp) { stmt_release(stmt); free(list); return -1; }
             list = tmp; cap = ncap;
         }
         Goal *g = &list[count++];
         g->id = sqlite3_column_int(stmt, 0);
         snprintf(g->name, NAME_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        g->target_amount = sqlite3_column_double(stmt, 2);
-        g->monthly_saving = sqlite3_column_double(stmt, 3);
+        g->target_amount = sqlite3_column_int64(stmt, 2);
+        g->monthly_saving = sqlite3_column_int64(stmt, 3);
         snprintf(g->start_date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 4));
     }
-    sqlite3_finalize(stmt);
+    stmt_release(stmt);
+    PROFILE_ROWS(count);
     *out_list = list; *out_count = count;
     return 0;
 }
 
-double get_total_by_type_for_month(const char *yyyymm, const char *type)
+Money get_total_by_type_for_month(const char *yyyymm, const char *type)
 {
-    const char *sql = "SELECT COALESCE(SUM(amount),0) FROM transactions WHERE type=? AND date LIKE ? || '%'";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0.0;
+    PROFILE_FUNCTION();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_TOTAL_BY_TYPE_MONTH);
+    if (!stmt) return 0;
     sqlite3_bind_text(stmt, 1, type, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, yyyymm, -1, SQLITE_TRANSIENT);
-    double total = 0.0;
-    if (sqlite3_step(stmt) == SQLITE_ROW) total = sqlite3_column_double(stmt, 0);
-    sqlite3_finalize(stmt);
+    sqlite3_bind_int(stmt, 2, month_key_from_yyyymm(yyyymm));
+    Money total = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) total = sqlite3_column_int64(stmt, 0);
+    stmt_release(stmt);
     return total;
 }
 
-double get_spent_in_category_month(const char *category, const char *yyyymm)
+long count_transactions(const TxQuery *q)
 {
-    const char *sql = "SELECT COALESCE(SUM(amount),0) FROM transactions WHERE type='expense' AND category=? AND date LIKE ? || '%'";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0.0;
-    sqlite3_bind_text(stmt, 1, category, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, yyyymm, -1, SQLITE_TRANSIENT);
-    double total = 0.0;
-    if (sqlite3_step(stmt) == SQLITE_ROW) total = sqlite3_column_double(stmt, 0);
-    sqlite3_finalize(stmt);
+    PROFILE_FUNCTION();
+    const TxQuery none = {0};
+    if (!q) q = &none;
+    int category_id = 0;
+    if (q->category && (category_id = lookup_category(q->category)) == 0) return 0;
+    /* the summaries have the answer unless rows must be matched one by one */
+    StmtId id = q->search || q->day_from || q->day_to ? STMT_TX_COUNT_MATCHING
+              : q->category ? STMT_TX_COUNT_CATEGORY : STMT_TX_COUNT;
+    sqlite3_stmt *stmt = stmt_acquire(id);
+    if (!stmt) return -1;
+    if (id == STMT_TX_COUNT_CATEGORY) {
+        sqlite3_bind_int(stmt, 1, category_id);
+    } else if (id == STMT_TX_COUNT_MATCHING) {
+        bind_tx_filter(stmt, q, category_id);
+        if (!q->day_to) sqlite3_bind_int(stmt, 7, 99999999);
+    }
+    long count = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) count = (long)sqlite3_column_int64(stmt, 0);
+    stmt_release(stmt);
+    return count;
+}
+
+static const StmtId k_anchor_stmt[] = {
+    [TX_ORDER_NEWEST] = STMT_TX_ANCHORS_NEWEST,
+    [TX_ORDER_OLDEST] = STMT_TX_ANCHORS_OLDEST,
+    [TX_ORDER_LARGEST] = STMT_TX_ANCHORS_LARGEST,
+    [TX_ORDER_SMALLEST] = STMT_TX_ANCHORS_SMALLEST,
+};
+
+int fetch_page_anchors(const TxQuery *q, int stride, TxCursor *out, long max, long *out_count)
+{
+    PROFILE_FUNCTION();
+    *out_count = 0;
+    if (stride <= 0 || max <= 0) return 0;
+    const TxQuery none = {0};
+    if (!q) q = &none;
+    int category_id = 0;
+    if (q->category && (category_id = lookup_category(q->category)) == 0) return 0;
+    TxOrder order = q->order <= TX_ORDER_SMALLEST ? q->order : TX_ORDER_NEWEST;
+    sqlite3_stmt *stmt = stmt_acquire(k_anchor_stmt[order]);
+    if (!stmt) return -1;
+    bind_tx_filter(stmt, q, category_id);
+    sqlite3_bind_int(stmt, 5, stride);
+    long count = 0;
+    int rc = SQLITE_DONE;
+    while (count < max && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        TxCursor *c = &out[count++];
+        c->day = sqlite3_column_int(stmt, 0);
+        c->id = sqlite3_column_int(stmt, 1);
+        c->amount = sqlite3_column_int64(stmt, 2);
+        c->done = 0;
+    }
+    if (count == max) rc = SQLITE_DONE;  /* the rest were not asked for */
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    PROFILE_ROWS(count);
+    *out_count = count;
+    return 0;
+}
+
+Money get_spent_in_category_month(const char *category, const char *yyyymm)
+{
+    PROFILE_FUNCTION();
+    int category_id = lookup_category(category);
+    if (category_id == 0) return 0;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_SPENT_IN_CATEGORY_MONTH);
+    if (!stmt) return 0;
+    sqlite3_bind_int(stmt, 1, category_id);
+    sqlite3_bind_int(stmt, 2, month_key_from_yyyymm(yyyymm));
+    Money total = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) total = sqlite3_column_int64(stmt, 0);
+    stmt_release(stmt);
     return total;
 }
 
-int fetch_expense_totals_by_category(const char *yyyymm, char ***out_categories, double **out_totals, int *out_count)
+int fetch_expense_totals_by_category(const char *yyyymm, ResultSet *out)
 {
-    *out_categories = NULL; *out_totals = NULL; *out_count = 0;
-    const char *sql = "SELECT category, COALESCE(SUM(amount),0) FROM transactions WHERE type='expense' AND date LIKE ? || '%' GROUP BY category ORDER BY 2 DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    sqlite3_bind_text(stmt, 1, yyyymm, -1, SQLITE_TRANSIENT);
-    int cap = 0; int count = 0; char **cats = NULL; double *totals = NULL;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (cap < count + 1) {
-            int ncap = cap == 0 ? 8 : cap * 2;
-            while (ncap < count + 1) ncap *= 2;
-            char **nc = (char**)realloc(cats, ncap * sizeof(char*));
-            if (!nc) { 
-                sqlite3_finalize(stmt); 
-                if (cats) free(cats); 
-                if (totals) free(totals); 
-                return -1; 
-            }
-            cats = nc;
-            double *nt = (double*)realloc(totals, ncap * sizeof(double));
-            if (!nt) { 
-                sqlite3_finalize(stmt); 
-                if (cats) free(cats); 
-                if (totals) free(totals); 
-                return -1; 
-            }
-            totals = nt; cap = ncap;
-        }
-        const unsigned char *c = sqlite3_column_text(stmt, 0);
-        const char *cat = c ? (const char*)c : "Uncategorized";
-        cats[count] = strdup(cat);
-        totals[count] = sqlite3_column_double(stmt, 1);
-        count++;
+    PROFILE_FUNCTION();
+    if (result_set_init(out, 16, 1, 0) != 0) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_EXPENSE_BY_CATEGORY);
+    if (!stmt) { result_set_free(out); return -1; }
+    sqlite3_bind_int(stmt, 1, month_key_from_yyyymm(yyyymm));
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        char cat[CATEGORY_LEN];
+        if (name_of_category(sqlite3_column_int(stmt, 0), cat, sizeof(cat)) != 0 || cat[0] == '\0')
+            snprintf(cat, sizeof(cat), "Uncategorized");
+        int row = result_set_add_row(out, cat);
+        if (row < 0) break;
+        out->money[RS_TOTAL][row] = sqlite3_column_int64(stmt, 1);
     }
-    sqlite3_finalize(stmt);
-    *out_categories = cats; *out_totals = totals; *out_count = count;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) { result_set_free(out); return -1; }
+    PROFILE_ROWS(out->count);
     return 0;
 }
 
+int rebuild_monthly_summary(void)
+{
+    PROFILE_FUNCTION();
+    /* a writer takes the lock up front, so the rebuild cannot fail to upgrade with SQLITE_BUSY */
+    if (db_begin_transaction() != 0) return -1;
+    if (exec_sql("DELETE FROM monthly_summary") != SQLITE_OK ||
+        exec_sql("INSERT INTO monthly_summary(month, category_id, type, total, count) "
+                 "SELECT month_key, category_id, COALESCE(type,''), SUM(amount), COUNT(*) FROM transactions GROUP BY 1, 2, 3") != SQLITE_OK) {
+        db_rollback_transaction();
+        return -1;
+    }
+    /* the summaries feed reports and budget totals; published at the commit */
+    note_reset(CHANGE_TRANSACTIONS);
+    return db_commit_transaction();
+}
+
+int verify_monthly_summary(void)
+{
+    PROFILE_FUNCTION();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_SUMMARY_VERIFY);
+    if (!stmt) return -1;
+    int drift = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) drift = sqlite3_column_int(stmt, 0);
+    stmt_release(stmt);
+    return drift;
+}
+
 int get_setting(const char *key, char *out_value, int out_size)
 {
+    PROFILE_FUNCTION();
     if (!key || !out_value) return -1;
-    const char *sql = "SELECT value FROM settings WHERE key=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_SETTING_GET);
+    if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
     int rc = sqlite3_step(stmt);
     if (rc == SQLITE_ROW) {
         const unsigned char *v = sqlite3_column_text(stmt, 0);
         snprintf(out_value, out_size, "%s", v ? (const char*)v : "");
-        sqlite3_finalize(stmt);
+        stmt_release(stmt);
+        PROFILE_ROWS(1);
         return 0;
     }
-    sqlite3_finalize(stmt);
+    stmt_release(stmt);
     return 1; /* not found */
 }
 
 int set_setting(const char *key, const char *value)
 {
+    PROFILE_FUNCTION();
     if (!key || !value) return -1;
-    const char *sql = "INSERT INTO settings(key, value) VALUES(?, ?) ON CONFLICT(key) DO UPDATE SET value=excluded.value";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_SETTING_SET);
+    if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 2, value, -1, SQLITE_TRANSIENT);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    stmt_release(stmt);
     return rc == SQLITE_DONE ? 0 : -1;
 }
 
 /* Recurring Transactions */
 int add_recurring_transaction(const RecurringTransaction *rt)
 {
-    const char *sql = "INSERT INTO recurring_transactions(type, category, amount, frequency, start_date, end_date, note, is_active) VALUES(?,?,?,?,?,?,?,?)";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    int category_id = category_intern(rt->category);
+    if (category_id <= 0) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_RT_INSERT);
+    if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, rt->type, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, rt->category, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 3, rt->amount);
+    sqlite3_bind_int(stmt, 2, category_id);
+    sqlite3_bind_int64(stmt, 3, rt->amount);
     sqlite3_bind_text(stmt, 4, rt->frequency, -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 5, rt->start_date, -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 6, rt->end_date[0] ? rt->end_date : NULL, -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 7, rt->note, -1, SQLITE_TRANSIENT);
     sqlite3_bind_int(stmt, 8, rt->is_active);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    RecurringTransaction added = *rt;
+    added.id = (int)sqlite3_last_insert_rowid(current_conn()->db);
+    added.last_run[0] = '\0';
+    recurring_schedule_update(&added);
+    return 0;
 }
 
 int edit_recurring_transaction(const RecurringTransaction *rt)
 {
-    const char *sql = "UPDATE recurring_transactions SET type=?, category=?, amount=?, frequency=?, start_date=?, end_date=?, note=?, is_active=? WHERE id=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    int category_id = category_intern(rt->category);
+    if (category_id <= 0) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_RT_UPDATE);
+    if (!stmt) return -1;
     sqlite3_bind_text(stmt, 1, rt->type, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, rt->category, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 3, rt->amount);
+    sqlite3_bind_int(stmt, 2, category_id);
+    sqlite3_bind_int64(stmt, 3, rt->amount);
     sqlite3_bind_text(stmt, 4, rt->frequency, -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 5, rt->start_date, -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 6, rt->end_date[0] ? rt->end_date : NULL, -1, SQLITE_TRANSIENT);
@@ -424,40 +1772,50 @@ int edit_recurring_transaction(const RecurringTransaction *rt)
     sqlite3_bind_int(stmt, 8, rt->is_active);
     sqlite3_bind_int(stmt, 9, rt->id);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    RecurringTransaction updated = *rt;
+    if (rc == SQLITE_ROW) {
+        /* the watermark survives unless the schedule itself changed */
+        const unsigned char *last = sqlite3_column_text(stmt, 0);
+        snprintf(updated.last_run, DATE_LEN, "%s", last ? (const char*)last : "");
+    }
+    stmt_release(stmt);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) return -1;
+    if (rc == SQLITE_ROW) recurring_schedule_update(&updated);
+    return 0;
 }
 
 int delete_recurring_transaction(int id)
 {
-    const char *sql = "DELETE FROM recurring_transactions WHERE id=?";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    PROFILE_FUNCTION();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_RT_DELETE);
+    if (!stmt) return -1;
     sqlite3_bind_int(stmt, 1, id);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    return rc == SQLITE_DONE ? 0 : -1;
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    recurring_schedule_remove(id);
+    return 0;
 }
 
 int fetch_recurring_transactions(RecurringTransaction **out_list, int *out_count)
 {
+    PROFILE_FUNCTION();
     *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, type, category, amount, frequency, start_date, end_date, note, is_active FROM recurring_transactions ORDER BY id DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_RT_ALL);
+    if (!stmt) return -1;
     int cap = 0; RecurringTransaction *list = NULL; int count = 0;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         if (cap < count + 1) {
             int ncap = (cap == 0) ? 16 : cap * 2;
             RecurringTransaction *tmp = (RecurringTransaction*)realloc(list, ncap * sizeof(RecurringTransaction));
-            if (!tmp) { sqlite3_finalize(stmt); free(list); return -1; }
+            if (!tmp) { stmt_release(stmt); free(list); return -1; }
             list = tmp; cap = ncap;
         }
         RecurringTransaction *rt = &list[count++];
         rt->id = sqlite3_column_int(stmt, 0);
         snprintf(rt->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        snprintf(rt->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 2));
-        rt->amount = sqlite3_column_double(stmt, 3);
+        name_of_category(sqlite3_column_int(stmt, 2), rt->category, CATEGORY_LEN);
+        rt->amount = sqlite3_column_int64(stmt, 3);
         snprintf(rt->frequency, 16, "%s", (const char*)sqlite3_column_text(stmt, 4));
         snprintf(rt->start_date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 5));
         const unsigned char *ed = sqlite3_column_text(stmt, 6);
@@ -465,31 +1823,34 @@ int fetch_recurring_transactions(RecurringTransaction **out_list, int *out_count
         const unsigned char *note = sqlite3_column_text(stmt, 7);
         snprintf(rt->note, NOTE_LEN, "%s", note ? (const char*)note : "");
         rt->is_active = sqlite3_column_int(stmt, 8);
+        const unsigned char *last = sqlite3_column_text(stmt, 9);
+        snprintf(rt->last_run, DATE_LEN, "%s", last ? (const char*)last : "");
     }
-    sqlite3_finalize(stmt);
+    stmt_release(stmt);
+    PROFILE_ROWS(count);
     *out_list = list; *out_count = count;
     return 0;
 }
 
 int fetch_active_recurring_transactions(RecurringTransaction **out_list, int *out_count)
 {
+    PROFILE_FUNCTION();
     *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, type, category, amount, frequency, start_date, end_date, note, is_active FROM recurring_transactions WHERE is_active=1 ORDER BY id DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_RT_ACTIVE);
+    if (!stmt) return -1;
     int cap = 0; RecurringTransaction *list = NULL; int count = 0;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         if (cap < count + 1) {
             int ncap = (cap == 0) ? 16 : cap * 2;
             RecurringTransaction *tmp = (RecurringTransaction*)realloc(list, ncap * sizeof(RecurringTransaction));
-            if (!tmp) { sqlite3_finalize(stmt); free(list); return -1; }
+            if (!tmp) { stmt_release(stmt); free(list); return -1; }
             list = tmp; cap = ncap;
         }
         RecurringTransaction *rt = &list[count++];
         rt->id = sqlite3_column_int(stmt, 0);
         snprintf(rt->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        snprintf(rt->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 2));
-        rt->amount = sqlite3_column_double(stmt, 3);
+        name_of_category(sqlite3_column_int(stmt, 2), rt->category, CATEGORY_LEN);
+        rt->amount = sqlite3_column_int64(stmt, 3);
         snprintf(rt->frequency, 16, "%s", (const char*)sqlite3_column_text(stmt, 4));
         snprintf(rt->start_date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 5));
         const unsigned char *ed = sqlite3_column_text(stmt, 6);
@@ -497,221 +1858,257 @@ int fetch_active_recurring_transactions(RecurringTransaction **out_list, int *ou
         const unsigned char *note = sqlite3_column_text(stmt, 7);
         snprintf(rt->note, NOTE_LEN, "%s", note ? (const char*)note : "");
         rt->is_active = sqlite3_column_int(stmt, 8);
+        const unsigned char *last = sqlite3_column_text(stmt, 9);
+        snprintf(rt->last_run, DATE_LEN, "%s", last ? (const char*)last : "");
     }
-    sqlite3_finalize(stmt);
+    stmt_release(stmt);
+    PROFILE_ROWS(count);
     *out_list = list; *out_count = count;
     return 0;
 }
 
-int process_recurring_transactions(void)
-{
-    RecurringTransaction *list = NULL;
-    int count = 0;
-    if (fetch_active_recurring_transactions(&list, &count) != 0) return -1;
-    
-    char current_date[DATE_LEN];
-    get_current_yyyymmdd(current_date);
-    
-    int created = 0;
-    for (int i = 0; i < count; ++i) {
-        /* Simple check: if start_date <= current_date and (no end_date or end_date >= current_date) */
-        if (strcmp(list[i].start_date, current_date) <= 0) {
-            if (list[i].end_date[0] == '\0' || strcmp(list[i].end_date, current_date) >= 0) {
-                /* Check if transaction already exists for this period */
-                Transaction check = {0};
-                snprintf(check.type, TYPE_LEN, "%s", list[i].type);
-                snprintf(check.category, CATEGORY_LEN, "%s", list[i].category);
-                check.amount = list[i].amount;
-                snprintf(check.date, DATE_LEN, "%s", current_date);
-                /* Ensure note fits: "Recurring: " is 11 chars, so we have NOTE_LEN-11 for the note */
-                int max_note_len = NOTE_LEN - 12; /* -12 for "Recurring: " + null terminator */
-                if (max_note_len > 0) {
-                    snprintf(check.note, NOTE_LEN, "Recurring: %.*s", max_note_len, list[i].note);
-                } else {
-                    strncpy(check.note, "Recurring", NOTE_LEN - 1);
-                    check.note[NOTE_LEN - 1] = '\0';
-                }
-                
-                /* Simple check: see if similar transaction exists today */
-                Transaction *existing = NULL;
-                int exist_count = 0;
-                fetch_transactions_by_date_range(current_date, current_date, &existing, &exist_count);
-                int found = 0;
-                for (int j = 0; j < exist_count; ++j) {
-                    if (strcmp(existing[j].type, check.type) == 0 &&
-                        strcmp(existing[j].category, check.category) == 0 &&
-                        fabs(existing[j].amount - check.amount) < 0.01) {
-                        found = 1;
-                        break;
-                    }
-                }
-                free(existing);
-                
-                if (!found) {
-                    add_transaction(&check);
-                    created++;
-                }
-            }
-        }
-    }
-    
-    free(list);
-    return created;
+int add_recurring_occurrence(int recurring_id, const Transaction *t)
+{
+    PROFILE_FUNCTION();
+    int category_id = category_intern(t->category);
+    if (category_id <= 0) return -1;
+    sqlite3_stmt *stmt = stmt_acquire(STMT_RT_OCCURRENCE_INSERT);
+    if (!stmt) return -1;
+    sqlite3_bind_text(stmt, 1, t->type, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, category_id);
+    sqlite3_bind_int64(stmt, 3, t->amount);
+    sqlite3_bind_text(stmt, 4, t->date, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 5, t->note, -1, SQLITE_TRANSIENT);
+    int day = day_key_from_date(t->date);
+    sqlite3_bind_int(stmt, 6, day / 100);
+    sqlite3_bind_int(stmt, 7, day);
+    sqlite3_bind_int(stmt, 8, recurring_id);
+    int rc = sqlite3_step(stmt);
+    stmt_release(stmt);
+    if (rc != SQLITE_DONE) return -1;
+    if (sqlite3_changes(current_conn()->db) == 0) return 1; /* already materialized */
+    Transaction added = *t;
+    added.id = (int)sqlite3_last_insert_rowid(current_conn()->db);
+    note_ledger_upsert(&added);
+    if (change_wanted(CHANGE_TRANSACTIONS)) note_tx_change(CHANGE_INSERT, NULL, &added);
+    return 0;
+}
+
+int set_recurring_watermark(int id, const char *last_run)
+{
+    PROFILE_FUNCTION();
+    sqlite3_stmt *stmt = stmt_acquire(STMT_RT_SET_WATERMARK);
+    if (!stmt) return -1;
+    sqlite3_bind_text(stmt, 1, last_run && last_run[0] ? last_run : NULL, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, id);
+    int rc = sqlite3_step(stmt);
+    stmt_release(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
 }
 
 /* Advanced Queries */
 int fetch_transactions_by_category(const char *category, Transaction **out_list, int *out_count)
 {
-    *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, type, category, amount, date, note FROM transactions WHERE category=? ORDER BY date DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    sqlite3_bind_text(stmt, 1, category, -1, SQLITE_TRANSIENT);
-    int cap = 0; Transaction *list = NULL; int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (cap < count + 1) {
-            int ncap = (cap == 0) ? 32 : cap * 2;
-            Transaction *tmp = (Transaction*)realloc(list, ncap * sizeof(Transaction));
-            if (!tmp) { sqlite3_finalize(stmt); free(list); return -1; }
-            list = tmp; cap = ncap;
-        }
-        Transaction *t = &list[count++];
-        t->id = sqlite3_column_int(stmt, 0);
-        snprintf(t->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        snprintf(t->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 2));
-        t->amount = sqlite3_column_double(stmt, 3);
-        snprintf(t->date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 4));
-        const unsigned char *note = sqlite3_column_text(stmt, 5);
-        snprintf(t->note, NOTE_LEN, "%s", note ? (const char*)note : "");
-    }
-    sqlite3_finalize(stmt);
-    *out_list = list; *out_count = count;
-    return 0;
+    PROFILE_FUNCTION();
+    TxQuery q = { .category = category };
+    return collect_transactions(&q, out_list, out_count);
 }
 
 int fetch_transactions_by_date_range(const char *start_date, const char *end_date, Transaction **out_list, int *out_count)
 {
-    *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, type, category, amount, date, note FROM transactions WHERE date >= ? AND date <= ? ORDER BY date DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    sqlite3_bind_text(stmt, 1, start_date, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, end_date, -1, SQLITE_TRANSIENT);
-    int cap = 0; Transaction *list = NULL; int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (cap < count + 1) {
-            int ncap = (cap == 0) ? 32 : cap * 2;
-            Transaction *tmp = (Transaction*)realloc(list, ncap * sizeof(Transaction));
-            if (!tmp) { sqlite3_finalize(stmt); free(list); return -1; }
-            list = tmp; cap = ncap;
-        }
-        Transaction *t = &list[count++];
-        t->id = sqlite3_column_int(stmt, 0);
-        snprintf(t->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        snprintf(t->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 2));
-        t->amount = sqlite3_column_double(stmt, 3);
-        snprintf(t->date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 4));
-        const unsigned char *note = sqlite3_column_text(stmt, 5);
-        snprintf(t->note, NOTE_LEN, "%s", note ? (const char*)note : "");
+    PROFILE_FUNCTION();
+    TxQuery q = { .day_from = day_key_from_date(start_date), .day_to = day_key_from_date(end_date) };
+    if (q.day_to == 0) { *out_list = NULL; *out_count = 0; return 0; } /* unparseable end date matches nothing */
+    return collect_transactions(&q, out_list, out_count);
+}
+
+typedef struct { char *s; size_t len, cap; } FtsQuery;
+
+static int fts_append(FtsQuery *q, const char *text)
+{
+    size_t n = strlen(text);
+    if (q->len + n + 1 > q->cap) {
+        size_t ncap = q->cap ? q->cap * 2 : 256;
+        while (ncap < q->len + n + 1) ncap *= 2;
+        char *tmp = (char*)realloc(q->s, ncap);
+        if (!tmp) return -1;
+        q->s = tmp; q->cap = ncap;
     }
-    sqlite3_finalize(stmt);
-    *out_list = list; *out_count = count;
+    memcpy(q->s + q->len, text, n + 1);
+    q->len += n;
     return 0;
 }
 
-int fetch_transactions_search(const char *search_term, Transaction **out_list, int *out_count)
+/* One term matches the note, or the name of the row's category: the index
+ * holds category ids (FTS_INSERT_TRIGGER_SQL), so the name is looked up in
+ * categories_fts and becomes the ids it matches. */
+static int append_fts_term(FtsQuery *q, const char *phrase)
 {
-    *out_list = NULL; *out_count = 0;
-    const char *sql = "SELECT id, type, category, amount, date, note FROM transactions WHERE category LIKE ? OR note LIKE ? ORDER BY date DESC";
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(g_db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
-    char pattern[256];
-    snprintf(pattern, sizeof(pattern), "%%%s%%", search_term);
-    sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, pattern, -1, SQLITE_TRANSIENT);
-    int cap = 0; Transaction *list = NULL; int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (cap < count + 1) {
-            int ncap = (cap == 0) ? 32 : cap * 2;
-            Transaction *tmp = (Transaction*)realloc(list, ncap * sizeof(Transaction));
-            if (!tmp) { sqlite3_finalize(stmt); free(list); return -1; }
-            list = tmp; cap = ncap;
-        }
-        Transaction *t = &list[count++];
-        t->id = sqlite3_column_int(stmt, 0);
-        snprintf(t->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
-        snprintf(t->category, CATEGORY_LEN, "%s", (const char*)sqlite3_column_text(stmt, 2));
-        t->amount = sqlite3_column_double(stmt, 3);
-        snprintf(t->date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 4));
-        const unsigned char *note = sqlite3_column_text(stmt, 5);
-        snprintf(t->note, NOTE_LEN, "%s", note ? (const char*)note : "");
+    sqlite3_stmt *stmt = stmt_acquire(STMT_CATEGORY_MATCH);
+    if (!stmt) return -1;
+    sqlite3_bind_text(stmt, 1, phrase, -1, SQLITE_TRANSIENT);
+    int rc, ids = 0, ok = fts_append(q, "(note : ") == 0 && fts_append(q, phrase) == 0;
+    char token[32];
+    while (ok && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        snprintf(token, sizeof(token), "%s\"c%d\"", ids++ ? " OR " : " OR category : (", sqlite3_column_int(stmt, 0));
+        ok = fts_append(q, token) == 0;
     }
-    sqlite3_finalize(stmt);
-    *out_list = list; *out_count = count;
-    return 0;
+    stmt_release(stmt);
+    if (!ok || rc != SQLITE_DONE) return -1;
+    return fts_append(q, ids ? "))" : ")");
 }
 
-int get_monthly_totals(int months_back, char ***out_months, double **out_income, double **out_expense, int *out_count)
+/* Turn what the user typed into an FTS5 query: bare words become prefix terms,
+ * "quoted text" a phrase (a trailing unclosed quote is a prefix phrase), and
+ * terms are ANDed. Quoting every term keeps FTS5 operators and punctuation
+ * from producing syntax errors. Returns the number of terms, -1 on error. */
+static int build_fts_query(const char *in, FtsQuery *out)
 {
-    *out_months = NULL; *out_income = NULL; *out_expense = NULL; *out_count = 0;
-    
-    char current_yyyymm[9];
-    get_current_yyyymm(current_yyyymm);
-    int y, m;
-    sscanf(current_yyyymm, "%d-%d", &y, &m);
-    
-    char **months = (char**)calloc(months_back, sizeof(char*));
-    double *income = (double*)calloc(months_back, sizeof(double));
-    double *expense = (double*)calloc(months_back, sizeof(double));
-    if (!months || !income || !expense) {
-        free(months); free(income); free(expense);
-        return -1;
+    char term[256];
+    int terms = 0;
+    while (*in) {
+        while (*in == ' ' || *in == '\t') ++in;
+        if (!*in) break;
+        int phrase = (*in == '"');
+        if (phrase) ++in;
+        const char *start = in;
+        while (*in && (phrase ? *in != '"' : (*in != ' ' && *in != '\t' && *in != '"'))) ++in;
+        size_t len = (size_t)(in - start);
+        int closed = phrase && *in == '"';
+        if (closed) ++in;
+        int indexable = 0;  /* the tokenizer drops pure punctuation */
+        for (size_t i = 0; i < len && !indexable; ++i)
+            indexable = isalnum((unsigned char)start[i]) || (unsigned char)start[i] >= 0x80;
+        if (!indexable) continue;
+        /* quotes, star, terminator */
+        if (len + 4 > sizeof(term)) break;
+        snprintf(term, sizeof(term), "\"%.*s\"%s", (int)len, start, closed ? "" : "*");
+        if ((terms && fts_append(out, " AND ") != 0) || append_fts_term(out, term) != 0) return -1;
+        terms++;
     }
-    
-    for (int i = 0; i < months_back; ++i) {
-        months[i] = (char*)malloc(9);
-        snprintf(months[i], 9, "%04d-%02d", y, m);
-        income[i] = get_total_by_type_for_month(months[i], "income");
-        expense[i] = get_total_by_type_for_month(months[i], "expense");
-        m--;
-        if (m < 1) { m = 12; y--; }
+    return terms;
+}
+
+typedef struct { SearchHit *hits; int count; int max; } LikeSearch;
+
+static int collect_like_hit(const Transaction *t, void *user_data)
+{
+    LikeSearch *ls = (LikeSearch*)user_data;
+    SearchHit *h = &ls->hits[ls->count++];
+    h->tx = *t;
+    h->score = 0.0;
+    snprintf(h->snippet, SNIPPET_LEN, "%s", t->note);
+    return ls->count == ls->max;
+}
+
+int search_transactions(const char *query, int limit, SearchHit **out_hits, int *out_count)
+{
+    PROFILE_FUNCTION();
+    *out_hits = NULL; *out_count = 0;
+    if (!query || limit <= 0) return -1;
+    SearchHit *hits = (SearchHit*)calloc(limit, sizeof(SearchHit));
+    if (!hits) return -1;
+
+    FtsQuery match = {0};
+    int count = 0, rc = SQLITE_ERROR;
+    if (build_fts_query(query, &match) > 0) {
+        sqlite3_stmt *stmt = stmt_acquire(STMT_TX_SEARCH);
+        if (!stmt) { free(match.s); free(hits); return -1; }
+        sqlite3_bind_text(stmt, 1, match.s, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, limit);
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && count < limit) {
+            SearchHit *h = &hits[count++];
+            Transaction *t = &h->tx;
+            t->id = sqlite3_column_int(stmt, 0);
+            snprintf(t->type, TYPE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 1));
+            name_of_category(sqlite3_column_int(stmt, 2), t->category, CATEGORY_LEN);
+            t->amount = sqlite3_column_int64(stmt, 3);
+            snprintf(t->date, DATE_LEN, "%s", (const char*)sqlite3_column_text(stmt, 4));
+            const unsigned char *note = sqlite3_column_text(stmt, 5);
+            snprintf(t->note, NOTE_LEN, "%s", note ? (const char*)note : "");
+            h->score = -sqlite3_column_double(stmt, 6);  /* bm25 is lower-is-better */
+            const unsigned char *snip = sqlite3_column_text(stmt, 7);
+            snprintf(h->snippet, SNIPPET_LEN, "%s", snip ? (const char*)snip : "");
+        }
+        stmt_release(stmt);
     }
-    
-    *out_months = months;
-    *out_income = income;
-    *out_expense = expense;
-    *out_count = months_back;
+    free(match.s);
+    if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+        /* nothing indexable in the query, or FTS failed: substring scan, newest first */
+        TxQuery q = { .search = query };
+        LikeSearch ls = { hits, 0, limit };
+        if (visit_transactions(&q, collect_like_hit, &ls) < 0) { free(hits); return -1; }
+        count = ls.count;
+    }
+    PROFILE_ROWS(count);
+    *out_hits = hits;
+    *out_count = count;
     return 0;
 }
 
-int get_category_trends(const char *category, int months_back, char ***out_months, double **out_amounts, int *out_count)
+int fetch_transactions_search(const char *search_term, Transaction **out_list, int *out_count)
+{
+    PROFILE_FUNCTION();
+    TxQuery q = { .search = search_term ? search_term : "" };
+    return collect_transactions(&q, out_list, out_count);
+}
+
+/* Months since year 0 for a YYYYMM key, so consecutive months differ by one. */
+static int month_ordinal(int month_key)
 {
-    *out_months = NULL; *out_amounts = NULL; *out_count = 0;
-    
+    return (month_key / 100) * 12 + (month_key % 100) - 1;
+}
+
+int fetch_monthly_aggregate(int months_back, const char *category, ResultSet *out)
+{
+    PROFILE_FUNCTION();
+    if (!out) return -1;
+    if (ledger_cache_monthly(months_back, category, out) == 0) { PROFILE_ROWS(out->count); return 0; }
+    memset(out, 0, sizeof(*out));
+    if (months_back < 1) return -1;
+
     char current_yyyymm[9];
     get_current_yyyymm(current_yyyymm);
-    int y, m;
-    sscanf(current_yyyymm, "%d-%d", &y, &m);
-    
-    char **months = (char**)calloc(months_back, sizeof(char*));
-    double *amounts = (double*)calloc(months_back, sizeof(double));
-    if (!months || !amounts) {
-        free(months); free(amounts);
-        return -1;
-    }
-    
+    int last = month_ordinal(month_key_from_yyyymm(current_yyyymm));
+    int first = last - (months_back - 1);
+
+    if (result_set_init(out, months_back, 2, 0) != 0) return -1;
     for (int i = 0; i < months_back; ++i) {
-        months[i] = (char*)malloc(9);
-        snprintf(months[i], 9, "%04d-%02d", y, m);
-        amounts[i] = get_spent_in_category_month(category, months[i]);
-        m--;
-        if (m < 1) { m = 12; y--; }
+        int ord = last - i;
+        char label[16];
+        snprintf(label, sizeof(label), "%04d-%02d", ord / 12, ord % 12 + 1);
+        if (result_set_add_row(out, label) < 0) { result_set_free(out); return -1; }
     }
-    
-    *out_months = months;
-    *out_amounts = amounts;
-    *out_count = months_back;
+
+    PROFILE_ROWS(out->count);
+    if (category && lookup_category(category) == 0) return 0; /* unknown category: all zero */
+    sqlite3_stmt *stmt = stmt_acquire(category ? STMT_MONTHLY_CATEGORY_TOTALS : STMT_MONTHLY_TOTALS);
+    if (!stmt) { result_set_free(out); return -1; }
+    int p = 1;
+    if (category) sqlite3_bind_int(stmt, p++, lookup_category(category));
+    sqlite3_bind_int(stmt, p++, (first / 12) * 100 + first % 12 + 1);
+    sqlite3_bind_int(stmt, p++, (last / 12) * 100 + last % 12 + 1);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int i = last - month_ordinal(sqlite3_column_int(stmt, 0));
+        if (i < 0 || i >= months_back) continue;
+        const char *type = (const char*)sqlite3_column_text(stmt, 1);
+        Money total = sqlite3_column_int64(stmt, 2);
+        if (type && strcmp(type, "income") == 0) out->money[RS_INCOME][i] = total;
+        else if (type && strcmp(type, "expense") == 0) out->money[RS_EXPENSE][i] = total;
+    }
+    stmt_release(stmt);
     return 0;
 }
 
+int get_monthly_totals(int months_back, ResultSet *out)
+{
+    PROFILE_FUNCTION();
+    return fetch_monthly_aggregate(months_back, NULL, out);
+}
 
+int get_category_trends(const char *category, int months_back, ResultSet *out)
+{
+    PROFILE_FUNCTION();
+    if (!category) return -1;
+    return fetch_monthly_aggregate(months_back, category, out);
+}
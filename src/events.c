@@ -0,0 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include "events.h"
+
+typedef struct Subscriber {
+    ChangeFn fn;
+    void *user_data;
+} Subscriber;
+
+static Subscriber g_subs[EVENTS_MAX_SUBSCRIBERS];
+static int g_sub_count = 0;
+static atomic_int g_has_subs = 0;  /* read without the lock on every write */
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int events_subscribe(ChangeFn fn, void *user_data)
+{
+    if (!fn) return -1;
+    pthread_mutex_lock(&g_lock);
+    int rc = -1;
+    if (g_sub_count < EVENTS_MAX_SUBSCRIBERS) {
+        g_subs[g_sub_count++] = (Subscriber){ fn, user_data };
+        atomic_store(&g_has_subs, 1);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return rc;
+}
+
+void events_unsubscribe(ChangeFn fn, void *user_data)
+{
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_sub_count; ++i) {
+        if (g_subs[i].fn == fn && g_subs[i].user_data == user_data) {
+            g_subs[i] = g_subs[--g_sub_count];
+            break;
+        }
+    }
+    atomic_store(&g_has_subs, g_sub_count > 0);
+    pthread_mutex_unlock(&g_lock);
+}
+
+int events_has_subscribers(void)
+{
+    return atomic_load(&g_has_subs);
+}
+
+void events_publish(const ChangeEvent *event)
+{
+    /* call out on a copy, so a subscriber may (un)subscribe from its callback */
+    Subscriber subs[EVENTS_MAX_SUBSCRIBERS];
+    pthread_mutex_lock(&g_lock);
+    int n = g_sub_count;
+    for (int i = 0; i < n; ++i) subs[i] = g_subs[i];
+    pthread_mutex_unlock(&g_lock);
+    for (int i = 0; i < n; ++i) subs[i].fn(event, subs[i].user_data);
+}
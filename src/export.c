@@ -0,0 +1,327 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+#include "export.h"
+#include "database.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define EXPORT_MAX_THREADS 8
+#define EXPORT_SLOTS 8                 /* chunks in flight between fetch and write */
+#define EXPORT_WRITE_BUFFER (1 << 20)
+
+typedef struct OutBuf {
+    char *data;
+    size_t len, cap;
+    int failed;
+} OutBuf;
+
+enum { SLOT_EMPTY, SLOT_FILLED, SLOT_FORMATTED };
+
+typedef struct ExportSlot {
+    Transaction rows[EXPORT_CHUNK_ROWS];
+    int nrows;
+    int state;
+    OutBuf out;
+} ExportSlot;
+
+typedef struct ExportJob {
+    ExportFormat format;
+    ExportSlot *slots;
+    long fetched;              /* chunks handed to the workers */
+    long next_format;          /* next chunk a worker will format */
+    int finished;              /* no more chunks will be fetched */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} ExportJob;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int default_thread_count(void)
+{
+    long n = 2;
+#ifdef _SC_NPROCESSORS_ONLN
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1) n = 1;
+    if (n > EXPORT_MAX_THREADS) n = EXPORT_MAX_THREADS;
+    return (int)n;
+}
+
+/* ---- output buffer ---- */
+
+static char *buf_reserve(OutBuf *b, size_t extra)
+{
+    if (b->failed) return NULL;
+    if (b->len + extra > b->cap) {
+        size_t ncap = b->cap ? b->cap : 64 * 1024;
+        while (ncap < b->len + extra) ncap *= 2;
+        char *p = (char*)realloc(b->data, ncap);
+        if (!p) { b->failed = 1; return NULL; }
+        b->data = p; b->cap = ncap;
+    }
+    return b->data + b->len;
+}
+
+static void buf_put(OutBuf *b, const void *src, size_t n)
+{
+    char *p = buf_reserve(b, n);
+    if (!p) return;
+    memcpy(p, src, n);
+    b->len += n;
+}
+
+static void buf_puts(OutBuf *b, const char *s)
+{
+    buf_put(b, s, strlen(s));
+}
+
+static void buf_putc(OutBuf *b, char c)
+{
+    buf_put(b, &c, 1);
+}
+
+static void buf_put_u32(OutBuf *b, uint32_t v)
+{
+    unsigned char le[4] = { (unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24) };
+    buf_put(b, le, 4);
+}
+
+static void buf_put_u64(OutBuf *b, uint64_t v)
+{
+    buf_put_u32(b, (uint32_t)v);
+    buf_put_u32(b, (uint32_t)(v >> 32));
+}
+
+/* ---- formatters ---- */
+
+static void put_csv_field(OutBuf *b, const char *s, int always_quote)
+{
+    if (!always_quote && !s[strcspn(s, ",\"\r\n")]) { buf_puts(b, s); return; }
+    buf_putc(b, '"');
+    for (const char *p = s; *p; ) {
+        size_t run = strcspn(p, "\"");
+        buf_put(b, p, run);
+        p += run;
+        if (*p) { buf_puts(b, "\"\""); ++p; }
+    }
+    buf_putc(b, '"');
+}
+
+static void format_csv(const ExportSlot *s, OutBuf *b)
+{
+    char num[48];
+    for (int i = 0; i < s->nrows; ++i) {
+        const Transaction *t = &s->rows[i];
+        snprintf(num, sizeof(num), "%d,", t->id);
+        buf_puts(b, num);
+        put_csv_field(b, t->type, 0);
+        buf_putc(b, ',');
+        put_csv_field(b, t->category, 0);
+        money_to_string(t->amount, num, sizeof(num));
+        buf_putc(b, ',');
+        buf_puts(b, num);
+        buf_putc(b, ',');
+        buf_puts(b, t->date);
+        buf_putc(b, ',');
+        put_csv_field(b, t->note, 1);
+        buf_putc(b, '\n');
+    }
+}
+
+static void put_json_string(OutBuf *b, const char *s)
+{
+    buf_putc(b, '"');
+    for (const unsigned char *p = (const unsigned char*)s; *p; ++p) {
+        if (*p == '"' || *p == '\\') { buf_putc(b, '\\'); buf_putc(b, (char)*p); }
+        else if (*p < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", *p);
+            buf_puts(b, esc);
+        }
+        else buf_putc(b, (char)*p);
+    }
+    buf_putc(b, '"');
+}
+
+static void format_jsonl(const ExportSlot *s, OutBuf *b)
+{
+    char num[48];
+    for (int i = 0; i < s->nrows; ++i) {
+        const Transaction *t = &s->rows[i];
+        snprintf(num, sizeof(num), "{\"id\":%d,\"type\":", t->id);
+        buf_puts(b, num);
+        put_json_string(b, t->type);
+        buf_puts(b, ",\"category\":");
+        put_json_string(b, t->category);
+        money_to_string(t->amount, num, sizeof(num));
+        buf_puts(b, ",\"amount\":");
+        buf_puts(b, num);
+        buf_puts(b, ",\"date\":");
+        put_json_string(b, t->date);
+        buf_puts(b, ",\"note\":");
+        put_json_string(b, t->note);
+        buf_puts(b, "}\n");
+    }
+}
+
+static void put_string_column(OutBuf *b, const ExportSlot *s, size_t field)
+{
+    uint32_t end = 0;
+    for (int i = 0; i < s->nrows; ++i) {
+        end += (uint32_t)strlen((const char*)&s->rows[i] + field);
+        buf_put_u32(b, end);
+    }
+    for (int i = 0; i < s->nrows; ++i) buf_puts(b, (const char*)&s->rows[i] + field);
+}
+
+static void format_binary(const ExportSlot *s, OutBuf *b)
+{
+    buf_put_u32(b, (uint32_t)s->nrows);
+    for (int i = 0; i < s->nrows; ++i) buf_put_u32(b, (uint32_t)s->rows[i].id);
+    for (int i = 0; i < s->nrows; ++i) buf_put_u32(b, (uint32_t)day_key_from_date(s->rows[i].date));
+    for (int i = 0; i < s->nrows; ++i) buf_put_u64(b, (uint64_t)s->rows[i].amount);
+    for (int i = 0; i < s->nrows; ++i) {
+        const char *type = s->rows[i].type;
+        buf_putc(b, (char)(strcmp(type, "expense") == 0 ? 0 : strcmp(type, "income") == 0 ? 1 : 2));
+    }
+    put_string_column(b, s, offsetof(Transaction, category));
+    put_string_column(b, s, offsetof(Transaction, note));
+}
+
+static void format_slot(const ExportJob *job, ExportSlot *s)
+{
+    s->out.len = 0;
+    s->out.failed = 0;
+    switch (job->format) {
+    case EXPORT_JSONL: format_jsonl(s, &s->out); break;
+    case EXPORT_BINARY: format_binary(s, &s->out); break;
+    default: format_csv(s, &s->out); break;
+    }
+}
+
+static void *format_worker(void *arg)
+{
+    ExportJob *job = (ExportJob*)arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        while (job->next_format >= job->fetched && !job->finished)
+            pthread_cond_wait(&job->cond, &job->lock);
+        if (job->next_format >= job->fetched) { pthread_mutex_unlock(&job->lock); break; }
+        ExportSlot *s = &job->slots[job->next_format++ % EXPORT_SLOTS];
+        pthread_mutex_unlock(&job->lock);
+
+        format_slot(job, s);
+
+        pthread_mutex_lock(&job->lock);
+        s->state = SLOT_FORMATTED;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+    return NULL;
+}
+
+ExportFormat export_format_from_path(const char *path)
+{
+    const char *dot = path ? strrchr(path, '.') : NULL;
+    if (!dot) return EXPORT_CSV;
+    if (strcmp(dot, ".jsonl") == 0 || strcmp(dot, ".json") == 0) return EXPORT_JSONL;
+    if (strcmp(dot, ".fmlb") == 0 || strcmp(dot, ".bin") == 0) return EXPORT_BINARY;
+    return EXPORT_CSV;
+}
+
+int export_transactions(const char *path, ExportFormat format, const TxQuery *filter,
+                        ExportProgressFn on_progress, void *user_data, ExportStats *out_stats)
+{
+    ExportStats stats = {0};
+    if (out_stats) *out_stats = stats;
+    if (!path) return -1;
+    double t0 = now_seconds();
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    setvbuf(f, NULL, _IOFBF, EXPORT_WRITE_BUFFER);
+
+    ExportJob job;
+    memset(&job, 0, sizeof(job));
+    job.format = format;
+    job.slots = (ExportSlot*)calloc(EXPORT_SLOTS, sizeof(ExportSlot));
+    if (!job.slots) { fclose(f); return -1; }
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+
+    pthread_t threads[EXPORT_MAX_THREADS];
+    int started = 0, nthreads = default_thread_count();
+    for (int i = 0; i < nthreads; ++i)
+        if (pthread_create(&threads[started], NULL, format_worker, &job) == 0) started++;
+
+    int rc = 0;
+    if (format == EXPORT_CSV) rc = fputs("id,type,category,amount,date,note\n", f) < 0 ? -1 : 0;
+    else if (format == EXPORT_BINARY) rc = fwrite("FINLEDG1", 1, 8, f) == 8 ? 0 : -1;
+    stats.bytes_written = format == EXPORT_CSV ? 34 : format == EXPORT_BINARY ? 8 : 0;
+
+    /* Fetch ahead into free slots, then write the oldest chunk once formatted. */
+    TxCursor cursor = {0};
+    long written = 0, fetched = 0;
+    int eof = 0;
+    while (rc == 0) {
+        while (!eof && fetched - written < EXPORT_SLOTS) {
+            ExportSlot *s = &job.slots[fetched % EXPORT_SLOTS];
+            if (fetch_transaction_page(filter, &cursor, s->rows, EXPORT_CHUNK_ROWS, &s->nrows) != 0) { rc = -1; break; }
+            if (s->nrows == 0) { eof = 1; break; }
+            pthread_mutex_lock(&job.lock);
+            s->state = SLOT_FILLED;
+            job.fetched = ++fetched;
+            pthread_cond_broadcast(&job.cond);
+            pthread_mutex_unlock(&job.lock);
+        }
+        if (rc != 0 || written == fetched) break;
+
+        ExportSlot *s = &job.slots[written % EXPORT_SLOTS];
+        if (started == 0) format_slot(&job, s);  /* no threads available: format inline */
+        else {
+            pthread_mutex_lock(&job.lock);
+            while (s->state != SLOT_FORMATTED) pthread_cond_wait(&job.cond, &job.lock);
+            pthread_mutex_unlock(&job.lock);
+        }
+        if (s->out.failed || fwrite(s->out.data, 1, s->out.len, f) != s->out.len) rc = -1;
+        stats.rows_written += s->nrows;
+        stats.bytes_written += (long long)s->out.len;
+        s->state = SLOT_EMPTY;
+        written++;
+        if (rc == 0 && on_progress && on_progress(stats.rows_written, user_data) != 0) rc = -1;
+    }
+
+    pthread_mutex_lock(&job.lock);
+    job.finished = 1;
+    job.next_format = job.fetched;  /* abandon chunks not yet formatted after an error */
+    pthread_cond_broadcast(&job.cond);
+    pthread_mutex_unlock(&job.lock);
+    for (int i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+
+    if (rc == 0 && format == EXPORT_BINARY) {
+        static const unsigned char end_marker[4] = {0};
+        if (fwrite(end_marker, 1, 4, f) != 4) rc = -1;
+        stats.bytes_written += 4;
+    }
+    if (fclose(f) != 0) rc = -1;
+    for (int i = 0; i < EXPORT_SLOTS; ++i) free(job.slots[i].out.data);
+    free(job.slots);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+
+    stats.seconds = now_seconds() - t0;
+    if (stats.seconds > 0) {
+        stats.rows_per_sec = stats.rows_written / stats.seconds;
+        stats.mb_per_sec = stats.bytes_written / stats.seconds / (1024.0 * 1024.0);
+    }
+    if (out_stats) *out_stats = stats;
+    return rc;
+}
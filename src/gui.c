@@ -7,9 +7,21 @@
 #include "budget.h"
 #include "goal.h"
 #include "chart.h"
+#include "import.h"
+#include "export.h"
+#include "recurring.h"
+#include "backup.h"
+#include "write_queue.h"
+#include "tx_loader.h"
+#include "tx_model.h"
+#include "events.h"
+#include "profile.h"
 
 typedef struct { AppWidgets *app; int page; } NavData;
 
+static void ensure_page(AppWidgets *app, int page);
+static void dispatch_to_main(void (*fn)(void *), void *arg);
+
 static void show_dashboard_cb(GtkButton *btn, gpointer data) {
     (void)btn;
     AppWidgets *app = (AppWidgets*)data;
@@ -19,13 +31,14 @@ static void show_dashboard_cb(GtkButton *btn, gpointer data) {
 static void show_notebook_page_cb(GtkButton *btn, gpointer data) {
     (void)btn;
     NavData *nd = (NavData*)data;
+    ensure_page(nd->app, nd->page);
     gtk_notebook_set_current_page(GTK_NOTEBOOK(nd->app->notebook), nd->page);
     gtk_stack_set_visible_child_name(GTK_STACK(nd->app->stack), "main");
 }
 
-enum { COL_T_ID, COL_T_TYPE, COL_T_CATEGORY, COL_T_AMOUNT, COL_T_DATE, COL_T_NOTE, N_COL_T };
 enum { COL_B_ID, COL_B_CATEGORY, COL_B_LIMIT, COL_B_SPENT, COL_B_PROGRESS, N_COL_B };
 enum { COL_G_ID, COL_G_NAME, COL_G_TARGET, COL_G_MONTHLY, COL_G_START, COL_G_PROJECTION, N_COL_G };
+enum { COL_D_NAME, COL_D_CALLS, COL_D_ROWS, COL_D_TOTAL, COL_D_MEAN, COL_D_P50, COL_D_P95, COL_D_P99, COL_D_MAX, N_COL_D };
 
 
 static void refresh_transactions(AppWidgets *app);
@@ -39,38 +52,46 @@ static void on_delete_budget(GtkButton *btn, gpointer data);
 
 static void amount_cell_data_func(GtkTreeViewColumn *col, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data) {
     (void)col; (void)user_data;
-    double val = 0.0; char curbuf[32] = "$"; char out[64];
+    gint64 val = 0; char curbuf[32] = "$"; char out[64];
     gtk_tree_model_get(model, iter, COL_T_AMOUNT, &val, -1);
     if (get_setting("currency", curbuf, sizeof(curbuf)) != 0) strncpy(curbuf, "$", sizeof(curbuf));
-    format_amount_currency(val, curbuf, out, sizeof(out));
+    format_money(val, curbuf, out, sizeof(out));
     g_object_set(renderer, "text", out, NULL);
 }
 
 static void goal_amount_cell_data_func(GtkTreeViewColumn *col, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data) {
     (void)col; (void)user_data;
-    double val = 0.0;
+    gint64 val = 0;
     int col_idx = GPOINTER_TO_INT(user_data);
     gtk_tree_model_get(model, iter, col_idx, &val, -1);
     /* Use same currency format as Transactions and Budget */
     char curbuf[32] = "$";
     char out[64];
     if (get_setting("currency", curbuf, sizeof(curbuf)) != 0) strncpy(curbuf, "$", sizeof(curbuf));
-    format_amount_currency(val, curbuf, out, sizeof(out));
+    format_money(val, curbuf, out, sizeof(out));
     g_object_set(renderer, "text", out, NULL);
 }
 
 static void budget_amount_cell_data_func(GtkTreeViewColumn *col, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data) {
     (void)col; (void)user_data;
-    double val = 0.0;
+    gint64 val = 0;
     int col_idx = GPOINTER_TO_INT(user_data);
     gtk_tree_model_get(model, iter, col_idx, &val, -1);
     char curbuf[32] = "$";
     char out[64];
     if (get_setting("currency", curbuf, sizeof(curbuf)) != 0) strncpy(curbuf, "$", sizeof(curbuf));
-    format_amount_currency(val, curbuf, out, sizeof(out));
+    format_money(val, curbuf, out, sizeof(out));
     g_object_set(renderer, "text", out, NULL);
 }
 
+/* Amount typed into an entry; blank or malformed input counts as zero. */
+static Money entry_money(GtkWidget *entry)
+{
+    Money m = 0;
+    if (money_parse(gtk_entry_get_text(GTK_ENTRY(entry)), &m) != 0) m = 0;
+    return m;
+}
+
 static void progress_cell_func(GtkTreeViewColumn *col, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data) {
     (void)col; (void)user_data;
     int val = 0; char buf[32];
@@ -84,9 +105,250 @@ static void progress_cell_func(GtkTreeViewColumn *col, GtkCellRenderer *renderer
 }
 
 
-static void on_export_csv(GtkButton *b, gpointer data) { 
-    (void)b; (void)data; 
-    export_to_csv("transactions.csv"); 
+static void add_export_filter(GtkFileChooser *chooser, const char *name, const char *pattern)
+{
+    GtkFileFilter *filter = gtk_file_filter_new();
+    gtk_file_filter_set_name(filter, name);
+    gtk_file_filter_add_pattern(filter, pattern);
+    gtk_file_chooser_add_filter(chooser, filter);
+}
+
+/* An export runs on a GTask worker with a pooled reader, so a large one never
+ * blocks the main loop; progress and the result come back through it. */
+typedef struct ExportTask {
+    gint refs;                 /* the main loop's, plus one per queued progress update */
+    AppWidgets *app;
+    char *path;
+    ExportFormat format;
+    TxQuery query;
+    char category[CATEGORY_LEN];
+    long total;                /* rows expected, -1 if unknown; set before the first progress */
+    gint rows;                 /* rows written so far */
+    gint progress_queued;
+    gint cancelled;
+    GMutex lock;               /* guards finished */
+    GCond done;
+    gboolean finished;
+    int rc;
+    ExportStats stats;
+} ExportTask;
+
+static void export_task_unref(ExportTask *t)
+{
+    if (!g_atomic_int_dec_and_test(&t->refs)) return;
+    g_mutex_clear(&t->lock);
+    g_cond_clear(&t->done);
+    g_free(t->path);
+    g_free(t);
+}
+
+static void show_export_progress(void *arg)
+{
+    ExportTask *t = (ExportTask*)arg;
+    g_atomic_int_set(&t->progress_queued, 0);
+    if (t->app->export_task == t) {
+        GtkProgressBar *bar = GTK_PROGRESS_BAR(t->app->transfer_progress);
+        long rows = g_atomic_int_get(&t->rows);
+        char text[64];
+        if (t->total > 0) {
+            snprintf(text, sizeof(text), "Exported %ld of %ld", rows, t->total);
+            gtk_progress_bar_set_fraction(bar, MIN(1.0, (double)rows / t->total));
+        } else {
+            snprintf(text, sizeof(text), "Exported %ld", rows);
+            gtk_progress_bar_pulse(bar);
+        }
+        gtk_progress_bar_set_text(bar, text);
+    }
+    export_task_unref(t);
+}
+
+/* Export thread: at most one update waits for the main loop at a time */
+static int on_export_progress(long rows_written, void *user_data)
+{
+    ExportTask *t = (ExportTask*)user_data;
+    g_atomic_int_set(&t->rows, (gint)rows_written);
+    if (g_atomic_int_compare_and_exchange(&t->progress_queued, 0, 1)) {
+        g_atomic_int_inc(&t->refs);
+        dispatch_to_main(show_export_progress, t);
+    }
+    return g_atomic_int_get(&t->cancelled);
+}
+
+static void export_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancel)
+{
+    (void)source; (void)cancel;
+    ExportTask *t = (ExportTask*)task_data;
+    int rc = -1;
+    if (db_reader_acquire() == 0) {
+        /* one read transaction, so the count and the rows see the same snapshot */
+        if (db_begin_transaction() == 0) {
+            t->total = count_transactions(&t->query);
+            rc = export_transactions(t->path, t->format, &t->query, on_export_progress, t, &t->stats);
+            db_commit_transaction();
+        }
+        db_reader_release();
+    }
+    if (g_atomic_int_get(&t->cancelled)) remove(t->path);  /* do not leave half a file behind */
+    t->rc = rc;
+    g_mutex_lock(&t->lock);
+    t->finished = TRUE;
+    g_cond_signal(&t->done);
+    g_mutex_unlock(&t->lock);
+    g_task_return_int(task, rc);
+}
+
+static void on_export_done(GObject *source, GAsyncResult *res, gpointer data)
+{
+    (void)source; (void)res;
+    ExportTask *t = (ExportTask*)data;
+    AppWidgets *app = t->app;
+    if (app->export_task == t) {
+        app->export_task = NULL;
+        gtk_widget_hide(app->transfer_progress);
+        gtk_widget_set_sensitive(app->export_button, TRUE);
+        const ExportStats *st = &t->stats;
+        GtkWidget *d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL,
+            t->rc == 0 ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
+            "%s: %ld rows, %.1f MB (%.0f rows/s, %.1f MB/s)",
+            t->rc == 0 ? "Export finished" : "Export failed", st->rows_written,
+            st->bytes_written / (1024.0 * 1024.0), st->rows_per_sec, st->mb_per_sec);
+        gtk_dialog_run(GTK_DIALOG(d));
+        gtk_widget_destroy(d);
+    }
+    export_task_unref(t);
+}
+
+static void on_export(GtkButton *b, gpointer data)
+{
+    (void)b;
+    AppWidgets *app = (AppWidgets*)data;
+    GtkWidget *chooser = gtk_file_chooser_dialog_new("Export Transactions", GTK_WINDOW(app->window), GTK_FILE_CHOOSER_ACTION_SAVE,
+        "Cancel", GTK_RESPONSE_CANCEL, "Export", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(chooser), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(chooser), "transactions.csv");
+    add_export_filter(GTK_FILE_CHOOSER(chooser), "CSV (*.csv)", "*.csv");
+    add_export_filter(GTK_FILE_CHOOSER(chooser), "JSON Lines (*.jsonl)", "*.jsonl");
+    add_export_filter(GTK_FILE_CHOOSER(chooser), "Binary ledger (*.fmlb)", "*.fmlb");
+
+    /* optional filters; the format follows the file extension */
+    GtkWidget *grid = gtk_grid_new(); gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
+    GtkWidget *from = gtk_entry_new(); gtk_entry_set_placeholder_text(GTK_ENTRY(from), "YYYY-MM-DD");
+    GtkWidget *to = gtk_entry_new(); gtk_entry_set_placeholder_text(GTK_ENTRY(to), "YYYY-MM-DD");
+    GtkWidget *cat = gtk_entry_new(); gtk_entry_set_placeholder_text(GTK_ENTRY(cat), "All categories");
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("From"), 0,0,1,1); gtk_grid_attach(GTK_GRID(grid), from, 1,0,1,1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("To"), 2,0,1,1); gtk_grid_attach(GTK_GRID(grid), to, 3,0,1,1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Category"), 4,0,1,1); gtk_grid_attach(GTK_GRID(grid), cat, 5,0,1,1);
+    gtk_widget_show_all(grid);
+    gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(chooser), grid);
+
+    ExportTask *t = NULL;
+    if (gtk_dialog_run(GTK_DIALOG(chooser)) == GTK_RESPONSE_ACCEPT) {
+        t = g_new0(ExportTask, 1);
+        t->path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+        t->query.day_from = day_key_from_date(gtk_entry_get_text(GTK_ENTRY(from)));
+        t->query.day_to = day_key_from_date(gtk_entry_get_text(GTK_ENTRY(to)));
+        snprintf(t->category, sizeof(t->category), "%s", gtk_entry_get_text(GTK_ENTRY(cat)));
+        if (t->category[0]) t->query.category = t->category;
+    }
+    gtk_widget_destroy(chooser);
+    if (!t) return;
+
+    t->refs = 1;
+    t->app = app;
+    t->format = export_format_from_path(t->path);
+    t->total = -1;
+    g_mutex_init(&t->lock);
+    g_cond_init(&t->done);
+    app->export_task = t;
+    gtk_widget_set_sensitive(app->export_button, FALSE);
+    GtkProgressBar *bar = GTK_PROGRESS_BAR(app->transfer_progress);
+    gtk_progress_bar_set_fraction(bar, 0.0);
+    gtk_progress_bar_set_text(bar, "Exporting...");
+    gtk_widget_show(app->transfer_progress);
+
+    GTask *task = g_task_new(NULL, NULL, on_export_done, t);
+    g_task_set_task_data(task, t, NULL);
+    g_task_run_in_thread(task, export_worker);
+    g_object_unref(task);
+}
+
+/* Window teardown: stop the export and wait until it gives its reader back */
+static void cancel_export(AppWidgets *app)
+{
+    ExportTask *t = app->export_task;
+    if (!t) return;
+    app->export_task = NULL;  /* on_export_done only frees it now */
+    g_atomic_int_set(&t->cancelled, 1);
+    g_mutex_lock(&t->lock);
+    while (!t->finished) g_cond_wait(&t->done, &t->lock);
+    g_mutex_unlock(&t->lock);
+}
+
+typedef struct { char text[512]; int shown; } ImportErrors;
+
+static void collect_import_error(long line, const char *message, void *user_data)
+{
+    ImportErrors *e = (ImportErrors*)user_data;
+    if (e->shown >= 5) return; /* only the first few go into the summary */
+    size_t used = strlen(e->text);
+    snprintf(e->text + used, sizeof(e->text) - used, "\nline %ld: %s", line, message);
+    e->shown++;
+}
+
+/* An import runs on the write queue's writer thread, which it holds for its bulk
+ * transactions; rejected rows and the summary come back with the completion. */
+typedef struct {
+    AppWidgets *app;
+    char *path;
+    ImportErrors errors;
+    ImportStats stats;
+} ImportTask;
+
+static int run_import(void *arg)
+{
+    ImportTask *t = (ImportTask*)arg;
+    return import_csv(t->path, collect_import_error, &t->errors, &t->stats);
+}
+
+static void on_import_done(int rc, void *user_data)
+{
+    ImportTask *t = (ImportTask*)user_data;
+    AppWidgets *app = t->app;
+    gtk_widget_set_sensitive(app->import_button, TRUE);
+    const ImportStats *st = &t->stats;
+    GtkWidget *d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL,
+        rc == 0 ? (st->rows_failed ? GTK_MESSAGE_WARNING : GTK_MESSAGE_INFO) : GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
+        "%s: %ld imported, %ld rejected (%.0f rows/s)%s",
+        rc == 0 ? "Import finished" : "Import failed", st->rows_imported, st->rows_failed, st->rows_per_sec, t->errors.text);
+    g_free(t->path);
+    g_free(t);
+    gtk_dialog_run(GTK_DIALOG(d));
+    gtk_widget_destroy(d);
+}
+
+static void on_import_csv(GtkButton *b, gpointer data)
+{
+    (void)b;
+    AppWidgets *app = (AppWidgets*)data;
+    GtkWidget *chooser = gtk_file_chooser_dialog_new("Import CSV", GTK_WINDOW(app->window), GTK_FILE_CHOOSER_ACTION_OPEN,
+        "Cancel", GTK_RESPONSE_CANCEL, "Import", GTK_RESPONSE_ACCEPT, NULL);
+    char *filename = NULL;
+    if (gtk_dialog_run(GTK_DIALOG(chooser)) == GTK_RESPONSE_ACCEPT)
+        filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+    gtk_widget_destroy(chooser);
+    if (!filename) return;
+
+    ImportTask *t = g_new0(ImportTask, 1);
+    t->app = app;
+    t->path = filename;
+    /* the new rows arrive as change events once each chunk commits */
+    gtk_widget_set_sensitive(app->import_button, FALSE);
+    if (write_queue_run(run_import, t, on_import_done, t) != 0) {
+        gtk_widget_set_sensitive(app->import_button, TRUE);
+        g_free(t->path);
+        g_free(t);
+        g_warning("cannot queue the import");
+    }
 }
 
 
@@ -113,6 +375,32 @@ static void show_toast(AppWidgets *app, const char *msg, int ms)
     g_timeout_add(ms > 0 ? ms : 1500, _toast_destroy_cb, popup);
 }
 
+/* Write-queue completions arrive here through the main loop. */
+typedef struct { void (*fn)(void *); void *arg; } MainCall;
+
+static gboolean run_main_call(gpointer data)
+{
+    MainCall *call = (MainCall*)data;
+    call->fn(call->arg);
+    g_free(call);
+    return G_SOURCE_REMOVE;
+}
+
+static void dispatch_to_main(void (*fn)(void *), void *arg)
+{
+    MainCall *call = g_new(MainCall, 1);
+    call->fn = fn;
+    call->arg = arg;
+    g_idle_add(run_main_call, call);
+}
+
+/* The views follow the change events of the commit (apply_change) */
+static void on_transaction_written(int rc, void *data)
+{
+    AppWidgets *app = (AppWidgets*)data;
+    if (rc != 0) show_toast(app, "Could not save the transaction", 2000);
+}
+
 static void on_add_transaction(GtkButton *btn, gpointer data){
     (void)btn; 
     AppWidgets *app = (AppWidgets*)data;
@@ -138,12 +426,10 @@ static void on_add_transaction(GtkButton *btn, gpointer data){
         Transaction t = {0};
         snprintf(t.type, TYPE_LEN, "%s", gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(type)));
         snprintf(t.category, CATEGORY_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(cat)));
-        t.amount = atof(gtk_entry_get_text(GTK_ENTRY(amt)));
+        t.amount = entry_money(amt);
         snprintf(t.date, DATE_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(date)));
         snprintf(t.note, NOTE_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(note)));
-        add_transaction(&t);
-        refresh_transactions(app);
-        refresh_budgets(app); /* Update budget spent amounts */
+        write_queue_add_transaction(&t, on_transaction_written, app);
     }
     gtk_widget_destroy(d);
 }
@@ -155,9 +441,7 @@ static void on_delete_transaction(GtkButton *btn, gpointer data){
     GtkTreeIter it; GtkTreeModel *m; 
     if (gtk_tree_selection_get_selected(sel, &m, &it)) { 
         int id; gtk_tree_model_get(m, &it, COL_T_ID, &id, -1); 
-        delete_transaction(id); 
-        refresh_transactions(app);
-        refresh_budgets(app); /* Update budget spent amounts */
+        write_queue_delete_transaction(id, on_transaction_written, app);
     } 
 }
 
@@ -168,14 +452,14 @@ static void on_edit_transaction(GtkButton *btn, gpointer data){
     GtkTreeIter it; GtkTreeModel *m; 
     if (!gtk_tree_selection_get_selected(sel, &m, &it)) return; 
     Transaction t = {0};
-    int id; char *type=NULL, *cat=NULL, *date=NULL, *note=NULL; double amount=0.0;
+    int id; char *type=NULL, *cat=NULL, *date=NULL, *note=NULL; gint64 amount=0;
     gtk_tree_model_get(m, &it, COL_T_ID, &id, COL_T_TYPE, &type, COL_T_CATEGORY, &cat, COL_T_AMOUNT, &amount, COL_T_DATE, &date, COL_T_NOTE, &note, -1);
     t.id = id; snprintf(t.type, TYPE_LEN, "%s", type?type:""); snprintf(t.category, CATEGORY_LEN, "%s", cat?cat:""); t.amount = amount; snprintf(t.date, DATE_LEN, "%s", date?date:""); snprintf(t.note, NOTE_LEN, "%s", note?note:"");
     GtkWidget *d = gtk_dialog_new_with_buttons("Edit Transaction", GTK_WINDOW(app->window), GTK_DIALOG_MODAL, "Cancel", GTK_RESPONSE_CANCEL, "Save", GTK_RESPONSE_ACCEPT, NULL);
     GtkWidget *c = gtk_dialog_get_content_area(GTK_DIALOG(d)); GtkWidget *grid = gtk_grid_new(); gtk_grid_set_row_spacing(GTK_GRID(grid), 6); gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
     GtkWidget *typew = gtk_combo_box_text_new(); gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(typew), "income"); gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(typew), "expense"); int active = strcmp(t.type, "income")==0?0:1; gtk_combo_box_set_active(GTK_COMBO_BOX(typew), active);
     GtkWidget *catw = gtk_entry_new(); gtk_entry_set_text(GTK_ENTRY(catw), t.category);
-    GtkWidget *amtw = gtk_entry_new(); char buf[64]; snprintf(buf, sizeof(buf), "%.2f", t.amount); gtk_entry_set_text(GTK_ENTRY(amtw), buf);
+    GtkWidget *amtw = gtk_entry_new(); char buf[64]; money_to_string(t.amount, buf, sizeof(buf)); gtk_entry_set_text(GTK_ENTRY(amtw), buf);
     GtkWidget *datew = gtk_entry_new(); gtk_entry_set_text(GTK_ENTRY(datew), t.date);
     GtkWidget *notew = gtk_entry_new(); gtk_entry_set_text(GTK_ENTRY(notew), t.note);
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Type"), 0,0,1,1); gtk_grid_attach(GTK_GRID(grid), typew, 1,0,1,1);
@@ -187,12 +471,10 @@ static void on_edit_transaction(GtkButton *btn, gpointer data){
     if (gtk_dialog_run(GTK_DIALOG(d)) == GTK_RESPONSE_ACCEPT) {
         snprintf(t.type, TYPE_LEN, "%s", gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(typew)));
         snprintf(t.category, CATEGORY_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(catw)));
-        t.amount = atof(gtk_entry_get_text(GTK_ENTRY(amtw)));
+        t.amount = entry_money(amtw);
         snprintf(t.date, DATE_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(datew)));
         snprintf(t.note, NOTE_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(notew)));
-        edit_transaction(&t); 
-        refresh_transactions(app);
-        refresh_budgets(app); /* Update budget spent amounts */
+        write_queue_edit_transaction(&t, on_transaction_written, app);
     }
     gtk_widget_destroy(d);
     g_free(type); g_free(cat); g_free(date); g_free(note);
@@ -208,7 +490,7 @@ static void on_add_budget(GtkButton *btn, gpointer data){
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Monthly Limit"), 0,1,1,1); gtk_grid_attach(GTK_GRID(grid), limit, 1,1,1,1);
     gtk_container_add(GTK_CONTAINER(c), grid); gtk_widget_show_all(d);
     if (gtk_dialog_run(GTK_DIALOG(d)) == GTK_RESPONSE_ACCEPT) {
-        Budget b = {0}; snprintf(b.category, CATEGORY_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(cat))); b.monthly_limit = atof(gtk_entry_get_text(GTK_ENTRY(limit))); add_or_update_budget(&b); refresh_budgets(app);
+        Budget b = {0}; snprintf(b.category, CATEGORY_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(cat))); b.monthly_limit = entry_money(limit); add_or_update_budget(&b);
     }
     gtk_widget_destroy(d);
 }
@@ -225,7 +507,7 @@ static void on_add_goal(GtkButton *btn, gpointer data){
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Start Date"), 0,3,1,1); gtk_grid_attach(GTK_GRID(grid), start, 1,3,1,1);
     gtk_container_add(GTK_CONTAINER(c), grid); gtk_widget_show_all(d);
     if (gtk_dialog_run(GTK_DIALOG(d)) == GTK_RESPONSE_ACCEPT) {
-        Goal g = {0}; snprintf(g.name, NAME_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(name))); g.target_amount = atof(gtk_entry_get_text(GTK_ENTRY(target))); g.monthly_saving = atof(gtk_entry_get_text(GTK_ENTRY(monthly))); snprintf(g.start_date, DATE_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(start))); add_goal(&g); refresh_goals(app);
+        Goal g = {0}; snprintf(g.name, NAME_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(name))); g.target_amount = entry_money(target); g.monthly_saving = entry_money(monthly); snprintf(g.start_date, DATE_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(start))); add_goal(&g);
     }
     gtk_widget_destroy(d);
 }
@@ -237,14 +519,14 @@ static void on_edit_goal(GtkButton *btn, gpointer data){
     GtkTreeIter it; GtkTreeModel *m; 
     if (!gtk_tree_selection_get_selected(sel, &m, &it)) return; 
     Goal g = {0}; 
-    int id; char *name=NULL, *start=NULL; double target=0.0, monthly=0.0;
+    int id; char *name=NULL, *start=NULL; gint64 target=0, monthly=0;
     gtk_tree_model_get(m, &it, COL_G_ID, &id, COL_G_NAME, &name, COL_G_TARGET, &target, COL_G_MONTHLY, &monthly, COL_G_START, &start, -1);
     g.id = id; snprintf(g.name, NAME_LEN, "%s", name?name:""); g.target_amount = target; g.monthly_saving = monthly; snprintf(g.start_date, DATE_LEN, "%s", start?start:"");
     GtkWidget *d = gtk_dialog_new_with_buttons("Edit Goal", GTK_WINDOW(app->window), GTK_DIALOG_MODAL, "Cancel", GTK_RESPONSE_CANCEL, "Save", GTK_RESPONSE_ACCEPT, NULL);
     GtkWidget *c = gtk_dialog_get_content_area(GTK_DIALOG(d)); GtkWidget *grid = gtk_grid_new(); gtk_grid_set_row_spacing(GTK_GRID(grid), 6); gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
     GtkWidget *namew = gtk_entry_new(); gtk_entry_set_text(GTK_ENTRY(namew), g.name);
-    GtkWidget *targetw = gtk_entry_new(); char bt[64]; snprintf(bt, sizeof(bt), "%.2f", g.target_amount); gtk_entry_set_text(GTK_ENTRY(targetw), bt);
-    GtkWidget *monthlyw = gtk_entry_new(); char bm[64]; snprintf(bm, sizeof(bm), "%.2f", g.monthly_saving); gtk_entry_set_text(GTK_ENTRY(monthlyw), bm);
+    GtkWidget *targetw = gtk_entry_new(); char bt[64]; money_to_string(g.target_amount, bt, sizeof(bt)); gtk_entry_set_text(GTK_ENTRY(targetw), bt);
+    GtkWidget *monthlyw = gtk_entry_new(); char bm[64]; money_to_string(g.monthly_saving, bm, sizeof(bm)); gtk_entry_set_text(GTK_ENTRY(monthlyw), bm);
     GtkWidget *startw = gtk_entry_new(); gtk_entry_set_text(GTK_ENTRY(startw), g.start_date);
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Name"), 0,0,1,1); gtk_grid_attach(GTK_GRID(grid), namew, 1,0,1,1);
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Target Amount"), 0,1,1,1); gtk_grid_attach(GTK_GRID(grid), targetw, 1,1,1,1);
@@ -252,7 +534,7 @@ static void on_edit_goal(GtkButton *btn, gpointer data){
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Start Date"), 0,3,1,1); gtk_grid_attach(GTK_GRID(grid), startw, 1,3,1,1);
     gtk_container_add(GTK_CONTAINER(c), grid); gtk_widget_show_all(d);
     if (gtk_dialog_run(GTK_DIALOG(d)) == GTK_RESPONSE_ACCEPT) {
-        snprintf(g.name, NAME_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(namew))); g.target_amount = atof(gtk_entry_get_text(GTK_ENTRY(targetw))); g.monthly_saving = atof(gtk_entry_get_text(GTK_ENTRY(monthlyw))); snprintf(g.start_date, DATE_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(startw))); edit_goal(&g); refresh_goals(app);
+        snprintf(g.name, NAME_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(namew))); g.target_amount = entry_money(targetw); g.monthly_saving = entry_money(monthlyw); snprintf(g.start_date, DATE_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(startw))); edit_goal(&g);
     }
     gtk_widget_destroy(d);
     g_free(name); g_free(start);
@@ -266,7 +548,6 @@ static void on_delete_goal(GtkButton *btn, gpointer data){
     if (gtk_tree_selection_get_selected(sel, &m, &it)) { 
         int id; gtk_tree_model_get(m, &it, COL_G_ID, &id, -1); 
         delete_goal(id); 
-        refresh_goals(app);
     } 
 }
 
@@ -295,78 +576,396 @@ static void refresh_dashboard(AppWidgets *app) {
     update_reports(app);
 }
 
-static void refresh_transactions(AppWidgets *app)
+static void set_transaction_row(GtkListStore *store, GtkTreeIter *it, const Transaction *t, const char *note_markup)
 {
-    gtk_list_store_clear(app->transactions_store);
-    Transaction *list = NULL; int count = 0;
-    if (fetch_transactions_all(&list, &count) == 0) {
-        for (int i = 0; i < count; ++i) {
-            GtkTreeIter it;
-            gtk_list_store_append(app->transactions_store, &it);
-            gtk_list_store_set(app->transactions_store, &it,
-                COL_T_ID, list[i].id,
-                COL_T_TYPE, list[i].type,
-                COL_T_CATEGORY, list[i].category,
-                COL_T_AMOUNT, list[i].amount,
-                COL_T_DATE, list[i].date,
-                COL_T_NOTE, list[i].note,
-                -1);
+    gtk_list_store_set(store, it,
+        COL_T_ID, t->id,
+        COL_T_TYPE, t->type,
+        COL_T_CATEGORY, t->category,
+        COL_T_AMOUNT, t->amount,
+        COL_T_DATE, t->date,
+        COL_T_NOTE, t->note,
+        COL_T_NOTE_MARKUP, note_markup,
+        -1);
+}
+
+/* Escape a search snippet for Pango, turning its match markers into bold. */
+static gchar *snippet_markup(const char *snippet)
+{
+    GString *out = g_string_new(NULL);
+    const char *p = snippet;
+    while (*p) {
+        size_t len = strcspn(p, SEARCH_MARK_OPEN SEARCH_MARK_CLOSE);
+        gchar *esc = g_markup_escape_text(p, (gssize)len);
+        g_string_append(out, esc);
+        g_free(esc);
+        p += len;
+        if (*p) g_string_append(out, *p++ == SEARCH_MARK_OPEN[0] ? "<b>" : "</b>");
+    }
+    return g_string_free(out, FALSE);
+}
+
+#define TX_SEARCH_LIMIT 500
+#define TX_RELOAD_SIGNAL_ROWS 1000  /* row count change a view is told about row by row */
+
+static void on_transactions_batch(const TxLoaderBatch *batch, void *data)
+{
+    AppWidgets *app = (AppWidgets*)data;
+    for (int i = 0; i < batch->count; ++i) {
+        gchar *markup = snippet_markup(batch->snippets[i]);
+        GtkTreeIter it;
+        gtk_list_store_append(app->transactions_store, &it);
+        set_transaction_row(app->transactions_store, &it, &batch->rows[i], markup);
+        g_free(markup);
+    }
+    GtkProgressBar *bar = GTK_PROGRESS_BAR(app->transactions_progress);
+    char text[64];
+    if (batch->total > 0) {
+        snprintf(text, sizeof(text), "Loading %ld of %ld", batch->loaded, batch->total);
+        gtk_progress_bar_set_fraction(bar, MIN(1.0, (double)batch->loaded / batch->total));
+    } else {
+        snprintf(text, sizeof(text), "Loading %ld", batch->loaded);
+        gtk_progress_bar_pulse(bar);
+    }
+    gtk_progress_bar_set_text(bar, text);
+}
+
+static void on_transactions_loaded(int rc, void *data)
+{
+    AppWidgets *app = (AppWidgets*)data;
+    app->tx_loader = NULL;
+    if (rc == 0) {
+        gtk_widget_hide(app->transactions_progress);
+        return;
+    }
+    /* no retry on the main thread: the next edit of the search box starts a new load */
+    g_warning("transaction search failed");
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(app->transactions_progress), 0.0);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(app->transactions_progress), "Search failed");
+}
+
+/* Show every transaction through the paged model, or the ranked matches for the
+ * search box, which the loader fetches in the background into the list store.
+ * A newer reload abandons a search still loading. */
+static void fill_transactions(AppWidgets *app)
+{
+    tx_loader_cancel(app->tx_loader);
+    app->tx_loader = NULL;
+    GtkTreeView *view = GTK_TREE_VIEW(app->transactions_view);
+    GtkTreeModel *all = GTK_TREE_MODEL(app->transactions_model);
+    const char *query = gtk_entry_get_text(GTK_ENTRY(app->transactions_search));
+    if (!query[0]) {
+        gtk_widget_hide(app->transactions_progress);
+        gtk_list_store_clear(app->transactions_store);
+        long rows = tx_model_count(app->transactions_model);  /* on failure the model stays as it was */
+        if (gtk_tree_view_get_model(view) == all &&
+            (rows < 0 || labs(rows - gtk_tree_model_iter_n_children(all, NULL)) <= TX_RELOAD_SIGNAL_ROWS)) {
+            tx_model_reload_rows(app->transactions_model, rows);  /* keeps the scroll position */
+            return;
         }
-        free(list);
+        /* detached, the model takes the count without a signal per row; the view reads it on attach */
+        gtk_tree_view_set_model(view, NULL);
+        tx_model_reload_rows(app->transactions_model, rows);
+        gtk_tree_view_set_model(view, all);
+        return;
     }
+    if (gtk_tree_view_get_model(view) != GTK_TREE_MODEL(app->transactions_store))
+        gtk_tree_view_set_model(view, GTK_TREE_MODEL(app->transactions_store));
+    gtk_list_store_clear(app->transactions_store);
+    app->tx_loader = tx_loader_start(query, TX_SEARCH_LIMIT, on_transactions_batch, on_transactions_loaded, app);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(app->transactions_progress), 0.0);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(app->transactions_progress), "Searching...");
+    gtk_widget_show(app->transactions_progress);
+}
+
+/* Header click: the column's first order, then the reverse on each further click.
+ * Search results keep their ranking; the order applies once the search is cleared. */
+static void sort_transactions_by(AppWidgets *app, GtkTreeViewColumn *col, TxOrder first, TxOrder second)
+{
+    app->transactions_order = app->transactions_order == first ? second : first;
+    GList *cols = gtk_tree_view_get_columns(GTK_TREE_VIEW(app->transactions_view));
+    for (GList *l = cols; l; l = l->next) gtk_tree_view_column_set_sort_indicator(GTK_TREE_VIEW_COLUMN(l->data), l->data == col);
+    g_list_free(cols);
+    gtk_tree_view_column_set_sort_order(col, app->transactions_order == first ? GTK_SORT_DESCENDING : GTK_SORT_ASCENDING);
+
+    TxQuery q = { .order = app->transactions_order };
+    tx_model_set_query(app->transactions_model, &q);
+    fill_transactions(app);
+    gtk_tree_view_scroll_to_point(GTK_TREE_VIEW(app->transactions_view), -1, 0);
+}
+
+static void on_sort_by_date(GtkTreeViewColumn *col, gpointer data)
+{
+    sort_transactions_by((AppWidgets*)data, col, TX_ORDER_NEWEST, TX_ORDER_OLDEST);
+}
+
+static void on_sort_by_amount(GtkTreeViewColumn *col, gpointer data)
+{
+    sort_transactions_by((AppWidgets*)data, col, TX_ORDER_LARGEST, TX_ORDER_SMALLEST);
+}
+
+static void on_transactions_search_changed(GtkSearchEntry *entry, gpointer data)
+{
+    (void)entry;
+    fill_transactions((AppWidgets*)data);
+}
+
+static void refresh_transactions(AppWidgets *app)
+{
+    if (app->transactions_store) fill_transactions(app);
     /* Refresh dashboard after transaction changes */
     refresh_dashboard(app);
 }
 
+static int budget_progress(Money limit, Money spent)
+{
+    double progress = limit > 0 ? (double)spent / (double)limit : 0.0;
+    return (int)(progress * 100.0);
+}
+
+static void set_budget_row(GtkListStore *store, GtkTreeIter *it, const Budget *b, Money spent)
+{
+    gtk_list_store_set(store, it,
+        COL_B_ID, b->id,
+        COL_B_CATEGORY, b->category,
+        COL_B_LIMIT, b->monthly_limit,
+        COL_B_SPENT, spent,
+        COL_B_PROGRESS, budget_progress(b->monthly_limit, spent),
+        -1);
+}
+
 static void refresh_budgets(AppWidgets *app)
 {
+    if (!app->budgets_store) return;  /* page not built yet; it fills itself when shown */
     gtk_list_store_clear(app->budgets_store);
-    Budget *list = NULL; int count = 0;
+    BudgetStatus *list = NULL; int count = 0;
     char yyyymm[9]; get_current_yyyymm(yyyymm);
-    if (fetch_budgets(&list, &count) == 0) {
+    if (fetch_budget_status(yyyymm, &list, &count) == 0) {
         for (int i = 0; i < count; ++i) {
-            double spent = get_spent_in_category_month(list[i].category, yyyymm);
-            double progress = list[i].monthly_limit > 0.0 ? spent / list[i].monthly_limit : 0.0;
             GtkTreeIter it; gtk_list_store_append(app->budgets_store, &it);
-            gtk_list_store_set(app->budgets_store, &it,
-                COL_B_ID, list[i].id,
-                COL_B_CATEGORY, list[i].category,
-                COL_B_LIMIT, list[i].monthly_limit,
-                COL_B_SPENT, spent,
-                COL_B_PROGRESS, (int)(progress * 100.0),
-                -1);
+            set_budget_row(app->budgets_store, &it, &list[i].budget, list[i].spent);
         }
         free(list);
     }
 }
 
+static void set_goal_row(GtkListStore *store, GtkTreeIter *it, const Goal *g)
+{
+    int months = 0; char proj[DATE_LEN] = "";
+    calculate_goal_projection(g, &months, proj);
+    gtk_list_store_set(store, it,
+        COL_G_ID, g->id,
+        COL_G_NAME, g->name,
+        COL_G_TARGET, g->target_amount,
+        COL_G_MONTHLY, g->monthly_saving,
+        COL_G_START, g->start_date,
+        COL_G_PROJECTION, proj,
+        -1);
+}
+
 static void refresh_goals(AppWidgets *app)
 {
+    if (!app->goals_store) return;
     gtk_list_store_clear(app->goals_store);
     Goal *list = NULL; int count = 0;
     if (fetch_goals(&list, &count) == 0) {
         for (int i = 0; i < count; ++i) {
-            int months = 0; char proj[DATE_LEN] = "";
-            calculate_goal_projection(&list[i], &months, proj);
             GtkTreeIter it; gtk_list_store_append(app->goals_store, &it);
-            gtk_list_store_set(app->goals_store, &it,
-                COL_G_ID, list[i].id,
-                COL_G_NAME, list[i].name,
-                COL_G_TARGET, list[i].target_amount,
-                COL_G_MONTHLY, list[i].monthly_saving,
-                COL_G_START, list[i].start_date,
-                COL_G_PROJECTION, proj,
-                -1);
+            set_goal_row(app->goals_store, &it, &list[i]);
         }
         free(list);
     }
 }
 
+/* Change events (events.h): each committed row change is patched into the views
+ * that show it; what cannot be patched is reloaded once per main loop pass. */
+enum { RELOAD_TRANSACTIONS = 1 << 0, RELOAD_BUDGETS = 1 << 1, RELOAD_GOALS = 1 << 2, RELOAD_REPORTS = 1 << 3 };
+
+static gboolean run_pending_reloads(gpointer data)
+{
+    AppWidgets *app = (AppWidgets*)data;
+    unsigned what = app->pending_reloads;
+    app->pending_reloads = 0;
+    app->reload_source = 0;
+    if ((what & RELOAD_TRANSACTIONS) && app->transactions_store) fill_transactions(app);
+    if (what & RELOAD_BUDGETS) refresh_budgets(app);
+    if (what & RELOAD_GOALS) refresh_goals(app);
+    if (what & RELOAD_REPORTS) refresh_dashboard(app);
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_reload(AppWidgets *app, unsigned what)
+{
+    app->pending_reloads |= what;
+    if (!app->reload_source) app->reload_source = g_idle_add(run_pending_reloads, app);
+}
+
+static gboolean find_row_by_id(GtkListStore *store, int column, int id, GtkTreeIter *out)
+{
+    GtkTreeModel *m = GTK_TREE_MODEL(store);
+    for (gboolean ok = gtk_tree_model_get_iter_first(m, out); ok; ok = gtk_tree_model_iter_next(m, out)) {
+        int row_id = 0;
+        gtk_tree_model_get(m, out, column, &row_id, -1);
+        if (row_id == id) return TRUE;
+    }
+    return FALSE;
+}
+
+/* The reports and chart show one month's totals */
+static gboolean in_report_month(AppWidgets *app, const char *date)
+{
+    char month[9], shown[9];
+    if (yyyymm_from_date(date, month) != 0) return FALSE;
+    if (app->chart_month_entry) snprintf(shown, sizeof(shown), "%s", gtk_entry_get_text(GTK_ENTRY(app->chart_month_entry)));
+    else get_current_yyyymm(shown);
+    return strcmp(month, shown) == 0;
+}
+
+/* Budgets show this month's expenses per category: add or take back t's amount */
+static void patch_budget_spent(AppWidgets *app, const Transaction *t, int sign)
+{
+    char month[9], current[9];
+    get_current_yyyymm(current);
+    if (!app->budgets_store || strcmp(t->type, "expense") != 0 ||
+        yyyymm_from_date(t->date, month) != 0 || strcmp(month, current) != 0) return;
+    GtkTreeModel *m = GTK_TREE_MODEL(app->budgets_store);
+    GtkTreeIter it;
+    for (gboolean ok = gtk_tree_model_get_iter_first(m, &it); ok; ok = gtk_tree_model_iter_next(m, &it)) {
+        char *category = NULL; gint64 limit = 0, spent = 0;
+        gtk_tree_model_get(m, &it, COL_B_CATEGORY, &category, COL_B_LIMIT, &limit, COL_B_SPENT, &spent, -1);
+        gboolean match = category && strcmp(category, t->category) == 0;
+        g_free(category);
+        if (!match) continue;
+        spent += sign * t->amount;
+        gtk_list_store_set(app->budgets_store, &it, COL_B_SPENT, spent, COL_B_PROGRESS, budget_progress(limit, spent), -1);
+        return;
+    }
+}
+
+static void apply_transaction_change(AppWidgets *app, const ChangeEvent *e)
+{
+    const Transaction *before = e->kind != CHANGE_INSERT ? &e->u.tx.before : NULL;
+    const Transaction *after = e->kind != CHANGE_DELETE ? &e->u.tx.after : NULL;
+    if (before) patch_budget_spent(app, before, -1);
+    if (after) patch_budget_spent(app, after, 1);
+    if ((before && in_report_month(app, before->date)) || (after && in_report_month(app, after->date)))
+        schedule_reload(app, RELOAD_REPORTS);
+
+    if (!app->transactions_store) return;  /* page not built yet */
+    GtkTreeModel *shown = gtk_tree_view_get_model(GTK_TREE_VIEW(app->transactions_view));
+    if (shown != GTK_TREE_MODEL(app->transactions_store)) {
+        if (e->kind == CHANGE_UPDATE && tx_model_row_updated(app->transactions_model, before, after) == 0) return;
+        schedule_reload(app, RELOAD_TRANSACTIONS);
+        return;
+    }
+    /* search results: a new row may match, and a search still loading has its own snapshot */
+    GtkTreeIter it;
+    if (!before || app->tx_loader) {
+        schedule_reload(app, RELOAD_TRANSACTIONS);
+    } else if (find_row_by_id(app->transactions_store, COL_T_ID, e->id, &it)) {
+        if (!after) {
+            gtk_list_store_remove(app->transactions_store, &it);
+            return;
+        }
+        gchar *markup = g_markup_escape_text(after->note, -1);
+        set_transaction_row(app->transactions_store, &it, after, markup);
+        g_free(markup);
+    }
+}
+
+/* Budgets are listed by category */
+static void apply_budget_change(AppWidgets *app, const ChangeEvent *e)
+{
+    if (!app->budgets_store) return;
+    GtkListStore *store = app->budgets_store;
+    GtkTreeIter it;
+    gboolean found = find_row_by_id(store, COL_B_ID, e->id, &it);
+    if (e->kind == CHANGE_DELETE) {
+        if (found) gtk_list_store_remove(store, &it);
+        return;
+    }
+    const Budget *b = &e->u.budget;
+    char month[9];
+    get_current_yyyymm(month);
+    Money spent = get_spent_in_category_month(b->category, month);
+    if (found) {
+        char *category = NULL;
+        gtk_tree_model_get(GTK_TREE_MODEL(store), &it, COL_B_CATEGORY, &category, -1);
+        gboolean same = category && strcmp(category, b->category) == 0;
+        g_free(category);
+        if (same) {
+            set_budget_row(store, &it, b, spent);
+            return;
+        }
+        gtk_list_store_remove(store, &it);
+    }
+    GtkTreeIter next;
+    gboolean ok = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &next);
+    for (; ok; ok = gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &next)) {
+        char *category = NULL;
+        gtk_tree_model_get(GTK_TREE_MODEL(store), &next, COL_B_CATEGORY, &category, -1);
+        gboolean after = category && strcmp(category, b->category) > 0;
+        g_free(category);
+        if (after) break;
+    }
+    gtk_list_store_insert_before(store, &it, ok ? &next : NULL);
+    set_budget_row(store, &it, b, spent);
+}
+
+/* Goals are listed newest first */
+static void apply_goal_change(AppWidgets *app, const ChangeEvent *e)
+{
+    if (!app->goals_store) return;
+    GtkTreeIter it;
+    if (e->kind == CHANGE_INSERT) {
+        gtk_list_store_prepend(app->goals_store, &it);
+        set_goal_row(app->goals_store, &it, &e->u.goal);
+    } else if (find_row_by_id(app->goals_store, COL_G_ID, e->id, &it)) {
+        if (e->kind == CHANGE_DELETE) gtk_list_store_remove(app->goals_store, &it);
+        else set_goal_row(app->goals_store, &it, &e->u.goal);
+    }
+}
+
+typedef struct { AppWidgets *app; ChangeEvent event; } ChangeCall;
+
+static void apply_change(void *arg)
+{
+    ChangeCall *call = (ChangeCall*)arg;
+    AppWidgets *app = call->app;
+    const ChangeEvent *e = &call->event;
+    if (e->kind == CHANGE_RESET) {
+        static const unsigned k_reset[CHANGE_TABLE_COUNT] = {
+            [CHANGE_TRANSACTIONS] = RELOAD_TRANSACTIONS | RELOAD_BUDGETS | RELOAD_REPORTS,
+            [CHANGE_BUDGETS] = RELOAD_BUDGETS,
+            [CHANGE_GOALS] = RELOAD_GOALS,
+        };
+        schedule_reload(app, k_reset[e->table]);
+    } else if (e->table == CHANGE_TRANSACTIONS) {
+        apply_transaction_change(app, e);
+    } else if (e->table == CHANGE_BUDGETS) {
+        apply_budget_change(app, e);
+    } else {
+        apply_goal_change(app, e);
+    }
+    g_free(call);
+}
+
+/* Runs on whichever thread committed, e.g. the write queue's writer */
+static void on_change_event(const ChangeEvent *event, void *data)
+{
+    ChangeCall *call = g_new(ChangeCall, 1);
+    call->app = (AppWidgets*)data;
+    call->event = *event;
+    dispatch_to_main(apply_change, call);
+}
+
 static GtkWidget* build_transactions_tab(AppWidgets *app)
 {
+    /* the whole ledger is read page by page as it scrolls into view; the store only holds search results */
+    app->transactions_model = tx_model_new();
     app->transactions_store = gtk_list_store_new(N_COL_T,
-        G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_DOUBLE, G_TYPE_STRING, G_TYPE_STRING);
-    GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(app->transactions_store));
+        G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT64, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+    GtkWidget *view = gtk_tree_view_new();
     app->transactions_view = view;
     GtkCellRenderer *r;
     GtkTreeViewColumn *c;
@@ -376,28 +975,71 @@ static GtkWidget* build_transactions_tab(AppWidgets *app)
     r = gtk_cell_renderer_text_new(); c = gtk_tree_view_column_new_with_attributes("Amount", r, NULL); gtk_tree_view_append_column(GTK_TREE_VIEW(view), c);
     /* use top-level cell data func to show currency prefix and formatting */
     gtk_tree_view_column_set_cell_data_func(c, r, (GtkTreeCellDataFunc)amount_cell_data_func, app, NULL);
+    gtk_tree_view_column_set_clickable(c, TRUE);
+    g_signal_connect(c, "clicked", G_CALLBACK(on_sort_by_amount), app);
     r = gtk_cell_renderer_text_new(); c = gtk_tree_view_column_new_with_attributes("Date", r, "text", COL_T_DATE, NULL); gtk_tree_view_append_column(GTK_TREE_VIEW(view), c);
-    r = gtk_cell_renderer_text_new(); c = gtk_tree_view_column_new_with_attributes("Note", r, "text", COL_T_NOTE, NULL); gtk_tree_view_append_column(GTK_TREE_VIEW(view), c);
+    /* the list starts newest first (TX_ORDER_NEWEST) */
+    gtk_tree_view_column_set_clickable(c, TRUE);
+    gtk_tree_view_column_set_sort_indicator(c, TRUE);
+    gtk_tree_view_column_set_sort_order(c, GTK_SORT_DESCENDING);
+    g_signal_connect(c, "clicked", G_CALLBACK(on_sort_by_date), app);
+    r = gtk_cell_renderer_text_new(); c = gtk_tree_view_column_new_with_attributes("Note", r, "markup", COL_T_NOTE_MARKUP, NULL); gtk_tree_view_append_column(GTK_TREE_VIEW(view), c);
+
+    /* Fixed widths and row height, so the view measures one row rather than reading every row to size them */
+    static const int widths[] = { 70, 80, 140, 110, 100, 300 };
+    GList *cols = gtk_tree_view_get_columns(GTK_TREE_VIEW(view));
+    int ci = 0;
+    for (GList *l = cols; l; l = l->next, ++ci) {
+        gtk_tree_view_column_set_sizing(GTK_TREE_VIEW_COLUMN(l->data), GTK_TREE_VIEW_COLUMN_FIXED);
+        gtk_tree_view_column_set_fixed_width(GTK_TREE_VIEW_COLUMN(l->data), widths[ci]);
+        gtk_tree_view_column_set_resizable(GTK_TREE_VIEW_COLUMN(l->data), TRUE);
+    }
+    g_list_free(cols);
+    gtk_tree_view_column_set_expand(c, TRUE);
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(view), TRUE);
 
     GtkWidget *add_btn = gtk_button_new_with_label("Add");
     GtkWidget *edit_btn = gtk_button_new_with_label("Edit");
     GtkWidget *del_btn = gtk_button_new_with_label("Delete");
-    GtkWidget *export_btn = gtk_button_new_with_label("Export CSV");
+    GtkWidget *import_btn = gtk_button_new_with_label("Import CSV");
+    app->import_button = import_btn;
+    GtkWidget *export_btn = gtk_button_new_with_label("Export");
+    app->export_button = export_btn;
 
     GtkWidget *btn_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
     gtk_box_pack_start(GTK_BOX(btn_box), add_btn, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(btn_box), edit_btn, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(btn_box), del_btn, FALSE, FALSE, 0);
     gtk_box_pack_end(GTK_BOX(btn_box), export_btn, FALSE, FALSE, 0);
+    gtk_box_pack_end(GTK_BOX(btn_box), import_btn, FALSE, FALSE, 0);
+    /* shown only while an export runs */
+    app->transfer_progress = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(app->transfer_progress), TRUE);
+    gtk_widget_set_no_show_all(app->transfer_progress, TRUE);
+    gtk_box_pack_end(GTK_BOX(btn_box), app->transfer_progress, TRUE, TRUE, 0);
+
+    GtkWidget *search = gtk_search_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(search), "Search category or note");
+    app->transactions_search = search;
+
+    /* shown only while a load is running */
+    GtkWidget *progress = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(progress), TRUE);
+    gtk_widget_set_no_show_all(progress, TRUE);
+    app->transactions_progress = progress;
 
     GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
     GtkWidget *sw = gtk_scrolled_window_new(NULL, NULL);
     gtk_container_add(GTK_CONTAINER(sw), view);
+    gtk_box_pack_start(GTK_BOX(vbox), search, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), progress, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(vbox), sw, TRUE, TRUE, 0);
     gtk_box_pack_start(GTK_BOX(vbox), btn_box, FALSE, FALSE, 0);
 
     /* Handlers */
-    g_signal_connect(export_btn, "clicked", G_CALLBACK(on_export_csv), NULL);
+    g_signal_connect(search, "search-changed", G_CALLBACK(on_transactions_search_changed), app);
+    g_signal_connect(export_btn, "clicked", G_CALLBACK(on_export), app);
+    g_signal_connect(import_btn, "clicked", G_CALLBACK(on_import_csv), app);
     g_signal_connect(add_btn, "clicked", G_CALLBACK(on_add_transaction), app);
     g_signal_connect(del_btn, "clicked", G_CALLBACK(on_delete_transaction), app);
     g_signal_connect(edit_btn, "clicked", G_CALLBACK(on_edit_transaction), app);
@@ -407,7 +1049,7 @@ static GtkWidget* build_transactions_tab(AppWidgets *app)
 
 static GtkWidget* build_budgets_tab(AppWidgets *app)
 {
-    app->budgets_store = gtk_list_store_new(N_COL_B, G_TYPE_INT, G_TYPE_STRING, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_INT);
+    app->budgets_store = gtk_list_store_new(N_COL_B, G_TYPE_INT, G_TYPE_STRING, G_TYPE_INT64, G_TYPE_INT64, G_TYPE_INT);
     GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(app->budgets_store));
     app->budgets_view = view;
     GtkCellRenderer *r; GtkTreeViewColumn *c;
@@ -446,7 +1088,7 @@ static GtkWidget* build_budgets_tab(AppWidgets *app)
 
 static GtkWidget* build_goals_tab(AppWidgets *app)
 {
-    app->goals_store = gtk_list_store_new(N_COL_G, G_TYPE_INT, G_TYPE_STRING, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_STRING, G_TYPE_STRING);
+    app->goals_store = gtk_list_store_new(N_COL_G, G_TYPE_INT, G_TYPE_STRING, G_TYPE_INT64, G_TYPE_INT64, G_TYPE_STRING, G_TYPE_STRING);
     GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(app->goals_store));
     app->goals_view = view;
     GtkCellRenderer *r; GtkTreeViewColumn *c;
@@ -494,23 +1136,27 @@ static void update_reports(AppWidgets *app)
         get_current_yyyymm(month_buf);
         month = month_buf;
     }
-    double income = get_total_income(month);
-    double expense = get_total_expense(month);
-    double balance = income - expense;
+    Money income = get_total_income(month);
+    Money expense = get_total_expense(month);
+    Money balance = income - expense;
     
     char currency[32] = "$";
     if (get_setting("currency", currency, sizeof(currency)) != 0) strncpy(currency, "$", sizeof(currency));
+    char amount[64];
 
-    char *markup = g_markup_printf_escaped("<span font='16' color='#2ecc71'>%s%.2f</span>", currency, income);
+    format_money(income, currency, amount, sizeof(amount));
+    char *markup = g_markup_printf_escaped("<span font='16' color='#2ecc71'>%s</span>", amount);
     gtk_label_set_markup(GTK_LABEL(app->income_label), markup);
     g_free(markup);
 
-    markup = g_markup_printf_escaped("<span font='16' color='#e74c3c'>%s%.2f</span>", currency, expense);
+    format_money(expense, currency, amount, sizeof(amount));
+    markup = g_markup_printf_escaped("<span font='16' color='#e74c3c'>%s</span>", amount);
     gtk_label_set_markup(GTK_LABEL(app->expense_label), markup);
     g_free(markup);
 
     const char *color = balance >= 0 ? "#2ecc71" : "#e74c3c";
-    markup = g_markup_printf_escaped("<span font='16' color='%s'>%s%.2f</span>", color, currency, balance);
+    format_money(balance, currency, amount, sizeof(amount));
+    markup = g_markup_printf_escaped("<span font='16' color='%s'>%s</span>", color, amount);
     gtk_label_set_markup(GTK_LABEL(app->balance_label), markup);
     g_free(markup);
 }
@@ -586,6 +1232,26 @@ static GtkWidget* build_charts_tab(AppWidgets *app)
     return vbox;
 }
 
+typedef struct { AppWidgets *app; char value[64]; } CurrencySave;
+
+static void on_currency_saved(int rc, void *data)
+{
+    CurrencySave *save = (CurrencySave*)data;
+    AppWidgets *app = save->app;
+    if (rc == 0) {
+        /* update current label and refresh dashboard immediately */
+        gtk_label_set_text(GTK_LABEL(app->currency_label), save->value);
+        refresh_dashboard(app);
+        show_toast(app, "Currency saved", 1400);
+    } else {
+        /* show error dialog */
+        GtkWidget *d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK, "Failed to save currency setting (code %d)", rc);
+        gtk_dialog_run(GTK_DIALOG(d));
+        gtk_widget_destroy(d);
+    }
+    g_free(save);
+}
+
 static void on_save_currency(GtkButton *btn, gpointer data)
 {
     (void)btn;
@@ -608,18 +1274,264 @@ static void on_save_currency(GtkButton *btn, gpointer data)
         gtk_dialog_run(GTK_DIALOG(d)); gtk_widget_destroy(d);
         return;
     }
-    int rc = set_setting("currency", valbuf);
+    CurrencySave *save = g_new(CurrencySave, 1);
+    save->app = app;
+    snprintf(save->value, sizeof(save->value), "%s", valbuf);
+    write_queue_set_setting("currency", valbuf, on_currency_saved, save);
+}
+
+static void on_verify_summary(GtkButton *btn, gpointer data)
+{
+    (void)btn;
+    AppWidgets *app = (AppWidgets*)data;
+    int drift = verify_monthly_summary();
+    if (drift == 0) {
+        show_toast(app, "Report totals are consistent", 1400);
+        return;
+    }
+    if (drift < 0) {
+        GtkWidget *d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK, "Could not verify report totals.");
+        gtk_dialog_run(GTK_DIALOG(d)); gtk_widget_destroy(d);
+        return;
+    }
+    GtkWidget *d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL, GTK_MESSAGE_WARNING, GTK_BUTTONS_YES_NO,
+        "%d report total(s) no longer match the transactions. Rebuild them now?", drift);
+    int resp = gtk_dialog_run(GTK_DIALOG(d));
+    gtk_widget_destroy(d);
+    /* the rebuild publishes a reset, which reloads the reports and budgets */
+    if (resp == GTK_RESPONSE_YES && rebuild_monthly_summary() == 0)
+        show_toast(app, "Report totals rebuilt", 1400);
+}
+
+static void on_rename_category(GtkButton *btn, gpointer data)
+{
+    (void)btn;
+    AppWidgets *app = (AppWidgets*)data;
+    GtkWidget *d = gtk_dialog_new_with_buttons("Rename Category", GTK_WINDOW(app->window), GTK_DIALOG_MODAL,
+        "Cancel", GTK_RESPONSE_CANCEL, "Rename", GTK_RESPONSE_ACCEPT, NULL);
+    GtkWidget *c = gtk_dialog_get_content_area(GTK_DIALOG(d));
+    GtkWidget *grid = gtk_grid_new(); gtk_grid_set_row_spacing(GTK_GRID(grid), 6); gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
+    GtkWidget *from = gtk_entry_new(); GtkWidget *to = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(to), "an existing name merges the two");
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Category"), 0,0,1,1); gtk_grid_attach(GTK_GRID(grid), from, 1,0,1,1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("New name"), 0,1,1,1); gtk_grid_attach(GTK_GRID(grid), to, 1,1,1,1);
+    gtk_container_add(GTK_CONTAINER(c), grid);
+    gtk_widget_show_all(d);
+    if (gtk_dialog_run(GTK_DIALOG(d)) == GTK_RESPONSE_ACCEPT) {
+        int rc = rename_category(gtk_entry_get_text(GTK_ENTRY(from)), gtk_entry_get_text(GTK_ENTRY(to)));
+        if (rc == 0) {
+            show_toast(app, "Category renamed", 1400);
+        } else {
+            GtkWidget *m = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
+                rc == 1 ? "No such category." : "Could not rename the category.");
+            gtk_dialog_run(GTK_DIALOG(m)); gtk_widget_destroy(m);
+        }
+    }
+    gtk_widget_destroy(d);
+}
+
+#define BACKUP_PATH "finance.db.bak"
+#define BACKUP_MAX_AGE_S (24 * 60 * 60)  /* automatic backup at startup when the last is older */
+
+/* The bar lives on the Settings page, which may not be built yet; text NULL keeps it */
+static void show_backup_status(AppWidgets *app, const char *text, double fraction)
+{
+    if (!app->backup_progress) return;
+    if (text) gtk_progress_bar_set_text(GTK_PROGRESS_BAR(app->backup_progress), text);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(app->backup_progress), fraction);
+}
+
+/* One batch of pages per idle callback, so redraws and input always get in between. */
+static gboolean on_backup_idle(gpointer data)
+{
+    AppWidgets *app = (AppWidgets*)data;
+    int rc = backup_step(app->backup_job);
+    int done = 0, total = 0;
+    backup_progress(app->backup_job, &done, &total);
+    show_backup_status(app, NULL, total > 0 ? (double)done / total : 0.0);
+    if (rc == 1) return G_SOURCE_CONTINUE;
+
+    rc = backup_finish(app->backup_job);
+    app->backup_job = NULL;
+    app->backup_source = 0;
     if (rc == 0) {
-        /* update current label and refresh dashboard immediately */
-        gtk_label_set_text(GTK_LABEL(app->currency_label), valbuf);
-        refresh_dashboard(app);
-        show_toast(app, "Currency saved", 1400);
-    } else {
-        /* show error dialog */
-        GtkWidget *d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK, "Failed to save currency setting (code %d)", rc);
-        gtk_dialog_run(GTK_DIALOG(d));
-        gtk_widget_destroy(d);
+        char stamp[32];
+        snprintf(stamp, sizeof(stamp), "%lld", (long long)time(NULL));
+        write_queue_set_setting("last_backup", stamp, NULL, NULL);
+    }
+    show_backup_status(app, rc == 0 ? "Backup saved" : "Backup failed", rc == 0 ? 1.0 : 0.0);
+    return G_SOURCE_REMOVE;
+}
+
+static void start_backup(AppWidgets *app)
+{
+    if (app->backup_job) return;
+    app->backup_job = backup_begin(BACKUP_PATH, BACKUP_DEFAULT_GENERATIONS);
+    if (!app->backup_job) {
+        show_backup_status(app, "Backup failed", 0.0);
+        return;
+    }
+    show_backup_status(app, "Backing up...", 0.0);
+    app->backup_source = g_idle_add(on_backup_idle, app);
+}
+
+/* Drop an unfinished backup; its temporary file is removed. */
+static void cancel_backup(AppWidgets *app)
+{
+    if (!app->backup_job) return;
+    g_source_remove(app->backup_source);
+    backup_finish(app->backup_job);
+    app->backup_job = NULL;
+    app->backup_source = 0;
+}
+
+static void on_backup_now(GtkButton *btn, gpointer data)
+{
+    (void)btn;
+    start_backup((AppWidgets*)data);
+}
+
+static void on_restore_backup(GtkButton *btn, gpointer data)
+{
+    (void)btn;
+    AppWidgets *app = (AppWidgets*)data;
+    GtkWidget *chooser = gtk_file_chooser_dialog_new("Restore Backup", GTK_WINDOW(app->window), GTK_FILE_CHOOSER_ACTION_OPEN,
+        "Cancel", GTK_RESPONSE_CANCEL, "Restore", GTK_RESPONSE_ACCEPT, NULL);
+    char *filename = NULL;
+    if (gtk_dialog_run(GTK_DIALOG(chooser)) == GTK_RESPONSE_ACCEPT)
+        filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+    gtk_widget_destroy(chooser);
+    if (!filename) return;
+
+    GtkWidget *d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL, GTK_MESSAGE_WARNING, GTK_BUTTONS_YES_NO,
+        "Replace all current data with this backup?");
+    int resp = gtk_dialog_run(GTK_DIALOG(d));
+    gtk_widget_destroy(d);
+    if (resp != GTK_RESPONSE_YES) { g_free(filename); return; }
+
+    cancel_backup(app);
+    /* queued edits land before the restore, not on top of the restored data */
+    write_queue_pause();
+    int rc = backup_restore(filename);
+    write_queue_resume();
+    g_free(filename);
+    if (rc == 0) {
+        show_toast(app, "Backup restored", 1400);
+        return;
     }
+    d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
+        rc > 0 ? "That file is not a usable backup." : "Restore failed.");
+    gtk_dialog_run(GTK_DIALOG(d)); gtk_widget_destroy(d);
+}
+
+#define DIAGNOSTICS_REFRESH_S 1
+
+static void diagnostics_cell_data_func(GtkTreeViewColumn *col, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data) {
+    (void)col;
+    gdouble v = 0;
+    gtk_tree_model_get(model, iter, GPOINTER_TO_INT(user_data), &v, -1);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.1f", v);
+    g_object_set(renderer, "text", buf, NULL);
+}
+
+static void refresh_diagnostics(AppWidgets *app)
+{
+    ProfileStats *list = NULL;
+    int count = 0;
+    if (profile_snapshot(&list, &count) != 0) return;
+    gtk_list_store_clear(app->diagnostics_store);
+    for (int i = 0; i < count; ++i) {
+        GtkTreeIter it;
+        gtk_list_store_append(app->diagnostics_store, &it);
+        gtk_list_store_set(app->diagnostics_store, &it,
+            COL_D_NAME, list[i].name, COL_D_CALLS, (guint64)list[i].calls, COL_D_ROWS, (guint64)list[i].rows,
+            COL_D_TOTAL, list[i].total_ms, COL_D_MEAN, list[i].mean_us, COL_D_P50, list[i].p50_us,
+            COL_D_P95, list[i].p95_us, COL_D_P99, list[i].p99_us, COL_D_MAX, list[i].max_us, -1);
+    }
+    free(list);
+}
+
+static gboolean on_diagnostics_tick(gpointer data)
+{
+    refresh_diagnostics((AppWidgets*)data);
+    return G_SOURCE_CONTINUE;
+}
+
+/* The table only ticks while it is on screen, so the process sleeps otherwise */
+static void on_diagnostics_map(GtkWidget *w, gpointer data)
+{
+    (void)w;
+    AppWidgets *app = (AppWidgets*)data;
+    refresh_diagnostics(app);
+    if (!app->diagnostics_source)
+        app->diagnostics_source = g_timeout_add_seconds(DIAGNOSTICS_REFRESH_S, on_diagnostics_tick, app);
+}
+
+static void on_diagnostics_unmap(GtkWidget *w, gpointer data)
+{
+    (void)w;
+    AppWidgets *app = (AppWidgets*)data;
+    if (app->diagnostics_source) g_source_remove(app->diagnostics_source);
+    app->diagnostics_source = 0;
+}
+
+static void on_reset_diagnostics(GtkButton *btn, gpointer data)
+{
+    (void)btn;
+    profile_reset();
+    refresh_diagnostics((AppWidgets*)data);
+}
+
+static GtkWidget* build_diagnostics_tab(AppWidgets *app)
+{
+    app->diagnostics_store = gtk_list_store_new(N_COL_D, G_TYPE_STRING, G_TYPE_UINT64, G_TYPE_UINT64,
+        G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE);
+    GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(app->diagnostics_store));
+    app->diagnostics_view = view;
+    GtkCellRenderer *r; GtkTreeViewColumn *c;
+    r = gtk_cell_renderer_text_new(); c = gtk_tree_view_column_new_with_attributes("Probe", r, "text", COL_D_NAME, NULL); gtk_tree_view_append_column(GTK_TREE_VIEW(view), c);
+    r = gtk_cell_renderer_text_new(); c = gtk_tree_view_column_new_with_attributes("Calls", r, "text", COL_D_CALLS, NULL); gtk_tree_view_append_column(GTK_TREE_VIEW(view), c);
+    r = gtk_cell_renderer_text_new(); c = gtk_tree_view_column_new_with_attributes("Rows", r, "text", COL_D_ROWS, NULL); gtk_tree_view_append_column(GTK_TREE_VIEW(view), c);
+    static const char *const titles[] = { "Total ms", "Mean us", "p50 us", "p95 us", "p99 us", "Max us" };
+    for (int i = 0; i < 6; ++i) {
+        r = gtk_cell_renderer_text_new();
+        c = gtk_tree_view_column_new_with_attributes(titles[i], r, NULL);
+        gtk_tree_view_column_set_cell_data_func(c, r, diagnostics_cell_data_func, GINT_TO_POINTER(COL_D_TOTAL + i), NULL);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(view), c);
+    }
+
+    GtkWidget *reset_btn = gtk_button_new_with_label("Reset counters");
+    GtkWidget *btn_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_pack_start(GTK_BOX(btn_box), reset_btn, FALSE, FALSE, 0);
+
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    GtkWidget *sw = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(sw), view);
+    gtk_box_pack_start(GTK_BOX(vbox), sw, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), btn_box, FALSE, FALSE, 0);
+
+    g_signal_connect(reset_btn, "clicked", G_CALLBACK(on_reset_diagnostics), app);
+    g_signal_connect(view, "map", G_CALLBACK(on_diagnostics_map), app);
+    g_signal_connect(view, "unmap", G_CALLBACK(on_diagnostics_unmap), app);
+    return vbox;
+}
+
+/* Runs before main's destroy handler closes the database */
+static void on_window_destroy(GtkWidget *w, gpointer data)
+{
+    (void)w;
+    AppWidgets *app = (AppWidgets*)data;
+    if (app->diagnostics_source) g_source_remove(app->diagnostics_source);
+    app->diagnostics_source = 0;
+    cancel_backup(app);
+    cancel_export(app);
+    tx_loader_cancel(app->tx_loader);
+    app->tx_loader = NULL;
+    tx_loader_shutdown();  /* workers hold pooled readers */
+    tx_model_shutdown();
+    write_queue_stop();  /* commits whatever is still queued */
+    events_unsubscribe(on_change_event, app);
 }
 
 static GtkWidget* build_settings_tab(AppWidgets *app)
@@ -645,35 +1557,84 @@ static GtkWidget* build_settings_tab(AppWidgets *app)
     gtk_box_pack_start(GTK_BOX(vbox), current_label_title, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(vbox), app->currency_label, FALSE, FALSE, 0);
 
+    GtkWidget *verify_btn = gtk_button_new_with_label("Verify report totals");
+    gtk_box_pack_start(GTK_BOX(vbox), verify_btn, FALSE, FALSE, 12);
+    GtkWidget *rename_btn = gtk_button_new_with_label("Rename category");
+    gtk_box_pack_start(GTK_BOX(vbox), rename_btn, FALSE, FALSE, 0);
+
     g_signal_connect(save_btn, "clicked", G_CALLBACK(on_save_currency), app);
+    g_signal_connect(verify_btn, "clicked", G_CALLBACK(on_verify_summary), app);
+    GtkWidget *backup_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *backup_btn = gtk_button_new_with_label("Back up now");
+    GtkWidget *restore_btn = gtk_button_new_with_label("Restore from backup");
+    app->backup_progress = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(app->backup_progress), TRUE);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(app->backup_progress), app->backup_job ? "Backing up..." : "");
+    gtk_box_pack_start(GTK_BOX(backup_box), backup_btn, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(backup_box), restore_btn, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(backup_box), app->backup_progress, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), backup_box, FALSE, FALSE, 12);
+
+    g_signal_connect(rename_btn, "clicked", G_CALLBACK(on_rename_category), app);
+    g_signal_connect(backup_btn, "clicked", G_CALLBACK(on_backup_now), app);
+    g_signal_connect(restore_btn, "clicked", G_CALLBACK(on_restore_backup), app);
     return vbox;
 }
 
+/* Notebook pages in order; refresh fills a page right after it is built */
+static const struct {
+    const char *title;
+    const char *probe;
+    GtkWidget *(*build)(AppWidgets *app);
+    void (*refresh)(AppWidgets *app);
+} k_pages[APP_PAGE_COUNT] = {
+    { "Transactions", "gui:page_transactions", build_transactions_tab, fill_transactions },
+    { "Budgets",      "gui:page_budgets",      build_budgets_tab,      refresh_budgets },
+    { "Goals",        "gui:page_goals",        build_goals_tab,        refresh_goals },
+    { "Settings",     "gui:page_settings",     build_settings_tab,     NULL },
+    { "Diagnostics",  "gui:page_diagnostics",  build_diagnostics_tab,  NULL },  /* fills itself on map */
+};
+static ProfileProbe g_page_probes[APP_PAGE_COUNT];
+
+static void ensure_page(AppWidgets *app, int page)
+{
+    if (page < 0 || page >= APP_PAGE_COUNT || app->page_built[page]) return;
+    app->page_built[page] = TRUE;
+    uint64_t start = profile_now_ns();
+    GtkWidget *content = k_pages[page].build(app);
+    gtk_box_pack_start(GTK_BOX(app->page_slots[page]), content, TRUE, TRUE, 0);
+    gtk_widget_show_all(content);
+    if (k_pages[page].refresh) k_pages[page].refresh(app);
+    profile_record(&g_page_probes[page], k_pages[page].probe, profile_now_ns() - start, 0);
+}
+
+static void on_notebook_switch_page(GtkNotebook *nb, GtkWidget *page, guint page_num, gpointer data)
+{
+    (void)nb; (void)page;
+    ensure_page((AppWidgets*)data, (int)page_num);
+}
+
 GtkWidget* build_main_window(AppWidgets *app)
 {
     g_print("[debug] build_main_window start\n");
     app->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(app->window), "Personal Finance Manager");
+    g_signal_connect(app->window, "destroy", G_CALLBACK(on_window_destroy), app);
     gtk_window_set_default_size(GTK_WINDOW(app->window), 900, 600);
     /* Create notebook as before */
     app->notebook = gtk_notebook_new();
     g_print("[debug] notebook created\n");
 
-    GtkWidget *t_tab = build_transactions_tab(app);
-    GtkWidget *b_tab = build_budgets_tab(app);
-    GtkWidget *g_tab = build_goals_tab(app);
+    /* Only the dashboard is built now: its report and chart come from the monthly
+     * summaries, so they are cheap. The notebook pages wait until first shown. */
     GtkWidget *r_tab = build_reports_tab(app);
     GtkWidget *c_tab = build_charts_tab(app);
-    GtkWidget *s_tab = build_settings_tab(app);
 
-    g_print("[debug] tabs built (transactions,budgets,goals,reports,charts,settings)\n");
-
-    gtk_notebook_append_page(GTK_NOTEBOOK(app->notebook), t_tab, gtk_label_new("Transactions"));
-    gtk_notebook_append_page(GTK_NOTEBOOK(app->notebook), b_tab, gtk_label_new("Budgets"));
-    gtk_notebook_append_page(GTK_NOTEBOOK(app->notebook), g_tab, gtk_label_new("Goals"));
-    gtk_notebook_append_page(GTK_NOTEBOOK(app->notebook), s_tab, gtk_label_new("Settings"));
-
-    g_print("[debug] notebook pages appended\n");
+    for (int i = 0; i < APP_PAGE_COUNT; ++i) {
+        app->page_slots[i] = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+        gtk_notebook_append_page(GTK_NOTEBOOK(app->notebook), app->page_slots[i], gtk_label_new(k_pages[i].title));
+    }
+    g_signal_connect(app->notebook, "switch-page", G_CALLBACK(on_notebook_switch_page), app);
 
     /* Top-level stack: page 1 = dashboard, page 2 = main notebook */
     app->stack = gtk_stack_new();
@@ -823,16 +1784,80 @@ void update_gui_tables(AppWidgets *app)
 }
 
 /* Connect deferred handlers after the main window is shown to avoid early callbacks */
+#define RECURRING_MAX_SLEEP_S 3600  /* wake at least hourly so a suspend or clock change is caught up */
+#define RECURRING_RETRY_S 60
+
+static gboolean on_recurring_due(gpointer data);
+
+/* One timeout for the earliest pending occurrence, firing at local midnight of its
+ * day; the schedule listener re-arms it whenever that date changes. */
+static void arm_recurring_timer(void *data)
+{
+    AppWidgets *app = (AppWidgets*)data;
+    if (app->recurring_timer) g_source_remove(app->recurring_timer);
+    app->recurring_timer = 0;
+    int due = recurring_next_due();
+    if (!due) return;
+    struct tm tm = {0};
+    tm.tm_year = due / 10000 - 1900; tm.tm_mon = due / 100 % 100 - 1; tm.tm_mday = due % 100; tm.tm_isdst = -1;
+    double wait = difftime(mktime(&tm), time(NULL));
+    if (wait <= 0) app->recurring_timer = g_idle_add(on_recurring_due, app);
+    else app->recurring_timer = g_timeout_add_seconds(wait > RECURRING_MAX_SLEEP_S ? RECURRING_MAX_SLEEP_S : (guint)wait + 1, on_recurring_due, app);
+}
+
+static gboolean on_recurring_due(gpointer data)
+{
+    AppWidgets *app = (AppWidgets*)data;
+    app->recurring_timer = 0;
+    int created = recurring_run_due();
+    if (created < 0) {
+        app->recurring_timer = g_timeout_add_seconds(RECURRING_RETRY_S, on_recurring_due, app);
+        return G_SOURCE_REMOVE;
+    }
+    arm_recurring_timer(app);
+    return G_SOURCE_REMOVE;
+}
+
+/* Startup timing: the first frame is the end of the first paint of the window; the
+ * app is interactive once the main loop next goes idle, i.e. every event and redraw
+ * queued during startup has been handled. Both are recorded only as probes, which
+ * FINANCE_PROFILE=1 dumps at exit. */
+static ProfileProbe g_first_frame_probe, g_interactive_probe;
+
+static gboolean on_startup_idle(gpointer data)
+{
+    AppWidgets *app = (AppWidgets*)data;
+    uint64_t elapsed = profile_now_ns() - app->startup_ns;
+    profile_record(&g_interactive_probe, "startup:interactive", elapsed, 0);
+
+    /* Work that is not needed to show anything waits until now */
+    char last_backup[32] = "";
+    get_setting("last_backup", last_backup, sizeof(last_backup));
+    if (difftime(time(NULL), (time_t)atoll(last_backup)) > BACKUP_MAX_AGE_S) start_backup(app);
+    /* so is catching up on overdue recurring occurrences */
+    recurring_schedule_set_listener(arm_recurring_timer, app);
+    arm_recurring_timer(app);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_first_frame(GtkWidget *w, cairo_t *cr, gpointer data)
+{
+    (void)cr;
+    AppWidgets *app = (AppWidgets*)data;
+    uint64_t elapsed = profile_now_ns() - app->startup_ns;
+    g_signal_handler_disconnect(w, app->first_frame_handler);
+    app->first_frame_handler = 0;
+    profile_record(&g_first_frame_probe, "startup:first_frame", elapsed, 0);
+    g_idle_add_full(G_PRIORITY_LOW, on_startup_idle, app, NULL);
+    return FALSE;
+}
+
 void connect_deferred_handlers(AppWidgets *app)
 {
     if (!app) return;
-    /* Populate tables after the UI is realized to avoid initialization-time callbacks */
-    g_print("[debug] deferred: refreshing transactions\n");
-    refresh_transactions(app);
-    g_print("[debug] deferred: refreshing budgets\n");
-    refresh_budgets(app);
-    g_print("[debug] deferred: refreshing goals\n");
-    refresh_goals(app);
+    /* Tables fill themselves when their page is first shown (ensure_page) */
+    if (!app->startup_ns) app->startup_ns = profile_now_ns();
+    app->first_frame_handler = g_signal_connect_after(app->window, "draw", G_CALLBACK(on_first_frame), app);
     if (app->chart_area && GTK_IS_WIDGET(app->chart_area)) {
         g_signal_connect(app->chart_area, "draw", G_CALLBACK(on_chart_draw), app);
         /* Force an initial redraw */
@@ -842,6 +1867,10 @@ void connect_deferred_handlers(AppWidgets *app)
         g_signal_connect(app->chart_month_entry, "changed", G_CALLBACK(on_chart_month_changed), app);
         g_signal_connect(app->chart_month_entry, "changed", G_CALLBACK(on_reports_month_changed), app);
     }
+    if (events_subscribe(on_change_event, app) != 0)
+        g_warning("cannot subscribe to change events");
+    if (write_queue_start(dispatch_to_main) != 0)
+        g_warning("write queue unavailable; saving synchronously");
 }
 
 static void on_edit_budget(GtkButton *btn, gpointer data){
@@ -850,25 +1879,24 @@ static void on_edit_budget(GtkButton *btn, gpointer data){
     GtkTreeSelection *sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(app->budgets_view));
     GtkTreeIter it; GtkTreeModel *m;
     if (!gtk_tree_selection_get_selected(sel, &m, &it)) return;
-    int id = 0; char *category = NULL; double limit = 0.0;
+    int id = 0; char *category = NULL; gint64 limit = 0;
     gtk_tree_model_get(m, &it, COL_B_ID, &id, COL_B_CATEGORY, &category, COL_B_LIMIT, &limit, -1);
     if (!category) category = g_strdup("");
 
     GtkWidget *d = gtk_dialog_new_with_buttons("Edit Budget", GTK_WINDOW(app->window), GTK_DIALOG_MODAL, "Cancel", GTK_RESPONSE_CANCEL, "Save", GTK_RESPONSE_ACCEPT, NULL);
     GtkWidget *c = gtk_dialog_get_content_area(GTK_DIALOG(d)); GtkWidget *grid = gtk_grid_new(); gtk_grid_set_row_spacing(GTK_GRID(grid), 6); gtk_grid_set_column_spacing(GTK_GRID(grid), 6);
     GtkWidget *catw = gtk_entry_new(); gtk_entry_set_text(GTK_ENTRY(catw), category);
-    GtkWidget *limitw = gtk_entry_new(); char lb[64]; snprintf(lb, sizeof(lb), "%.2f", limit); gtk_entry_set_text(GTK_ENTRY(limitw), lb);
+    GtkWidget *limitw = gtk_entry_new(); char lb[64]; money_to_string(limit, lb, sizeof(lb)); gtk_entry_set_text(GTK_ENTRY(limitw), lb);
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Category"), 0,0,1,1); gtk_grid_attach(GTK_GRID(grid), catw, 1,0,1,1);
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Monthly Limit"), 0,1,1,1); gtk_grid_attach(GTK_GRID(grid), limitw, 1,1,1,1);
     gtk_container_add(GTK_CONTAINER(c), grid); gtk_widget_show_all(d);
     if (gtk_dialog_run(GTK_DIALOG(d)) == GTK_RESPONSE_ACCEPT) {
-        Budget b = {0}; snprintf(b.category, CATEGORY_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(catw))); b.monthly_limit = atof(gtk_entry_get_text(GTK_ENTRY(limitw)));
+        Budget b = {0}; snprintf(b.category, CATEGORY_LEN, "%s", gtk_entry_get_text(GTK_ENTRY(catw))); b.monthly_limit = entry_money(limitw);
         /* update in-place */
         if (update_budget(id, &b) != 0) {
             /* fallback: try add_or_update by category */
             add_or_update_budget(&b);
         }
-        refresh_budgets(app);
     }
     gtk_widget_destroy(d);
     g_free(category);
@@ -884,8 +1912,5 @@ static void on_delete_budget(GtkButton *btn, gpointer data){
     GtkWidget *d = gtk_message_dialog_new(GTK_WINDOW(app->window), GTK_DIALOG_MODAL, GTK_MESSAGE_WARNING, GTK_BUTTONS_YES_NO, "Delete selected budget? This cannot be undone.");
     int resp = gtk_dialog_run(GTK_DIALOG(d));
     gtk_widget_destroy(d);
-    if (resp == GTK_RESPONSE_YES) {
-        delete_budget(id);
-        refresh_budgets(app);
-    }
+    if (resp == GTK_RESPONSE_YES) delete_budget(id);
 }
\ No newline at end of file
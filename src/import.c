@@ -0,0 +1,432 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <pthread.h>
+#include "import.h"
+#include "database.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define IMPORT_CHUNK_BYTES (1 << 20)   /* parse unit handed to one worker */
+#define IMPORT_MAX_THREADS 8
+#define IMPORT_MAX_AHEAD 16            /* parsed-but-not-inserted chunks allowed in memory */
+#define IMPORT_COMMIT_ROWS 100000      /* rows per explicit transaction */
+#define IMPORT_MAX_FIELDS 16
+#define IMPORT_FIELD_CAP 256
+
+enum { COL_ID, COL_TYPE, COL_CATEGORY, COL_AMOUNT, COL_DATE, COL_NOTE, N_IMPORT_COLS };
+static const char *const k_col_names[N_IMPORT_COLS] = { "id", "type", "category", "amount", "date", "note" };
+
+typedef struct ParsedRow {
+    long line;
+    Transaction t;
+} ParsedRow;
+
+typedef struct RowIssue {
+    long line;
+    char message[96];
+} RowIssue;
+
+typedef struct ImportChunk {
+    const char *begin;
+    const char *end;
+    long first_line;
+    int parsed;
+    ParsedRow *rows; int nrows; int rows_cap;
+    RowIssue *issues; int nissues; int issues_cap;
+} ImportChunk;
+
+typedef struct ImportJob {
+    int col[N_IMPORT_COLS];    /* field index per column, -1 if absent */
+    ImportChunk *chunks;
+    int nchunks;
+    int next_chunk;            /* next chunk a worker will parse */
+    int consumed;              /* chunks already inserted by the main thread */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} ImportJob;
+
+typedef struct MappedFile {
+    const char *data;
+    size_t len;
+    int mapped;
+} MappedFile;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int map_file(const char *filename, MappedFile *mf)
+{
+    memset(mf, 0, sizeof(*mf));
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    mf->len = (size_t)st.st_size;
+    if (mf->len == 0) { close(fd); mf->data = ""; return 0; }
+    void *p = mmap(NULL, mf->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+    posix_madvise(p, mf->len, POSIX_MADV_SEQUENTIAL);
+    mf->data = (const char*)p;
+    mf->mapped = 1;
+    return 0;
+#else
+    /* No mmap on Windows builds: read the whole file instead. */
+    FILE *f = fopen(filename, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = (char*)malloc(size > 0 ? (size_t)size : 1);
+    if (!buf) { fclose(f); return -1; }
+    mf->len = size > 0 ? fread(buf, 1, (size_t)size, f) : 0;
+    fclose(f);
+    mf->data = buf;
+    return 0;
+#endif
+}
+
+static void unmap_file(MappedFile *mf)
+{
+#ifndef _WIN32
+    if (mf->mapped) munmap((void*)mf->data, mf->len);
+#else
+    free((void*)mf->data);
+#endif
+    memset(mf, 0, sizeof(*mf));
+}
+
+static int default_thread_count(void)
+{
+    long n = 2;
+#ifdef _SC_NPROCESSORS_ONLN
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1) n = 1;
+    if (n > IMPORT_MAX_THREADS) n = IMPORT_MAX_THREADS;
+    return (int)n;
+}
+
+/* Parse one CSV record starting at p into fields (NUL-terminated, truncated to
+ * IMPORT_FIELD_CAP). Returns the position after the record's line break. */
+static const char *parse_record(const char *p, const char *end, char fields[][IMPORT_FIELD_CAP], int *out_nfields, long *out_newlines)
+{
+    int nf = 0;
+    long nl = 0;
+    for (;;) {
+        char *dst = nf < IMPORT_MAX_FIELDS ? fields[nf] : NULL;
+        size_t len = 0;
+#define PUT(c) do { if (dst && len < IMPORT_FIELD_CAP - 1) dst[len++] = (c); } while (0)
+        if (p < end && *p == '"') {
+            ++p;
+            while (p < end) {
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') { PUT('"'); p += 2; continue; }
+                    ++p;
+                    break;
+                }
+                if (*p == '\n') ++nl;
+                PUT(*p);
+                ++p;
+            }
+            while (p < end && *p != ',' && *p != '\n') ++p;
+        } else {
+            while (p < end && *p != ',' && *p != '\n') { PUT(*p); ++p; }
+            if (len > 0 && dst && dst[len - 1] == '\r') --len;
+        }
+#undef PUT
+        if (dst) dst[len] = '\0';
+        ++nf;
+        if (p < end && *p == ',') { ++p; continue; }
+        if (p < end && *p == '\n') { ++p; ++nl; }
+        break;
+    }
+    *out_nfields = nf < IMPORT_MAX_FIELDS ? nf : IMPORT_MAX_FIELDS;
+    *out_newlines = nl;
+    return p;
+}
+
+static char *trim(char *s)
+{
+    while (isspace((unsigned char)*s)) ++s;
+    size_t n = strlen(s);
+    while (n > 0 && isspace((unsigned char)s[n - 1])) s[--n] = '\0';
+    return s;
+}
+
+static const char *field(char fields[][IMPORT_FIELD_CAP], int nfields, int idx)
+{
+    return (idx >= 0 && idx < nfields) ? trim(fields[idx]) : "";
+}
+
+static int chunk_add_issue(ImportChunk *c, long line, const char *fmt, const char *arg)
+{
+    if (c->nissues == c->issues_cap) {
+        int ncap = c->issues_cap ? c->issues_cap * 2 : 16;
+        RowIssue *tmp = (RowIssue*)realloc(c->issues, ncap * sizeof(RowIssue));
+        if (!tmp) return -1;
+        c->issues = tmp; c->issues_cap = ncap;
+    }
+    RowIssue *ri = &c->issues[c->nissues++];
+    ri->line = line;
+    snprintf(ri->message, sizeof(ri->message), fmt, arg);
+    return 0;
+}
+
+/* Turn one record into a validated Transaction; returns 0 or records an issue and returns 1. */
+static int validate_row(const ImportJob *job, ImportChunk *c, long line, char fields[][IMPORT_FIELD_CAP], int nfields, Transaction *t)
+{
+    memset(t, 0, sizeof(*t));
+    const char *amount = field(fields, nfields, job->col[COL_AMOUNT]);
+    Money v = 0;
+    if (money_parse(amount, &v) != 0) { chunk_add_issue(c, line, "invalid amount '%.40s'", amount); return 1; }
+
+    const char *date = field(fields, nfields, job->col[COL_DATE]);
+    int day = day_key_from_date(date);
+    if (day == 0) { chunk_add_issue(c, line, "invalid date '%.40s' (expected YYYY-MM-DD)", date); return 1; }
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), "%04d-%02d-%02d", day / 10000, (day / 100) % 100, day % 100);
+    snprintf(t->date, DATE_LEN, "%.10s", tmp);
+
+    if (job->col[COL_TYPE] >= 0) {
+        char type[TYPE_LEN + 8];
+        snprintf(type, sizeof(type), "%s", field(fields, nfields, job->col[COL_TYPE]));
+        for (char *q = type; *q; ++q) *q = (char)tolower((unsigned char)*q);
+        if (strcmp(type, "income") != 0 && strcmp(type, "expense") != 0) {
+            chunk_add_issue(c, line, "unknown type '%.40s'", type);
+            return 1;
+        }
+        snprintf(t->type, TYPE_LEN, "%s", type[0] == 'i' ? "income" : "expense");
+        t->amount = v;
+    } else {
+        snprintf(t->type, TYPE_LEN, "%s", v < 0 ? "expense" : "income");
+        t->amount = v < 0 ? -v : v;
+    }
+    snprintf(t->category, CATEGORY_LEN, "%s", field(fields, nfields, job->col[COL_CATEGORY]));
+    snprintf(t->note, NOTE_LEN, "%s", field(fields, nfields, job->col[COL_NOTE]));
+    return 0;
+}
+
+static void parse_chunk(const ImportJob *job, ImportChunk *c)
+{
+    char fields[IMPORT_MAX_FIELDS][IMPORT_FIELD_CAP];
+    const char *p = c->begin;
+    long line = c->first_line;
+    while (p < c->end) {
+        int nfields = 0; long nl = 0;
+        const char *next = parse_record(p, c->end, fields, &nfields, &nl);
+        long rec_line = line;
+        line += nl > 0 ? nl : 1;
+        p = next;
+        if (nfields == 1 && trim(fields[0])[0] == '\0') continue; /* blank line */
+
+        if (c->nrows == c->rows_cap) {
+            int ncap = c->rows_cap ? c->rows_cap * 2 : 1024;
+            ParsedRow *tmp = (ParsedRow*)realloc(c->rows, ncap * sizeof(ParsedRow));
+            if (!tmp) { chunk_add_issue(c, rec_line, "%s", "out of memory"); return; }
+            c->rows = tmp; c->rows_cap = ncap;
+        }
+        ParsedRow *r = &c->rows[c->nrows];
+        if (validate_row(job, c, rec_line, fields, nfields, &r->t) == 0) {
+            r->line = rec_line;
+            c->nrows++;
+        }
+    }
+}
+
+static void *parse_worker(void *arg)
+{
+    ImportJob *job = (ImportJob*)arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        while (job->next_chunk < job->nchunks && job->next_chunk >= job->consumed + IMPORT_MAX_AHEAD)
+            pthread_cond_wait(&job->cond, &job->lock);
+        if (job->next_chunk >= job->nchunks) { pthread_mutex_unlock(&job->lock); break; }
+        int idx = job->next_chunk++;
+        pthread_mutex_unlock(&job->lock);
+
+        parse_chunk(job, &job->chunks[idx]);
+
+        pthread_mutex_lock(&job->lock);
+        job->chunks[idx].parsed = 1;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+    return NULL;
+}
+
+/* Cut the body into ~IMPORT_CHUNK_BYTES pieces that end on a line break outside quotes. */
+static int split_chunks(const char *begin, const char *end, long first_line, ImportChunk **out, int *out_n)
+{
+    int cap = (int)((end - begin) / IMPORT_CHUNK_BYTES) + 2, n = 0;
+    ImportChunk *chunks = (ImportChunk*)calloc(cap, sizeof(ImportChunk));
+    if (!chunks) return -1;
+    const char *start = begin;
+    long line = first_line, start_line = first_line;
+    int in_quotes = 0;
+    for (const char *p = begin; p < end; ++p) {
+        if (*p == '"') in_quotes = !in_quotes;
+        else if (*p == '\n') {
+            ++line;
+            if (!in_quotes && p + 1 - start >= IMPORT_CHUNK_BYTES) {
+                if (n == cap) {
+                    ImportChunk *tmp = (ImportChunk*)realloc(chunks, cap * 2 * sizeof(ImportChunk));
+                    if (!tmp) { free(chunks); return -1; }
+                    memset(tmp + cap, 0, cap * sizeof(ImportChunk));
+                    chunks = tmp; cap *= 2;
+                }
+                chunks[n].begin = start; chunks[n].end = p + 1; chunks[n].first_line = start_line; n++;
+                start = p + 1; start_line = line;
+            }
+        }
+    }
+    if (start < end) {
+        if (n == cap) {
+            ImportChunk *tmp = (ImportChunk*)realloc(chunks, (cap + 1) * sizeof(ImportChunk));
+            if (!tmp) { free(chunks); return -1; }
+            memset(tmp + cap, 0, sizeof(ImportChunk));
+            chunks = tmp;
+        }
+        chunks[n].begin = start; chunks[n].end = end; chunks[n].first_line = start_line; n++;
+    }
+    *out = chunks; *out_n = n;
+    return 0;
+}
+
+static int read_header(ImportJob *job, const char *data, size_t len, const char **out_body, long *out_body_line)
+{
+    char fields[IMPORT_MAX_FIELDS][IMPORT_FIELD_CAP];
+    int nfields = 0; long nl = 0;
+    const char *body = parse_record(data, data + len, fields, &nfields, &nl);
+    for (int c = 0; c < N_IMPORT_COLS; ++c) job->col[c] = -1;
+    for (int i = 0; i < nfields; ++i) {
+        char *name = trim(fields[i]);
+        /* tolerate a UTF-8 byte order mark on the first column */
+        if (i == 0 && (unsigned char)name[0] == 0xEF && (unsigned char)name[1] == 0xBB && (unsigned char)name[2] == 0xBF) name += 3;
+        for (char *q = name; *q; ++q) *q = (char)tolower((unsigned char)*q);
+        for (int c = 0; c < N_IMPORT_COLS; ++c)
+            if (job->col[c] < 0 && strcmp(name, k_col_names[c]) == 0) job->col[c] = i;
+    }
+    *out_body = body;
+    *out_body_line = 1 + (nl > 0 ? nl : 1);
+    return (job->col[COL_AMOUNT] >= 0 && job->col[COL_DATE] >= 0) ? 0 : -1;
+}
+
+int import_csv(const char *filename, ImportErrorFn on_error, void *user_data, ImportStats *out_stats)
+{
+    ImportStats stats = {0};
+    if (out_stats) *out_stats = stats;
+    if (!filename) return -1;
+    double t0 = now_seconds();
+
+    MappedFile mf;
+    if (map_file(filename, &mf) != 0) {
+        if (on_error) on_error(0, "cannot open file", user_data);
+        return -1;
+    }
+
+    ImportJob job;
+    memset(&job, 0, sizeof(job));
+    const char *body = NULL; long body_line = 0;
+    if (read_header(&job, mf.data, mf.len, &body, &body_line) != 0) {
+        if (on_error) on_error(1, "header must name at least the amount and date columns", user_data);
+        unmap_file(&mf);
+        return -1;
+    }
+    if (split_chunks(body, mf.data + mf.len, body_line, &job.chunks, &job.nchunks) != 0) {
+        unmap_file(&mf);
+        return -1;
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    pthread_t threads[IMPORT_MAX_THREADS];
+    int nthreads = default_thread_count();
+    if (nthreads > job.nchunks) nthreads = job.nchunks;
+    int started = 0;
+    for (int i = 0; i < nthreads; ++i)
+        if (pthread_create(&threads[started], NULL, parse_worker, &job) == 0) started++;
+
+    int rc = 0;
+    long batch = 0;
+    int in_txn = 0;
+    for (int i = 0; i < job.nchunks; ++i) {
+        ImportChunk *c = &job.chunks[i];
+        if (started == 0) {
+            parse_chunk(&job, c); /* no threads available: parse each chunk as it is needed */
+        } else {
+            pthread_mutex_lock(&job.lock);
+            while (!c->parsed) pthread_cond_wait(&job.cond, &job.lock);
+            pthread_mutex_unlock(&job.lock);
+        }
+
+        /* Report rejected rows and insert valid ones, both in file order. */
+        int ii = 0;
+        for (int r = 0; r < c->nrows || ii < c->nissues; ) {
+            if (ii < c->nissues && (r >= c->nrows || c->issues[ii].line < c->rows[r].line)) {
+                if (on_error) on_error(c->issues[ii].line, c->issues[ii].message, user_data);
+                stats.rows_failed++; stats.rows_read++; ii++;
+                continue;
+            }
+            stats.rows_read++;
+            if (rc == 0) {
+                if (!in_txn) {
+                    if (db_begin_bulk_transaction() != 0) { rc = -1; r++; continue; }
+                    in_txn = 1;
+                }
+                if (add_transaction(&c->rows[r].t) == 0) {
+                    stats.rows_imported++;
+                    if (++batch >= IMPORT_COMMIT_ROWS) {
+                        if (db_commit_bulk_transaction() != 0) {
+                            /* the batch is lost, and the writer must not stay in it with the triggers dropped */
+                            db_rollback_transaction();
+                            stats.rows_imported -= batch;
+                            stats.rows_failed += batch;
+                            rc = -1;
+                        }
+                        in_txn = 0; batch = 0;
+                    }
+                } else {
+                    if (on_error) on_error(c->rows[r].line, "database insert failed", user_data);
+                    stats.rows_failed++;
+                }
+            }
+            r++;
+        }
+        free(c->rows); c->rows = NULL;
+        free(c->issues); c->issues = NULL;
+
+        pthread_mutex_lock(&job.lock);
+        job.consumed = i + 1;
+        pthread_cond_broadcast(&job.cond);
+        pthread_mutex_unlock(&job.lock);
+    }
+    if (in_txn) {
+        if (rc == 0 && db_commit_bulk_transaction() != 0) rc = -1;
+        if (rc != 0) {
+            db_rollback_transaction();
+            stats.rows_imported -= batch;
+            stats.rows_failed += batch;
+        }
+    }
+
+    for (int i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+    free(job.chunks);
+    unmap_file(&mf);
+
+    stats.seconds = now_seconds() - t0;
+    stats.rows_per_sec = stats.seconds > 0.0 ? stats.rows_imported / stats.seconds : 0.0;
+    if (out_stats) *out_stats = stats;
+    return rc;
+}
@@ -0,0 +1,406 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include "ledger_cache.h"
+#include "database.h"
+#include "arena.h"
+
+#define LC_MAX_CATEGORIES 65535
+#define LC_LOAD_ATTEMPTS 3
+#define LC_LOG_MAX 4096            /* writes remembered during one load; past that it rescans */
+
+/* Column store. Row order is arbitrary (deletes swap the last row in);
+ * slot_of_id maps a transaction id back to its row. */
+typedef struct LedgerColumns {
+    int count, cap;
+    int32_t *id;
+    int32_t *day;              /* YYYYMMDD */
+    Money *cents;
+    uint16_t *cat;             /* index into cat_names */
+    uint64_t *income_bits;     /* bit per row */
+    uint64_t *expense_bits;
+    int32_t *slot_of_id;       /* -1 when the id is not cached */
+    int id_cap;
+    char (*cat_names)[CATEGORY_LEN];
+    int ncat, cat_cap;
+    uint16_t *cat_hash;        /* open addressing, stores category index + 1 */
+    int hash_cap;
+} LedgerColumns;
+
+static LedgerColumns g_lc;
+static int g_loaded = 0;
+static int g_enabled = 1;
+static pthread_rwlock_t g_lock = PTHREAD_RWLOCK_INITIALIZER;
+/* background load; everything below is guarded by g_lock except g_stop */
+static pthread_t g_load_thread;
+static int g_load_joinable = 0;       /* a load thread that has not been joined */
+static int g_loading = 0;
+static atomic_int g_stop = 0;
+static LedgerWrite *g_log;            /* writes that landed while the load scans */
+static int g_log_count, g_log_cap;
+static int g_log_overflow;
+static int g_load_failed = 0;         /* no reader or a failed scan: wait for the next write */
+
+static void columns_free(LedgerColumns *c)
+{
+    free(c->id); free(c->day); free(c->cents); free(c->cat);
+    free(c->income_bits); free(c->expense_bits); free(c->slot_of_id);
+    free(c->cat_names); free(c->cat_hash);
+    memset(c, 0, sizeof(*c));
+}
+
+static int columns_reserve(LedgerColumns *c, int needed)
+{
+    if (c->cap >= needed) return 0;
+    int ncap = c->cap ? c->cap : 1024;
+    while (ncap < needed) ncap *= 2;
+    int words = (ncap + 63) / 64, old_words = (c->cap + 63) / 64;
+#define LC_GROW(field, n) do { void *p_ = realloc((field), (size_t)(n) * sizeof(*(field))); if (!p_) return -1; (field) = p_; } while (0)
+    LC_GROW(c->id, ncap);
+    LC_GROW(c->day, ncap);
+    LC_GROW(c->cents, ncap);
+    LC_GROW(c->cat, ncap);
+    LC_GROW(c->income_bits, words);
+    LC_GROW(c->expense_bits, words);
+#undef LC_GROW
+    memset(c->income_bits + old_words, 0, (words - old_words) * sizeof(uint64_t));
+    memset(c->expense_bits + old_words, 0, (words - old_words) * sizeof(uint64_t));
+    c->cap = ncap;
+    return 0;
+}
+
+static int columns_reserve_id(LedgerColumns *c, int id)
+{
+    if (id < c->id_cap) return 0;
+    int ncap = c->id_cap ? c->id_cap : 1024;
+    while (ncap <= id) ncap *= 2;
+    int32_t *p = (int32_t*)realloc(c->slot_of_id, ncap * sizeof(int32_t));
+    if (!p) return -1;
+    for (int i = c->id_cap; i < ncap; ++i) p[i] = -1;
+    c->slot_of_id = p;
+    c->id_cap = ncap;
+    return 0;
+}
+
+static uint32_t hash_name(const char *s)
+{
+    uint32_t h = 2166136261u;  /* FNV-1a */
+    for (; *s; ++s) { h ^= (unsigned char)*s; h *= 16777619u; }
+    return h;
+}
+
+static int find_category(const LedgerColumns *c, const char *name)
+{
+    if (!c->hash_cap) return -1;
+    for (uint32_t h = hash_name(name) & (c->hash_cap - 1); c->cat_hash[h]; h = (h + 1) & (c->hash_cap - 1))
+        if (strcmp(c->cat_names[c->cat_hash[h] - 1], name) == 0) return c->cat_hash[h] - 1;
+    return -1;
+}
+
+static int rebuild_hash(LedgerColumns *c, int ncap)
+{
+    uint16_t *tab = (uint16_t*)calloc(ncap, sizeof(uint16_t));
+    if (!tab) return -1;
+    for (int i = 0; i < c->ncat; ++i) {
+        uint32_t h = hash_name(c->cat_names[i]) & (ncap - 1);
+        while (tab[h]) h = (h + 1) & (ncap - 1);
+        tab[h] = (uint16_t)(i + 1);
+    }
+    free(c->cat_hash);
+    c->cat_hash = tab;
+    c->hash_cap = ncap;
+    return 0;
+}
+
+static int intern_category(LedgerColumns *c, const char *name)
+{
+    int idx = find_category(c, name);
+    if (idx >= 0) return idx;
+    if (c->ncat >= LC_MAX_CATEGORIES) return -1;
+    if (c->ncat == c->cat_cap) {
+        int ncap = c->cat_cap ? c->cat_cap * 2 : 64;
+        void *p = realloc(c->cat_names, ncap * sizeof(*c->cat_names));
+        if (!p) return -1;
+        c->cat_names = p;
+        c->cat_cap = ncap;
+    }
+    /* keep the hash at most half full */
+    if ((c->ncat + 1) * 2 > c->hash_cap && rebuild_hash(c, c->hash_cap ? c->hash_cap * 2 : 128) != 0) return -1;
+    idx = c->ncat++;
+    snprintf(c->cat_names[idx], CATEGORY_LEN, "%s", name);
+    uint32_t h = hash_name(name) & (c->hash_cap - 1);
+    while (c->cat_hash[h]) h = (h + 1) & (c->hash_cap - 1);
+    c->cat_hash[h] = (uint16_t)(idx + 1);
+    return idx;
+}
+
+static void set_bit(uint64_t *bits, int row, int on)
+{
+    if (on) bits[row >> 6] |= 1ull << (row & 63);
+    else bits[row >> 6] &= ~(1ull << (row & 63));
+}
+
+static int get_bit(const uint64_t *bits, int row)
+{
+    return (int)((bits[row >> 6] >> (row & 63)) & 1u);
+}
+
+/* Insert or overwrite the row for t->id. */
+static int columns_upsert(LedgerColumns *c, const Transaction *t)
+{
+    if (t->id <= 0 || columns_reserve_id(c, t->id) != 0) return -1;
+    int cat = intern_category(c, t->category);
+    if (cat < 0) return -1;
+    int row = c->slot_of_id[t->id];
+    if (row < 0) {
+        if (columns_reserve(c, c->count + 1) != 0) return -1;
+        row = c->count++;
+        c->slot_of_id[t->id] = row;
+    }
+    c->id[row] = t->id;
+    c->day[row] = day_key_from_date(t->date);
+    c->cents[row] = t->amount;
+    c->cat[row] = (uint16_t)cat;
+    set_bit(c->income_bits, row, strcmp(t->type, "income") == 0);
+    set_bit(c->expense_bits, row, strcmp(t->type, "expense") == 0);
+    return 0;
+}
+
+static void columns_delete(LedgerColumns *c, int id)
+{
+    if (id <= 0 || id >= c->id_cap || c->slot_of_id[id] < 0) return;
+    int row = c->slot_of_id[id], last = --c->count;
+    if (row != last) {
+        c->id[row] = c->id[last];
+        c->day[row] = c->day[last];
+        c->cents[row] = c->cents[last];
+        c->cat[row] = c->cat[last];
+        set_bit(c->income_bits, row, get_bit(c->income_bits, last));
+        set_bit(c->expense_bits, row, get_bit(c->expense_bits, last));
+        c->slot_of_id[c->id[row]] = row;
+    }
+    set_bit(c->income_bits, last, 0);
+    set_bit(c->expense_bits, last, 0);
+    c->slot_of_id[id] = -1;
+}
+
+/* Rows keep their category index: a plain rename relabels it, a merge repoints
+ * the rows at the existing name. */
+static int columns_rename(LedgerColumns *c, const char *from, const char *to)
+{
+    int f = find_category(c, from);
+    if (f < 0) return 0;
+    int t = find_category(c, to);
+    if (t >= 0) {
+        for (int row = 0; row < c->count; ++row)
+            if (c->cat[row] == f) c->cat[row] = (uint16_t)t;
+        return 0;
+    }
+    snprintf(c->cat_names[f], CATEGORY_LEN, "%s", to);
+    return rebuild_hash(c, c->hash_cap);
+}
+
+static int columns_apply(LedgerColumns *c, const LedgerWrite *w)
+{
+    switch (w->kind) {
+    case LEDGER_UPSERT: return columns_upsert(c, &w->u.t);
+    case LEDGER_DELETE: columns_delete(c, w->u.id); return 0;
+    case LEDGER_RENAME: return columns_rename(c, w->u.rename.from, w->u.rename.to);
+    }
+    return -1;
+}
+
+/* Caller holds the write lock. Loaded: apply w, dropping the cache if that fails
+ * so queries fall back to SQL. Loading: remember w for the snapshot. */
+static void apply_write(const LedgerWrite *w)
+{
+    if (g_loaded && columns_apply(&g_lc, w) != 0) {
+        columns_free(&g_lc);
+        g_loaded = 0;
+    }
+    if (!g_loading || g_log_overflow) return;
+    if (g_log_count == g_log_cap) {
+        int ncap = g_log_cap ? g_log_cap * 2 : 64;
+        LedgerWrite *tmp = ncap <= LC_LOG_MAX ? (LedgerWrite*)realloc(g_log, ncap * sizeof(LedgerWrite)) : NULL;
+        if (!tmp) { g_log_overflow = 1; return; }
+        g_log = tmp; g_log_cap = ncap;
+    }
+    g_log[g_log_count++] = *w;
+}
+
+static int load_row(const Transaction *t, void *user_data)
+{
+    if (atomic_load(&g_stop)) return 1;
+    return columns_upsert((LedgerColumns*)user_data, t);
+}
+
+/* Scan the ledger into fresh columns on a pooled reader, inside one read
+ * transaction, then replay the writes that landed meanwhile. The hooks are
+ * idempotent, so replaying one the snapshot already saw is harmless. */
+static void *load_main(void *arg)
+{
+    (void)arg;
+    int loaded = 0, failed = 1;
+    if (db_reader_acquire() == 0) {
+        for (int attempt = 0; attempt < LC_LOAD_ATTEMPTS && !loaded && !atomic_load(&g_stop); ++attempt) {
+            pthread_rwlock_wrlock(&g_lock);
+            g_log_count = 0;
+            g_log_overflow = 0;
+            pthread_rwlock_unlock(&g_lock);
+
+            LedgerColumns fresh;
+            memset(&fresh, 0, sizeof(fresh));
+            int rc = db_begin_transaction();
+            if (rc == 0) {
+                rc = visit_transactions(NULL, load_row, &fresh);
+                db_commit_transaction();
+            }
+
+            pthread_rwlock_wrlock(&g_lock);
+            int overflow = g_log_overflow;
+            if (rc == 0 && !overflow && g_enabled) {
+                for (int i = 0; i < g_log_count && rc == 0; ++i) rc = columns_apply(&fresh, &g_log[i]);
+                if (rc == 0) {
+                    columns_free(&g_lc);
+                    g_lc = fresh;
+                    g_loaded = loaded = 1;
+                }
+            }
+            pthread_rwlock_unlock(&g_lock);
+            if (!loaded) columns_free(&fresh);
+            if (!overflow) break;  /* only too many writes mid-scan is worth another pass */
+        }
+        failed = !loaded && !atomic_load(&g_stop);
+        db_reader_release();
+    }
+    pthread_rwlock_wrlock(&g_lock);
+    g_loading = 0;
+    g_load_failed = failed;
+    free(g_log);
+    g_log = NULL;
+    g_log_count = g_log_cap = 0;
+    pthread_rwlock_unlock(&g_lock);
+    return NULL;
+}
+
+/* Caller holds the write lock */
+static void start_load(void)
+{
+    if (g_loaded || g_loading || g_load_failed || !g_enabled || atomic_load(&g_stop)) return;
+    if (g_load_joinable) {
+        pthread_join(g_load_thread, NULL);  /* finished: it cleared g_loading */
+        g_load_joinable = 0;
+    }
+    g_loading = 1;
+    if (pthread_create(&g_load_thread, NULL, load_main, NULL) != 0) {
+        g_loading = 0;
+        return;
+    }
+    g_load_joinable = 1;
+}
+
+void ledger_cache_invalidate(void)
+{
+    pthread_rwlock_wrlock(&g_lock);
+    columns_free(&g_lc);
+    g_loaded = 0;
+    g_load_failed = 0;
+    if (g_loading) g_log_overflow = 1;  /* the scan in flight may predate what changed */
+    pthread_rwlock_unlock(&g_lock);
+}
+
+void ledger_cache_free(void)
+{
+    pthread_rwlock_wrlock(&g_lock);
+    atomic_store(&g_stop, 1);
+    int join = g_load_joinable;
+    g_load_joinable = 0;
+    pthread_rwlock_unlock(&g_lock);
+    if (join) pthread_join(g_load_thread, NULL);
+    pthread_rwlock_wrlock(&g_lock);
+    columns_free(&g_lc);
+    g_loaded = 0;
+    g_load_failed = 0;
+    atomic_store(&g_stop, 0);
+    pthread_rwlock_unlock(&g_lock);
+}
+
+void ledger_cache_set_enabled(int enabled)
+{
+    pthread_rwlock_wrlock(&g_lock);
+    g_enabled = enabled;
+    if (!enabled) {
+        columns_free(&g_lc);
+        g_loaded = 0;
+    }
+    pthread_rwlock_unlock(&g_lock);
+}
+
+void ledger_cache_apply(const LedgerWrite *writes, int count)
+{
+    if (count <= 0) return;
+    pthread_rwlock_wrlock(&g_lock);
+    for (int i = 0; i < count; ++i) apply_write(&writes[i]);
+    g_load_failed = 0;  /* worth another try once the ledger moves */
+    pthread_rwlock_unlock(&g_lock);
+}
+
+/* Months since year 0 for a YYYYMMDD or YYYYMM*100 key. */
+static int day_month_ordinal(int day)
+{
+    return (day / 10000) * 12 + (day / 100) % 100 - 1;
+}
+
+int ledger_cache_monthly(int months_back, const char *category, ResultSet *out)
+{
+    if (!out) return -1;
+    memset(out, 0, sizeof(*out));
+    if (months_back < 1) return -1;
+
+    pthread_rwlock_rdlock(&g_lock);
+    if (!g_loaded) {
+        /* never scan on the caller's thread: the SQL path answers until the load is in */
+        pthread_rwlock_unlock(&g_lock);
+        pthread_rwlock_wrlock(&g_lock);
+        start_load();
+        pthread_rwlock_unlock(&g_lock);
+        return -1;
+    }
+
+    char current_yyyymm[9];
+    get_current_yyyymm(current_yyyymm);
+    int last = day_month_ordinal(month_key_from_yyyymm(current_yyyymm) * 100);
+    int first = last - (months_back - 1);
+    int lo = (first / 12) * 10000 + (first % 12 + 1) * 100;
+    int hi = (last / 12) * 10000 + (last % 12 + 1) * 100 + 99;
+
+    /* one spare bucket at the end soaks up rows outside the window or category */
+    Money *income = (Money*)calloc(months_back + 1, sizeof(Money));
+    Money *expense = (Money*)calloc(months_back + 1, sizeof(Money));
+    int cat = category ? find_category(&g_lc, category) : -1;
+    if (income && expense && !(category && cat < 0)) {
+        const LedgerColumns *c = &g_lc;
+        for (int row = 0; row < c->count; ++row) {
+            int d = c->day[row];
+            int keep = d >= lo && d <= hi && (!category || c->cat[row] == cat);
+            int i = keep ? last - day_month_ordinal(d) : months_back;
+            Money inc = -(Money)((c->income_bits[row >> 6] >> (row & 63)) & 1u);
+            Money exp = -(Money)((c->expense_bits[row >> 6] >> (row & 63)) & 1u);
+            income[i] += c->cents[row] & inc;
+            expense[i] += c->cents[row] & exp;
+        }
+    }
+    pthread_rwlock_unlock(&g_lock);
+
+    int rc = income && expense ? result_set_init(out, months_back, 2, 0) : -1;
+    for (int i = 0; rc == 0 && i < months_back; ++i) {
+        int ord = last - i;
+        char label[16];
+        snprintf(label, sizeof(label), "%04d-%02d", ord / 12, ord % 12 + 1);
+        if (result_set_add_row(out, label) < 0) { result_set_free(out); rc = -1; break; }
+        out->money[RS_INCOME][i] = income[i];
+        out->money[RS_EXPENSE][i] = expense[i];
+    }
+    free(income); free(expense);
+    return rc;
+}
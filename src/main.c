@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include "gui.h"
 #include "database.h"
+#include "profile.h"
 
 static gboolean on_destroy(GtkWidget *widget, gpointer data)
 {
@@ -13,7 +14,9 @@ static gboolean on_destroy(GtkWidget *widget, gpointer data)
 
 int main(int argc, char *argv[])
 {
+    uint64_t startup_ns = profile_now_ns();  /* for the time-to-first-frame report */
     gtk_init(&argc, &argv);
+    profile_init_from_env();
     if (init_database("finance.db") != 0) {
         fprintf(stderr, "Failed to initialize database.\n");
         return 1;
@@ -34,6 +37,7 @@ int main(int argc, char *argv[])
     }
 
     AppWidgets app = {0};
+    app.startup_ns = startup_ns;
     g_print("[debug] calling build_main_window\n");
     GtkWidget *win = build_main_window(&app);
     g_print("[debug] returned from build_main_window\n");
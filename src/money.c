@@ -0,0 +1,15 @@
+#include "money.h"
+
+Money money_sum(const Money *values, size_t n)
+{
+    Money a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += values[i];
+        a1 += values[i + 1];
+        a2 += values[i + 2];
+        a3 += values[i + 3];
+    }
+    for (; i < n; ++i) a0 += values[i];
+    return (a0 + a1) + (a2 + a3);
+}
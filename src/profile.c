@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "profile.h"
+
+static _Atomic(ProfileProbe*) g_probes = NULL;
+static _Thread_local ProfileScope *t_scope = NULL;
+
+uint64_t profile_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Values below PROFILE_SUB_BUCKETS get a bucket each; above that the top
+ * PROFILE_SUB_BITS + 1 significant bits pick one. */
+static int bucket_index(uint64_t ns)
+{
+    if (ns < PROFILE_SUB_BUCKETS) return (int)ns;
+    if (ns >> PROFILE_MAX_EXP) ns = ((uint64_t)1 << PROFILE_MAX_EXP) - 1;
+    int exp = 63 - __builtin_clzll(ns);
+    int sub = (int)(ns >> (exp - PROFILE_SUB_BITS)) - PROFILE_SUB_BUCKETS;
+    return (exp - PROFILE_SUB_BITS + 1) * PROFILE_SUB_BUCKETS + sub;
+}
+
+/* Highest value that maps to the bucket, so percentiles never understate */
+static uint64_t bucket_upper(int index)
+{
+    if (index < PROFILE_SUB_BUCKETS) return (uint64_t)index;
+    int exp = index / PROFILE_SUB_BUCKETS + PROFILE_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(index % PROFILE_SUB_BUCKETS + PROFILE_SUB_BUCKETS);
+    return ((sub + 1) << (exp - PROFILE_SUB_BITS)) - 1;
+}
+
+void profile_record(ProfileProbe *probe, const char *name, uint64_t elapsed_ns, uint64_t rows)
+{
+    int expected = 0;
+    if (atomic_load_explicit(&probe->registered, memory_order_acquire) == 0 &&
+        atomic_compare_exchange_strong(&probe->registered, &expected, 1)) {
+        probe->name = name;
+        ProfileProbe *head = atomic_load(&g_probes);
+        do probe->next = head;
+        while (!atomic_compare_exchange_weak(&g_probes, &head, probe));
+    }
+    atomic_fetch_add_explicit(&probe->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&probe->rows, rows, memory_order_relaxed);
+    atomic_fetch_add_explicit(&probe->total_ns, elapsed_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&probe->buckets[bucket_index(elapsed_ns)], 1, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&probe->max_ns, memory_order_relaxed);
+    while (elapsed_ns > max &&
+           !atomic_compare_exchange_weak_explicit(&probe->max_ns, &max, elapsed_ns, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+void profile_scope_begin(ProfileScope *scope, ProfileProbe *probe, const char *name)
+{
+    scope->probe = probe;
+    scope->name = name;
+    scope->rows = 0;
+    scope->parent = t_scope;
+    t_scope = scope;
+    scope->start_ns = profile_now_ns();
+}
+
+void profile_scope_end(ProfileScope *scope)
+{
+    uint64_t elapsed = profile_now_ns() - scope->start_ns;
+    t_scope = scope->parent;
+    profile_record(scope->probe, scope->name, elapsed, scope->rows);
+}
+
+void profile_add_rows(uint64_t rows)
+{
+    if (t_scope) t_scope->rows += rows;
+}
+
+static double percentile_us(const uint64_t *buckets, uint64_t count, double p, uint64_t max_ns)
+{
+    uint64_t rank = (uint64_t)(p * (double)count + 0.999999), seen = 0;
+    if (rank == 0) rank = 1;
+    for (int i = 0; i < PROFILE_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t v = bucket_upper(i);
+            return (v < max_ns ? v : max_ns) / 1000.0;
+        }
+    }
+    return max_ns / 1000.0;
+}
+
+static int by_total_desc(const void *a, const void *b)
+{
+    double x = ((const ProfileStats*)a)->total_ms, y = ((const ProfileStats*)b)->total_ms;
+    return (x < y) - (x > y);
+}
+
+int profile_snapshot(ProfileStats **out_list, int *out_count)
+{
+    *out_list = NULL; *out_count = 0;
+    int cap = 0, count = 0;
+    ProfileStats *list = NULL;
+    uint64_t buckets[PROFILE_BUCKETS];
+    for (ProfileProbe *p = atomic_load(&g_probes); p; p = p->next) {
+        /* the buckets are read one by one while other threads may add to them, so
+         * percentiles use their own sum rather than the call counter */
+        uint64_t n = 0;
+        for (int i = 0; i < PROFILE_BUCKETS; ++i)
+            n += buckets[i] = atomic_load_explicit(&p->buckets[i], memory_order_relaxed);
+        if (n == 0) continue;
+        if (count == cap) {
+            int ncap = cap ? cap * 2 : 64;
+            ProfileStats *tmp = (ProfileStats*)realloc(list, ncap * sizeof(ProfileStats));
+            if (!tmp) { free(list); return -1; }
+            list = tmp; cap = ncap;
+        }
+        ProfileStats *s = &list[count++];
+        uint64_t max_ns = atomic_load_explicit(&p->max_ns, memory_order_relaxed);
+        s->name = p->name;
+        s->calls = atomic_load_explicit(&p->calls, memory_order_relaxed);
+        s->rows = atomic_load_explicit(&p->rows, memory_order_relaxed);
+        s->total_ms = atomic_load_explicit(&p->total_ns, memory_order_relaxed) / 1e6;
+        s->mean_us = s->calls ? s->total_ms * 1000.0 / s->calls : 0.0;
+        s->p50_us = percentile_us(buckets, n, 0.50, max_ns);
+        s->p95_us = percentile_us(buckets, n, 0.95, max_ns);
+        s->p99_us = percentile_us(buckets, n, 0.99, max_ns);
+        s->max_us = max_ns / 1000.0;
+    }
+    qsort(list, count, sizeof(ProfileStats), by_total_desc);
+    *out_list = list; *out_count = count;
+    return 0;
+}
+
+void profile_reset(void)
+{
+    for (ProfileProbe *p = atomic_load(&g_probes); p; p = p->next) {
+        atomic_store(&p->calls, 0);
+        atomic_store(&p->rows, 0);
+        atomic_store(&p->total_ns, 0);
+        atomic_store(&p->max_ns, 0);
+        for (int i = 0; i < PROFILE_BUCKETS; ++i) atomic_store(&p->buckets[i], 0);
+    }
+}
+
+void profile_dump(FILE *f)
+{
+    ProfileStats *list = NULL;
+    int count = 0;
+    if (profile_snapshot(&list, &count) != 0) return;
+    fprintf(f, "%-36s %9s %10s %11s %10s %10s %10s %10s %10s\n",
+            "probe", "calls", "rows", "total ms", "mean us", "p50 us", "p95 us", "p99 us", "max us");
+    for (int i = 0; i < count; ++i) {
+        const ProfileStats *s = &list[i];
+        fprintf(f, "%-36.36s %9llu %10llu %11.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                s->name, (unsigned long long)s->calls, (unsigned long long)s->rows,
+                s->total_ms, s->mean_us, s->p50_us, s->p95_us, s->p99_us, s->max_us);
+    }
+    free(list);
+}
+
+static void dump_at_exit(void)
+{
+    profile_dump(stderr);
+}
+
+void profile_init_from_env(void)
+{
+    const char *v = getenv("FINANCE_PROFILE");
+    if (v && strcmp(v, "1") == 0) atexit(dump_at_exit);
+}
@@ -0,0 +1,324 @@
+#include "recurring.h"
+#include "database.h"
+
+typedef enum { FREQ_INVALID, FREQ_WEEKLY, FREQ_MONTHLY, FREQ_YEARLY } Frequency;
+
+static Frequency parse_frequency(const char *s)
+{
+    if (strcmp(s, "weekly") == 0) return FREQ_WEEKLY;
+    if (strcmp(s, "monthly") == 0) return FREQ_MONTHLY;
+    if (strcmp(s, "yearly") == 0) return FREQ_YEARLY;
+    return FREQ_INVALID;
+}
+
+static int is_leap(int y)
+{
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+static int month_days(int y, int m)
+{
+    static const int dim[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    return m == 2 && is_leap(y) ? 29 : dim[m - 1];
+}
+
+/* Days since 1970-01-01 and back (proleptic Gregorian), so weekly steps are plain additions. */
+static long days_from_key(int key)
+{
+    int y = key / 10000, m = key / 100 % 100, d = key % 100;
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int key_from_days(long z)
+{
+    z += 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    int d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    int m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    int y = (int)(yoe + era * 400) + (m <= 2);
+    return y * 10000 + m * 100 + d;
+}
+
+static int add_months_key(int key, long months)
+{
+    long total = (long)(key / 10000) * 12 + (key / 100 % 100 - 1) + months;
+    int y = (int)(total / 12), m = (int)(total % 12) + 1, d = key % 100;
+    if (y < 1 || y > 9999) return 0;
+    if (d > month_days(y, m)) d = month_days(y, m);
+    return y * 10000 + m * 100 + d;
+}
+
+static int occurrence_key(Frequency f, int start_key, long n)
+{
+    switch (f) {
+    case FREQ_WEEKLY: {
+        int key = key_from_days(days_from_key(start_key) + 7 * n);
+        return key / 10000 <= 9999 ? key : 0;
+    }
+    case FREQ_MONTHLY: return add_months_key(start_key, n);
+    case FREQ_YEARLY: return add_months_key(start_key, 12 * n);
+    default: return 0;
+    }
+}
+
+int recurring_occurrence_key(const RecurringTransaction *rt, int n)
+{
+    int start = day_key_from_date(rt->start_date);
+    if (!start || n < 0) return 0;
+    return occurrence_key(parse_frequency(rt->frequency), start, n);
+}
+
+/* Index of the first occurrence after after_key, estimated from the calendar
+ * distance and then corrected for month-end clamping. */
+static long first_index_after(Frequency f, int start_key, int after_key)
+{
+    if (after_key < start_key) return 0;
+    long n;
+    if (f == FREQ_WEEKLY) n = (days_from_key(after_key) - days_from_key(start_key)) / 7;
+    else {
+        n = (long)(after_key / 10000 - start_key / 10000) * 12 + (after_key / 100 % 100 - start_key / 100 % 100);
+        if (f == FREQ_YEARLY) n /= 12;
+        if (n > 0) n--;
+    }
+    while (n >= 0) {
+        int key = occurrence_key(f, start_key, n);
+        if (key == 0 || key > after_key) break;
+        n++;
+    }
+    return n;
+}
+
+int recurring_next_key(const RecurringTransaction *rt, int after_key)
+{
+    Frequency f = parse_frequency(rt->frequency);
+    int start = day_key_from_date(rt->start_date);
+    if (f == FREQ_INVALID || !start) return 0;
+    int key = occurrence_key(f, start, first_index_after(f, start, after_key));
+    int end = rt->end_date[0] ? day_key_from_date(rt->end_date) : 0;
+    if (end && key > end) return 0;
+    return key;
+}
+
+/* Materialize one rule's occurrences in (watermark, today] and advance rt->last_run;
+ * returns rows created or -1. */
+static int catch_up_rule(RecurringTransaction *rt, int today_key)
+{
+    Frequency f = parse_frequency(rt->frequency);
+    int start = day_key_from_date(rt->start_date);
+    if (f == FREQ_INVALID || !start) return 0;  /* nothing sensible to schedule */
+    int until = today_key;
+    int end = rt->end_date[0] ? day_key_from_date(rt->end_date) : 0;
+    if (end && end < until) until = end;
+
+    Transaction t = {0};
+    snprintf(t.type, TYPE_LEN, "%s", rt->type);
+    snprintf(t.category, CATEGORY_LEN, "%s", rt->category);
+    t.amount = rt->amount;
+    snprintf(t.note, NOTE_LEN, "Recurring: %.*s", NOTE_LEN - 12, rt->note);
+
+    int created = 0, last = 0;
+    for (long n = first_index_after(f, start, day_key_from_date(rt->last_run)); ; ++n) {
+        int key = occurrence_key(f, start, n);
+        if (key == 0 || key > until) break;
+        snprintf(t.date, DATE_LEN, "%04d-%02d-%02d", key / 10000, key / 100 % 100, key % 100);
+        int rc = add_recurring_occurrence(rt->id, &t);
+        if (rc < 0) return -1;
+        if (rc == 0) created++;
+        last = key;
+    }
+    if (last) {
+        if (set_recurring_watermark(rt->id, t.date) != 0) return -1;
+        snprintf(rt->last_run, DATE_LEN, "%s", t.date);
+    }
+    return created;
+}
+
+/* ---- due-date schedule ---- */
+
+typedef struct ScheduleEntry {
+    int due;                   /* YYYYMMDD of the next occurrence past the watermark */
+    RecurringTransaction rule;
+} ScheduleEntry;
+
+static ScheduleEntry *g_heap = NULL;
+static int g_heap_count = 0;
+static int g_heap_cap = 0;
+static int g_heap_loaded = 0;
+static RecurringScheduleFn g_listener = NULL;
+static void *g_listener_data = NULL;
+
+static void heap_swap(int i, int j)
+{
+    ScheduleEntry tmp = g_heap[i];
+    g_heap[i] = g_heap[j];
+    g_heap[j] = tmp;
+}
+
+static void sift_up(int i)
+{
+    while (i > 0 && g_heap[(i - 1) / 2].due > g_heap[i].due) {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void sift_down(int i)
+{
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < g_heap_count && g_heap[l].due < g_heap[m].due) m = l;
+        if (r < g_heap_count && g_heap[r].due < g_heap[m].due) m = r;
+        if (m == i) return;
+        heap_swap(i, m);
+        i = m;
+    }
+}
+
+static void heap_remove_at(int i)
+{
+    g_heap[i] = g_heap[--g_heap_count];
+    if (i < g_heap_count) { sift_up(i); sift_down(i); }
+}
+
+/* Queue the rule at its next occurrence; inactive and finished rules are left out. */
+static int heap_push(const RecurringTransaction *rt)
+{
+    int due = rt->is_active ? recurring_next_key(rt, day_key_from_date(rt->last_run)) : 0;
+    if (!due) return 0;
+    if (g_heap_count == g_heap_cap) {
+        int ncap = g_heap_cap ? g_heap_cap * 2 : 16;
+        ScheduleEntry *nh = (ScheduleEntry*)realloc(g_heap, ncap * sizeof(ScheduleEntry));
+        if (!nh) return -1;
+        g_heap = nh; g_heap_cap = ncap;
+    }
+    g_heap[g_heap_count].due = due;
+    g_heap[g_heap_count].rule = *rt;
+    sift_up(g_heap_count++);
+    return 0;
+}
+
+static int heap_find(int id)
+{
+    for (int i = 0; i < g_heap_count; ++i)
+        if (g_heap[i].rule.id == id) return i;
+    return -1;
+}
+
+static void notify_if_changed(int old_due)
+{
+    if (g_listener && recurring_next_due() != old_due) g_listener(g_listener_data);
+}
+
+int recurring_schedule_load(void)
+{
+    int old_due = recurring_next_due();
+    RecurringTransaction *list = NULL;
+    int count = 0;
+    g_heap_count = 0;
+    g_heap_loaded = 0;
+    if (fetch_active_recurring_transactions(&list, &count) != 0) return -1;
+    int rc = 0;
+    for (int i = 0; i < count && rc == 0; ++i) rc = heap_push(&list[i]);
+    free(list);
+    if (rc != 0) { g_heap_count = 0; return -1; }
+    g_heap_loaded = 1;
+    notify_if_changed(old_due);
+    return 0;
+}
+
+void recurring_schedule_free(void)
+{
+    free(g_heap);
+    g_heap = NULL;
+    g_heap_count = g_heap_cap = 0;
+    g_heap_loaded = 0;
+}
+
+void recurring_schedule_update(const RecurringTransaction *rt)
+{
+    if (!g_heap_loaded) return;  /* the next load reads it from the database */
+    int old_due = recurring_next_due();
+    int i = heap_find(rt->id);
+    if (i >= 0) heap_remove_at(i);
+    if (heap_push(rt) != 0) g_heap_loaded = 0;  /* out of memory: reload on the next run */
+    notify_if_changed(old_due);
+}
+
+void recurring_schedule_remove(int id)
+{
+    if (!g_heap_loaded) return;
+    int old_due = recurring_next_due();
+    int i = heap_find(id);
+    if (i >= 0) heap_remove_at(i);
+    notify_if_changed(old_due);
+}
+
+int recurring_next_due(void)
+{
+    return g_heap_count > 0 ? g_heap[0].due : 0;
+}
+
+void recurring_schedule_set_listener(RecurringScheduleFn fn, void *user_data)
+{
+    g_listener = fn;
+    g_listener_data = user_data;
+}
+
+int recurring_run_due(void)
+{
+    if (!g_heap_loaded && recurring_schedule_load() != 0) return -1;
+    char today[DATE_LEN];
+    get_current_yyyymmdd(today);
+    int today_key = day_key_from_date(today);
+    if (g_heap_count == 0 || g_heap[0].due > today_key) return 0;
+
+    /* Take every due rule off the heap, catch them all up in one commit, then
+     * queue each again at its next occurrence after the new watermark. */
+    int old_due = recurring_next_due();
+    RecurringTransaction *due = NULL;
+    int ndue = 0, cap = 0;
+    while (g_heap_count > 0 && g_heap[0].due <= today_key) {
+        if (ndue == cap) {
+            int ncap = cap ? cap * 2 : 16;
+            RecurringTransaction *tmp = (RecurringTransaction*)realloc(due, ncap * sizeof(RecurringTransaction));
+            if (!tmp) { free(due); g_heap_loaded = 0; return -1; }
+            due = tmp; cap = ncap;
+        }
+        due[ndue++] = g_heap[0].rule;
+        heap_remove_at(0);
+    }
+
+    /* search indexing and summaries for the new rows are done once at the end */
+    int created = db_begin_bulk_transaction() == 0 ? 0 : -1;
+    for (int i = 0; i < ndue && created >= 0; ++i) {
+        int n = catch_up_rule(&due[i], today_key);
+        created = n < 0 ? -1 : created + n;
+    }
+    if (created >= 0 && db_commit_bulk_transaction() != 0) created = -1;
+    if (created < 0) {
+        db_rollback_transaction();
+        free(due);
+        g_heap_loaded = 0;  /* watermarks rolled back; rebuild from the database next time */
+        return -1;
+    }
+    for (int i = 0; i < ndue; ++i)
+        if (heap_push(&due[i]) != 0) g_heap_loaded = 0;
+    free(due);
+    notify_if_changed(old_due);
+    return created;
+}
+
+int process_recurring_transactions(void)
+{
+    if (recurring_schedule_load() != 0) return -1;
+    return recurring_run_due();
+}
@@ -0,0 +1,199 @@
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tx_loader.h"
+#include "database.h"
+
+typedef struct LoaderPage {
+    int count;
+    Transaction *rows;
+    char **snippets;           /* count strings, or NULL */
+} LoaderPage;
+
+/* Shared by the main loop and the worker; each holds a reference until it is done with it. */
+struct TxLoader {
+    gint refs;
+    GCancellable *cancel;
+    GMutex lock;               /* guards everything below up to on_batch */
+    GCond space;               /* signalled when the main loop takes a page */
+    GQueue pages;
+    guint idle;                /* pending delivery source, 0 if none */
+    gboolean finished;
+    int rc;
+    long total;
+    long loaded;               /* main loop only */
+    char *search;
+    int limit;
+    TxLoaderBatchFn on_batch;
+    TxLoaderDoneFn on_done;
+    void *user_data;
+};
+
+static GMutex g_workers_lock;
+static GCond g_workers_done;
+static int g_workers = 0;
+
+static void page_free(LoaderPage *page)
+{
+    if (!page) return;
+    if (page->snippets)
+        for (int i = 0; i < page->count; ++i) g_free(page->snippets[i]);
+    g_free(page->snippets);
+    g_free(page->rows);
+    g_free(page);
+}
+
+static void loader_unref(TxLoader *l)
+{
+    if (!g_atomic_int_dec_and_test(&l->refs)) return;
+    LoaderPage *page;
+    while ((page = (LoaderPage*)g_queue_pop_head(&l->pages))) page_free(page);
+    g_object_unref(l->cancel);
+    g_mutex_clear(&l->lock);
+    g_cond_clear(&l->space);
+    g_free(l->search);
+    g_free(l);
+}
+
+/* Main loop: one page per call, then the completion once the worker is finished */
+static gboolean deliver(gpointer data)
+{
+    TxLoader *l = (TxLoader*)data;
+    g_mutex_lock(&l->lock);
+    LoaderPage *page = (LoaderPage*)g_queue_pop_head(&l->pages);
+    if (page) g_cond_signal(&l->space);
+    else l->idle = 0;  /* the worker re-arms it when it queues more or finishes */
+    gboolean done = !page && l->finished;
+    long total = l->total;
+    int rc = l->rc;
+    g_mutex_unlock(&l->lock);
+
+    if (page) {
+        l->loaded += page->count;
+        TxLoaderBatch batch = { page->rows, (const char *const*)page->snippets, page->count, l->loaded, total };
+        l->on_batch(&batch, l->user_data);
+        page_free(page);
+        return G_SOURCE_CONTINUE;
+    }
+    if (done) {
+        l->on_done(rc, l->user_data);
+        loader_unref(l);  /* the main loop's reference */
+    }
+    return G_SOURCE_REMOVE;
+}
+
+/* Worker: queue a page for the main loop, waiting while it is TX_LOADER_MAX_PENDING
+ * pages behind. Takes the page; FALSE once the load is cancelled. */
+static gboolean push_page(TxLoader *l, LoaderPage *page)
+{
+    g_mutex_lock(&l->lock);
+    while (g_queue_get_length(&l->pages) >= TX_LOADER_MAX_PENDING && !g_cancellable_is_cancelled(l->cancel))
+        g_cond_wait(&l->space, &l->lock);
+    gboolean ok = !g_cancellable_is_cancelled(l->cancel);
+    if (ok) {
+        g_queue_push_tail(&l->pages, page);
+        if (!l->idle) l->idle = g_idle_add(deliver, l);
+    }
+    g_mutex_unlock(&l->lock);
+    if (!ok) page_free(page);
+    return ok;
+}
+
+static void set_total(TxLoader *l, long total)
+{
+    g_mutex_lock(&l->lock);
+    l->total = total;
+    g_mutex_unlock(&l->lock);
+}
+
+static int load_search(TxLoader *l)
+{
+    SearchHit *hits = NULL;
+    int count = 0;
+    if (search_transactions(l->search, l->limit, &hits, &count) != 0) return -1;
+    set_total(l, count);
+    for (int start = 0; start < count; start += TX_LOADER_BATCH_ROWS) {
+        LoaderPage *page = g_new0(LoaderPage, 1);
+        page->count = MIN(TX_LOADER_BATCH_ROWS, count - start);
+        page->rows = g_new(Transaction, page->count);
+        page->snippets = g_new(char*, page->count);
+        for (int i = 0; i < page->count; ++i) {
+            page->rows[i] = hits[start + i].tx;
+            page->snippets[i] = g_strdup(hits[start + i].snippet);
+        }
+        if (!push_page(l, page)) break;
+    }
+    free(hits);
+    return 0;
+}
+
+static void load_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancel)
+{
+    (void)source; (void)cancel;
+    TxLoader *l = (TxLoader*)task_data;
+    int rc = -1;
+    if (db_reader_acquire() == 0) {
+        /* one read transaction, so the hits and their rows see the same snapshot */
+        if (db_begin_transaction() == 0) {
+            rc = load_search(l);
+            db_commit_transaction();
+        }
+        db_reader_release();
+    }
+
+    g_mutex_lock(&l->lock);
+    l->finished = TRUE;
+    l->rc = rc;
+    if (!l->idle && !g_cancellable_is_cancelled(l->cancel)) l->idle = g_idle_add(deliver, l);
+    g_mutex_unlock(&l->lock);
+    loader_unref(l);  /* the worker's reference */
+    g_task_return_int(task, rc);
+
+    g_mutex_lock(&g_workers_lock);
+    if (--g_workers == 0) g_cond_broadcast(&g_workers_done);
+    g_mutex_unlock(&g_workers_lock);
+}
+
+TxLoader *tx_loader_start(const char *search, int limit, TxLoaderBatchFn on_batch, TxLoaderDoneFn on_done, void *user_data)
+{
+    TxLoader *l = g_new0(TxLoader, 1);
+    l->refs = 2;
+    l->cancel = g_cancellable_new();
+    g_mutex_init(&l->lock);
+    g_cond_init(&l->space);
+    g_queue_init(&l->pages);
+    l->total = -1;
+    l->search = g_strdup(search ? search : "");
+    l->limit = limit;
+    l->on_batch = on_batch;
+    l->on_done = on_done;
+    l->user_data = user_data;
+
+    g_mutex_lock(&g_workers_lock);
+    g_workers++;
+    g_mutex_unlock(&g_workers_lock);
+    GTask *task = g_task_new(NULL, l->cancel, NULL, NULL);
+    g_task_set_task_data(task, l, NULL);
+    g_task_run_in_thread(task, load_worker);
+    g_object_unref(task);
+    return l;
+}
+
+void tx_loader_cancel(TxLoader *l)
+{
+    if (!l) return;
+    g_cancellable_cancel(l->cancel);
+    g_mutex_lock(&l->lock);
+    g_cond_broadcast(&l->space);
+    if (l->idle) g_source_remove(l->idle);
+    l->idle = 0;
+    g_mutex_unlock(&l->lock);
+    loader_unref(l);  /* the main loop's reference */
+}
+
+void tx_loader_shutdown(void)
+{
+    g_mutex_lock(&g_workers_lock);
+    while (g_workers > 0) g_cond_wait(&g_workers_done, &g_workers_lock);
+    g_mutex_unlock(&g_workers_lock);
+}
@@ -0,0 +1,471 @@
+#include <gtk/gtk.h>
+#include <gio/gio.h>
+#include <string.h>
+#include "tx_model.h"
+#include "database.h"
+
+typedef struct TxModelPage {
+    long page;                 /* -1 while the slot is empty */
+    int count;                 /* rows read; short at the end or after a failed read */
+    guint64 used;              /* LRU tick */
+    Transaction *rows;         /* TX_MODEL_PAGE_ROWS, allocated on first use */
+} TxModelPage;
+
+struct _TxModel {
+    GObject parent;
+    gint stamp;
+    TxQuery query;
+    char *category;            /* query's strings */
+    char *search;
+    long rows;
+    long pages;
+    TxCursor *anchors;         /* anchors[p]: cursor just before page p; zeroed if not read yet */
+    TxModelPage cache[TX_MODEL_CACHE_PAGES];
+    guint64 tick;
+    gboolean read_failed;      /* warned since the last reload */
+    guint generation;          /* bumped by every reload, so anchors read before it are dropped */
+    gboolean anchor_job;       /* a worker is reading the anchors */
+};
+
+/* One anchor read on a worker: the query as it was, and the cursors it found */
+typedef struct AnchorJob {
+    TxModel *model;            /* a reference */
+    guint generation;
+    TxQuery query;
+    char *category;
+    char *search;
+    long pages;
+    TxCursor *anchors;         /* anchors[k] is the model's anchors[k + 1] */
+    long count;
+    int rc;
+} AnchorJob;
+
+static GMutex g_workers_lock;
+static GCond g_workers_done;
+static int g_workers = 0;
+
+static void tx_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(TxModel, tx_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, tx_model_tree_model_init))
+
+static const GType *column_types(void)
+{
+    static GType types[N_COL_T];
+    if (!types[0]) {
+        types[COL_T_ID] = G_TYPE_INT;
+        types[COL_T_TYPE] = G_TYPE_STRING;
+        types[COL_T_CATEGORY] = G_TYPE_STRING;
+        types[COL_T_AMOUNT] = G_TYPE_INT64;
+        types[COL_T_DATE] = G_TYPE_STRING;
+        types[COL_T_NOTE] = G_TYPE_STRING;
+        types[COL_T_NOTE_MARKUP] = G_TYPE_STRING;
+    }
+    return types;
+}
+
+/* Page p is started from the nearest page before it whose cursor is known:
+ * page 0 always, the rest once the page before them was read. */
+static int anchor_known(const TxModel *m, long p)
+{
+    return p == 0 || m->anchors[p].id != 0;
+}
+
+/* The same rows read backwards: the mirror order, counted from the other end */
+static TxOrder reverse_order(TxOrder order)
+{
+    switch (order) {
+    case TX_ORDER_OLDEST: return TX_ORDER_NEWEST;
+    case TX_ORDER_LARGEST: return TX_ORDER_SMALLEST;
+    case TX_ORDER_SMALLEST: return TX_ORDER_LARGEST;
+    default: return TX_ORDER_OLDEST;
+    }
+}
+
+/* Page p when it is nearer the end than any known anchor: skip from the end in
+ * reverse order and flip the rows, so jumping to the bottom costs what the top does. */
+static int read_page_reversed(TxModel *m, long p, TxModelPage *slot)
+{
+    long first = p * TX_MODEL_PAGE_ROWS, end = MIN(m->rows, first + TX_MODEL_PAGE_ROWS);
+    TxQuery q = m->query;
+    q.order = reverse_order(q.order);
+    TxCursor cursor = {0};
+    if (seek_transaction_page(&q, &cursor, m->rows - end, slot->rows, (int)(end - first), &slot->count) != 0) return -1;
+    for (int i = 0, j = slot->count - 1; i < j; ++i, --j) {
+        Transaction t = slot->rows[i];
+        slot->rows[i] = slot->rows[j];
+        slot->rows[j] = t;
+    }
+    return 0;
+}
+
+static const Transaction *row_at(TxModel *m, long row)
+{
+    long p = row / TX_MODEL_PAGE_ROWS;
+    int idx = (int)(row % TX_MODEL_PAGE_ROWS);
+    TxModelPage *slot = NULL, *victim = &m->cache[0];
+    for (int i = 0; i < TX_MODEL_CACHE_PAGES && !slot; ++i) {
+        if (m->cache[i].page == p) slot = &m->cache[i];
+        else if (m->cache[i].used < victim->used) victim = &m->cache[i];
+    }
+    if (!slot) {
+        slot = victim;
+        if (!slot->rows) slot->rows = g_new(Transaction, TX_MODEL_PAGE_ROWS);
+        long from = p;
+        while (!anchor_known(m, from)) --from;
+        TxCursor cursor = m->anchors[from];
+        int reversed = m->pages - 1 - p < p - from;
+        int rc = reversed
+            ? read_page_reversed(m, p, slot)
+            : seek_transaction_page(&m->query, &cursor, (from == p ? 0 : (p - from) * TX_MODEL_PAGE_ROWS),
+                                    slot->rows, TX_MODEL_PAGE_ROWS, &slot->count);
+        if (rc != 0) {
+            if (!m->read_failed) g_warning("reading transactions page %ld failed", p);
+            m->read_failed = TRUE;
+            slot->count = 0;  /* shown blank until the next reload */
+        } else if (!reversed && slot->count == TX_MODEL_PAGE_ROWS && p + 1 < m->pages) {
+            m->anchors[p + 1] = cursor;
+        }
+        slot->page = p;
+    }
+    slot->used = ++m->tick;
+    return idx < slot->count ? &slot->rows[idx] : NULL;
+}
+
+static void anchor_job_free(gpointer data)
+{
+    AnchorJob *job = (AnchorJob*)data;
+    g_object_unref(job->model);
+    g_free(job->category);
+    g_free(job->search);
+    g_free(job->anchors);
+    g_free(job);
+}
+
+/* Worker: every page's cursor from one stride query on a pooled reader */
+static void anchor_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancel)
+{
+    (void)source; (void)cancel;
+    AnchorJob *job = (AnchorJob*)task_data;
+    job->rc = -1;
+    if (db_reader_acquire() == 0) {
+        job->rc = fetch_page_anchors(&job->query, TX_MODEL_PAGE_ROWS, job->anchors, job->pages - 1, &job->count);
+        db_reader_release();
+    }
+    g_task_return_int(task, job->rc);
+
+    g_mutex_lock(&g_workers_lock);
+    if (--g_workers == 0) g_cond_broadcast(&g_workers_done);
+    g_mutex_unlock(&g_workers_lock);
+}
+
+static void start_anchor_job(TxModel *m);
+
+/* Main loop: take the anchors unless a reload came in meanwhile, in which case
+ * read them again for the new count. A failed read leaves the seeks from the
+ * nearest known cursor, as before any anchors were read. */
+static void on_anchors_read(GObject *source, GAsyncResult *res, gpointer data)
+{
+    (void)source; (void)data;
+    AnchorJob *job = (AnchorJob*)g_task_get_task_data(G_TASK(res));
+    TxModel *m = job->model;
+    m->anchor_job = FALSE;
+    if (job->generation != m->generation) {
+        start_anchor_job(m);
+    } else if (job->rc == 0) {
+        long n = MIN(job->count, m->pages - 1);
+        if (n > 0) memcpy(&m->anchors[1], job->anchors, n * sizeof(TxCursor));
+    } else if (!m->read_failed) {
+        g_warning("reading transactions page anchors failed");
+    }
+}
+
+/* Short lists are read from page 0 in a few seeks anyway; one job at a time,
+ * since a reload during the read restarts it when it comes back. */
+static void start_anchor_job(TxModel *m)
+{
+    if (m->anchor_job || m->pages <= TX_MODEL_CACHE_PAGES) return;
+    AnchorJob *job = g_new0(AnchorJob, 1);
+    job->model = g_object_ref(m);
+    job->generation = m->generation;
+    job->query = m->query;
+    job->category = g_strdup(m->category);
+    job->search = g_strdup(m->search);
+    job->query.category = job->category;
+    job->query.search = job->search;
+    job->pages = m->pages;
+    job->anchors = g_new(TxCursor, m->pages - 1);
+    m->anchor_job = TRUE;
+
+    g_mutex_lock(&g_workers_lock);
+    g_workers++;
+    g_mutex_unlock(&g_workers_lock);
+    GTask *task = g_task_new(NULL, NULL, on_anchors_read, NULL);
+    g_task_set_task_data(task, job, anchor_job_free);
+    g_task_run_in_thread(task, anchor_worker);
+    g_object_unref(task);
+}
+
+static GtkTreeModelFlags tx_model_get_flags(GtkTreeModel *model)
+{
+    (void)model;
+    return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint tx_model_get_n_columns(GtkTreeModel *model)
+{
+    (void)model;
+    return N_COL_T;
+}
+
+static GType tx_model_get_column_type(GtkTreeModel *model, gint column)
+{
+    (void)model;
+    g_return_val_if_fail(column >= 0 && column < N_COL_T, G_TYPE_INVALID);
+    return column_types()[column];
+}
+
+static gboolean set_iter(TxModel *m, GtkTreeIter *iter, long row)
+{
+    if (row < 0 || row >= m->rows) {
+        iter->stamp = 0;
+        return FALSE;
+    }
+    iter->stamp = m->stamp;
+    iter->user_data = GSIZE_TO_POINTER((gsize)row);
+    return TRUE;
+}
+
+static long iter_row(TxModel *m, GtkTreeIter *iter)
+{
+    g_return_val_if_fail(iter->stamp == m->stamp, -1);
+    return (long)GPOINTER_TO_SIZE(iter->user_data);
+}
+
+static gboolean tx_model_get_iter(GtkTreeModel *model, GtkTreeIter *iter, GtkTreePath *path)
+{
+    if (gtk_tree_path_get_depth(path) != 1) return FALSE;
+    return set_iter(TX_MODEL(model), iter, gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath *tx_model_get_path(GtkTreeModel *model, GtkTreeIter *iter)
+{
+    long row = iter_row(TX_MODEL(model), iter);
+    g_return_val_if_fail(row >= 0, NULL);
+    return gtk_tree_path_new_from_indices((gint)row, -1);
+}
+
+static void tx_model_get_value(GtkTreeModel *model, GtkTreeIter *iter, gint column, GValue *value)
+{
+    TxModel *m = TX_MODEL(model);
+    g_return_if_fail(column >= 0 && column < N_COL_T);
+    g_value_init(value, column_types()[column]);
+    long row = iter_row(m, iter);
+    /* the ledger shrank since the last count: blank until the reload that follows */
+    const Transaction *t = row >= 0 ? row_at(m, row) : NULL;
+    if (!t) return;
+    switch (column) {
+    case COL_T_ID: g_value_set_int(value, t->id); break;
+    case COL_T_TYPE: g_value_set_string(value, t->type); break;
+    case COL_T_CATEGORY: g_value_set_string(value, t->category); break;
+    case COL_T_AMOUNT: g_value_set_int64(value, t->amount); break;
+    case COL_T_DATE: g_value_set_string(value, t->date); break;
+    case COL_T_NOTE: g_value_set_string(value, t->note); break;
+    case COL_T_NOTE_MARKUP: g_value_take_string(value, g_markup_escape_text(t->note, -1)); break;
+    }
+}
+
+static gboolean tx_model_iter_next(GtkTreeModel *model, GtkTreeIter *iter)
+{
+    TxModel *m = TX_MODEL(model);
+    return set_iter(m, iter, iter_row(m, iter) + 1);
+}
+
+static gboolean tx_model_iter_previous(GtkTreeModel *model, GtkTreeIter *iter)
+{
+    TxModel *m = TX_MODEL(model);
+    long row = iter_row(m, iter);
+    return set_iter(m, iter, row >= 0 ? row - 1 : -1);
+}
+
+static gboolean tx_model_iter_children(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+    return set_iter(TX_MODEL(model), iter, parent ? -1 : 0);
+}
+
+static gboolean tx_model_iter_has_child(GtkTreeModel *model, GtkTreeIter *iter)
+{
+    (void)model; (void)iter;
+    return FALSE;
+}
+
+static gint tx_model_iter_n_children(GtkTreeModel *model, GtkTreeIter *iter)
+{
+    return iter ? 0 : (gint)TX_MODEL(model)->rows;
+}
+
+static gboolean tx_model_iter_nth_child(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+    return set_iter(TX_MODEL(model), iter, parent ? -1 : n);
+}
+
+static gboolean tx_model_iter_parent(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+    (void)model; (void)child;
+    iter->stamp = 0;
+    return FALSE;
+}
+
+static void tx_model_tree_model_init(GtkTreeModelIface *iface)
+{
+    iface->get_flags = tx_model_get_flags;
+    iface->get_n_columns = tx_model_get_n_columns;
+    iface->get_column_type = tx_model_get_column_type;
+    iface->get_iter = tx_model_get_iter;
+    iface->get_path = tx_model_get_path;
+    iface->get_value = tx_model_get_value;
+    iface->iter_next = tx_model_iter_next;
+    iface->iter_previous = tx_model_iter_previous;
+    iface->iter_children = tx_model_iter_children;
+    iface->iter_has_child = tx_model_iter_has_child;
+    iface->iter_n_children = tx_model_iter_n_children;
+    iface->iter_nth_child = tx_model_iter_nth_child;
+    iface->iter_parent = tx_model_iter_parent;
+}
+
+static void tx_model_finalize(GObject *object)
+{
+    TxModel *m = TX_MODEL(object);
+    for (int i = 0; i < TX_MODEL_CACHE_PAGES; ++i) g_free(m->cache[i].rows);
+    g_free(m->anchors);
+    g_free(m->category);
+    g_free(m->search);
+    G_OBJECT_CLASS(tx_model_parent_class)->finalize(object);
+}
+
+static void tx_model_class_init(TxModelClass *klass)
+{
+    G_OBJECT_CLASS(klass)->finalize = tx_model_finalize;
+}
+
+static void tx_model_init(TxModel *m)
+{
+    m->stamp = g_random_int();
+    for (int i = 0; i < TX_MODEL_CACHE_PAGES; ++i) m->cache[i].page = -1;
+}
+
+TxModel *tx_model_new(void)
+{
+    return g_object_new(TX_TYPE_MODEL, NULL);
+}
+
+void tx_model_set_query(TxModel *m, const TxQuery *q)
+{
+    g_free(m->category);
+    g_free(m->search);
+    m->query = *q;
+    m->category = g_strdup(q->category);
+    m->search = g_strdup(q->search);
+    m->query.category = m->category;
+    m->query.search = m->search;
+}
+
+long tx_model_count(TxModel *m)
+{
+    return count_transactions(&m->query);
+}
+
+int tx_model_reload(TxModel *m)
+{
+    return tx_model_reload_rows(m, tx_model_count(m));
+}
+
+int tx_model_reload_rows(TxModel *m, long rows)
+{
+    if (rows < 0) return -1;
+
+    /* Whatever a view has on screen was read into the cache; remember which pages
+     * those were so they can be reported changed once they read fresh. */
+    long shown[TX_MODEL_CACHE_PAGES];
+    int n_shown = 0;
+    for (int i = 0; i < TX_MODEL_CACHE_PAGES; ++i) {
+        if (m->cache[i].page >= 0) shown[n_shown++] = m->cache[i].page;
+        m->cache[i].page = -1;
+        m->cache[i].used = 0;
+    }
+    m->pages = (rows + TX_MODEL_PAGE_ROWS - 1) / TX_MODEL_PAGE_ROWS;
+    m->read_failed = FALSE;
+    g_free(m->anchors);
+    m->anchors = g_new0(TxCursor, m->pages + 1);
+    m->generation++;
+    start_anchor_job(m);
+
+    /* Nobody to tell: a view attached later asks for the count itself */
+    static guint row_inserted = 0;
+    if (!row_inserted) row_inserted = g_signal_lookup("row-inserted", GTK_TYPE_TREE_MODEL);
+    if (!g_signal_has_handler_pending(m, row_inserted, 0, FALSE)) {
+        m->rows = rows;
+        return 0;
+    }
+
+    /* One signal per row of difference, counted up or down at the end of the list */
+    GtkTreeModel *model = GTK_TREE_MODEL(m);
+    GtkTreeIter iter;
+    while (m->rows > rows) {
+        m->rows--;
+        GtkTreePath *path = gtk_tree_path_new_from_indices((gint)m->rows, -1);
+        gtk_tree_model_row_deleted(model, path);
+        gtk_tree_path_free(path);
+    }
+    while (m->rows < rows) {
+        m->rows++;
+        set_iter(m, &iter, m->rows - 1);
+        GtkTreePath *path = gtk_tree_path_new_from_indices((gint)(m->rows - 1), -1);
+        gtk_tree_model_row_inserted(model, path, &iter);
+        gtk_tree_path_free(path);
+    }
+    for (int i = 0; i < n_shown; ++i) {
+        long end = MIN(m->rows, (shown[i] + 1) * TX_MODEL_PAGE_ROWS);
+        for (long row = shown[i] * TX_MODEL_PAGE_ROWS; row < end; ++row) {
+            set_iter(m, &iter, row);
+            GtkTreePath *path = gtk_tree_path_new_from_indices((gint)row, -1);
+            gtk_tree_model_row_changed(model, path, &iter);
+            gtk_tree_path_free(path);
+        }
+    }
+    return 0;
+}
+
+int tx_model_row_updated(TxModel *m, const Transaction *before, const Transaction *after)
+{
+    const TxQuery *q = &m->query;
+    if (q->category || q->search || q->day_from || q->day_to) return 1;
+    int moved = (q->order == TX_ORDER_NEWEST || q->order == TX_ORDER_OLDEST)
+        ? strcmp(before->date, after->date) != 0 : before->amount != after->amount;
+    if (moved) return 1;
+    /* the anchors hold sort keys only, so they stay valid */
+    for (int i = 0; i < TX_MODEL_CACHE_PAGES; ++i) {
+        TxModelPage *slot = &m->cache[i];
+        if (slot->page < 0) continue;
+        for (int idx = 0; idx < slot->count; ++idx) {
+            if (slot->rows[idx].id != after->id) continue;
+            slot->rows[idx] = *after;
+            long row = slot->page * TX_MODEL_PAGE_ROWS + idx;
+            GtkTreeIter iter;
+            if (set_iter(m, &iter, row)) {
+                GtkTreePath *path = gtk_tree_path_new_from_indices((gint)row, -1);
+                gtk_tree_model_row_changed(GTK_TREE_MODEL(m), path, &iter);
+                gtk_tree_path_free(path);
+            }
+            return 0;
+        }
+    }
+    return 0;  /* not cached: read fresh whenever it is shown */
+}
+
+void tx_model_shutdown(void)
+{
+    g_mutex_lock(&g_workers_lock);
+    while (g_workers > 0) g_cond_wait(&g_workers_done, &g_workers_lock);
+    g_mutex_unlock(&g_workers_lock);
+}
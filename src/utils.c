@@ -1,5 +1,6 @@
 #include "utils.h"
 #include "database.h"
+#include "category.h"
 #include <ctype.h>
 #include <math.h>
 
@@ -59,65 +60,104 @@ int add_months_to_yyyymmdd(const char *yyyy_mm_dd, int months, char out_date[DAT
     return 0;
 }
 
+int day_key_from_date(const char *yyyy_mm_dd)
+{
+    int y = 0, m = 0, d = 0;
+    if (!yyyy_mm_dd || sscanf(yyyy_mm_dd, "%d-%d-%d", &y, &m, &d) != 3) return 0;
+    if (y < 1 || y > 9999 || m < 1 || m > 12 || d < 1 || d > days_in_month(y, m)) return 0;
+    return y * 10000 + m * 100 + d;
+}
+
+int month_key_from_yyyymm(const char *yyyymm)
+{
+    int y = 0, m = 0;
+    if (!yyyymm || sscanf(yyyymm, "%d-%d", &y, &m) != 2) return 0;
+    if (y < 1 || y > 9999 || m < 1 || m > 12) return 0;
+    return y * 100 + m;
+}
+
 void color_from_category(const char *category, double *r, double *g, double *b)
 {
     unsigned long hash = 5381;
-    const unsigned char *p = (const unsigned char*) (category ? category : "");
-    while (*p) hash = ((hash << 5) + hash) + *p++;
+    int id = category_lookup(category);
+    if (id > 0) {
+        hash = ((unsigned long)id * 2654435761u) & 0xFFFFFFu; /* interned: spread consecutive ids apart */
+    } else {
+        const unsigned char *p = (const unsigned char*) (category ? category : "");
+        while (*p) hash = ((hash << 5) + hash) + *p++;
+    }
     /* Map to visually distinct pastel colors */
     *r = ((hash >> 16) & 0xFF) / 255.0 * 0.6 + 0.2;
     *g = ((hash >> 8) & 0xFF) / 255.0 * 0.6 + 0.2;
     *b = (hash & 0xFF) / 255.0 * 0.6 + 0.2;
 }
 
-int export_to_csv(const char *filename)
+int money_parse(const char *s, Money *out)
 {
-    if (!filename) return -1;
-    FILE *f = fopen(filename, "w");
-    if (!f) return -1;
-    Transaction *list = NULL;
-    int count = 0;
-    int rc = fetch_transactions_all(&list, &count);
-    if (rc != 0) { fclose(f); return rc; }
-    fprintf(f, "id,type,category,amount,date,note\n");
-    for (int i = 0; i < count; ++i) {
-        /* naive CSV escaping for commas and quotes */
-        char note_escaped[NOTE_LEN * 2 + 2];
-        int pos = 0;
-        note_escaped[pos++] = '"';
-        for (const char *c = list[i].note; *c && pos < (int)sizeof(note_escaped)-2; ++c) {
-            if (*c == '"') note_escaped[pos++] = '"';
-            note_escaped[pos++] = *c;
+    if (!s || !out) return -1;
+    while (isspace((unsigned char)*s)) ++s;
+    int negative = 0;
+    if (*s == '-' || *s == '+') negative = (*s++ == '-');
+    Money whole = 0;
+    int digits = 0;
+    for (; isdigit((unsigned char)*s) || *s == ','; ++s) {
+        if (*s == ',') continue; /* thousands separators */
+        if (whole > (INT64_MAX - 9) / 10) return -1;
+        whole = whole * 10 + (*s - '0');
+        digits++;
+    }
+    int frac = 0, frac_digits = 0, round_up = 0;
+    if (*s == '.') {
+        for (++s; isdigit((unsigned char)*s); ++s) {
+            if (frac_digits < 2) { frac = frac * 10 + (*s - '0'); frac_digits++; }
+            else if (frac_digits++ == 2) round_up = (*s >= '5');
+            digits++;
         }
-        note_escaped[pos++] = '"';
-        note_escaped[pos] = '\0';
-        fprintf(f, "%d,%s,%s,%.2f,%s,%s\n",
-                list[i].id, list[i].type, list[i].category, list[i].amount, list[i].date, note_escaped);
     }
-    fclose(f);
-    free(list);
+    while (isspace((unsigned char)*s)) ++s;
+    if (*s != '\0' || digits == 0) return -1;
+    if (frac_digits == 1) frac *= 10;
+    if (whole > INT64_MAX / MONEY_SCALE - 1) return -1;
+    Money v = whole * MONEY_SCALE + frac + round_up;
+    *out = negative ? -v : v;
     return 0;
 }
 
+Money money_from_double(double value)
+{
+    return (Money)llround(value * MONEY_SCALE);
+}
+
+double money_to_double(Money amount)
+{
+    return (double)amount / MONEY_SCALE;
+}
+
+void money_to_string(Money amount, char *out, int out_size)
+{
+    if (!out || out_size <= 0) return;
+    unsigned long long abs_amt = amount < 0 ? 0ull - (unsigned long long)amount : (unsigned long long)amount;
+    snprintf(out, out_size, "%s%llu.%02llu", amount < 0 ? "-" : "", abs_amt / MONEY_SCALE, abs_amt % MONEY_SCALE);
+}
+
 /* Format amount with simple thousands separator and currency prefix.
  * out receives something like "$1,234.56". out_size must be sufficient.
  */
-void format_amount_currency(double amount, const char *currency, char *out, int out_size)
+void format_money(Money amount, const char *currency, char *out, int out_size)
 {
     if (!out || out_size <= 0) return;
     if (!currency) currency = "";
     /* We'll produce: <optional-sign><currency><integer_with_commas>.<two_decimals> */
-    double absamt = fabs(amount);
-    long long whole = (long long)floor(absamt);
-    int cents = (int)llround((absamt - (double)whole) * 100.0);
-    if (cents == 100) { whole += 1; cents = 0; }
+    unsigned long long absamt = amount < 0 ? 0ull - (unsigned long long)amount : (unsigned long long)amount;
+    unsigned long long whole = absamt / MONEY_SCALE;
+    int cents = (int)(absamt % MONEY_SCALE);
 
     char intbuf[64];
     int ibpos = sizeof(intbuf) - 1; intbuf[ibpos] = '\0';
     int digit_count = 0;
     if (whole == 0) { intbuf[--ibpos] = '0'; }
     else {
-        long long tmpwhole = whole;
+        unsigned long long tmpwhole = whole;
         while (tmpwhole > 0 && ibpos > 0) {
             if (digit_count == 3) {
                 intbuf[--ibpos] = ',';
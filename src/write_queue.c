@@ -0,0 +1,316 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include "write_queue.h"
+#include "database.h"
+
+#define SETTING_LEN 256
+
+typedef enum {
+    WRITE_ADD_TRANSACTION,
+    WRITE_EDIT_TRANSACTION,
+    WRITE_DELETE_TRANSACTION,
+    WRITE_SET_SETTING,
+    WRITE_RUN,                 /* ends the batch, then runs outside any transaction */
+    WRITE_FLUSH,               /* barrier: ends the batch and wakes the flushing thread */
+    WRITE_PAUSE,               /* same, then the writer waits for write_queue_resume */
+    WRITE_STOP
+} WriteKind;
+
+typedef struct FlushWait {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int done;
+} FlushWait;
+
+typedef struct WriteOp {
+    _Atomic(struct WriteOp*) next;
+    WriteKind kind;
+    union {
+        Transaction tx;
+        int id;
+        struct { char key[SETTING_LEN]; char value[SETTING_LEN]; } setting;
+        FlushWait *flush;
+        struct { WriteRunFn fn; void *arg; } run;
+    } u;
+    WriteDoneFn done;
+    void *user_data;
+    int rc;
+} WriteOp;
+
+/* Intrusive multi-producer single-consumer queue (Vyukov): producers swap
+ * themselves in as the head with one atomic exchange, and only the writer
+ * thread walks from the tail. g_stub keeps the list non-empty. */
+static WriteOp g_stub;
+static _Atomic(WriteOp*) g_head = &g_stub;
+static WriteOp *g_tail = &g_stub;
+
+static sem_t g_wake;
+static pthread_t g_thread;
+static atomic_int g_running = 0;
+static WriteDispatchFn g_dispatch = NULL;
+
+static pthread_mutex_t g_pause_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_pause_cond = PTHREAD_COND_INITIALIZER;
+static int g_paused = 0;
+
+static void queue_push(WriteOp *op)
+{
+    atomic_store_explicit(&op->next, NULL, memory_order_relaxed);
+    WriteOp *prev = atomic_exchange_explicit(&g_head, op, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, op, memory_order_release);
+}
+
+/* NULL when empty, or when a producer is between its two steps; its sem_post follows. */
+static WriteOp *queue_pop(void)
+{
+    WriteOp *tail = g_tail;
+    WriteOp *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &g_stub) {
+        if (!next) return NULL;
+        g_tail = tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (next) {
+        g_tail = next;
+        return tail;
+    }
+    if (tail != atomic_load_explicit(&g_head, memory_order_acquire)) return NULL;
+    queue_push(&g_stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (!next) return NULL;
+    g_tail = next;
+    return tail;
+}
+
+static int apply_op(const WriteOp *op)
+{
+    switch (op->kind) {
+    case WRITE_ADD_TRANSACTION: return add_transaction(&op->u.tx);
+    case WRITE_EDIT_TRANSACTION: return edit_transaction(&op->u.tx);
+    case WRITE_DELETE_TRANSACTION: return delete_transaction(op->u.id);
+    case WRITE_SET_SETTING: return set_setting(op->u.setting.key, op->u.setting.value);
+    case WRITE_RUN: return op->u.run.fn(op->u.run.arg);
+    default: return 0;
+    }
+}
+
+static void complete_op(void *arg)
+{
+    WriteOp *op = (WriteOp*)arg;
+    op->done(op->rc, op->user_data);
+    free(op);
+}
+
+static void finish_op(WriteOp *op)
+{
+    if (op->kind == WRITE_FLUSH || op->kind == WRITE_PAUSE) {
+        FlushWait *w = op->u.flush;
+        pthread_mutex_lock(&w->lock);
+        w->done = 1;
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        free(op);
+    } else if (op->done) {
+        if (g_dispatch) g_dispatch(complete_op, op);
+        else complete_op(op);
+    } else {
+        free(op);
+    }
+}
+
+/* Apply a batch in one transaction. A failed mutation only fails itself; if the
+ * commit fails, every mutation in the batch reports the error. */
+static void commit_batch(WriteOp **batch, int n)
+{
+    int in_tx = db_begin_transaction() == 0;
+    for (int i = 0; i < n; ++i) batch[i]->rc = apply_op(batch[i]);
+    if (in_tx && db_commit_transaction() != 0) {
+        db_rollback_transaction();
+        for (int i = 0; i < n; ++i) batch[i]->rc = -1;
+    }
+    for (int i = 0; i < n; ++i) finish_op(batch[i]);
+}
+
+typedef struct WriterStart {
+    sem_t started;
+    int rc;
+} WriterStart;
+
+static void *writer_main(void *arg)
+{
+    WriterStart *start = (WriterStart*)arg;
+    int rc = start->rc = db_writer_thread_attach();
+    sem_post(&start->started);  /* start is gone once write_queue_start returns */
+    if (rc != 0) return NULL;
+
+    WriteOp *batch[WRITE_QUEUE_BATCH_MAX];
+    int stop = 0;
+    while (!stop) {
+        sem_wait(&g_wake);
+        /* everything already queued goes into one commit, up to a barrier */
+        int n = 0, cut = 0, pause = 0;
+        WriteOp *op, *run = NULL;
+        while (n < WRITE_QUEUE_BATCH_MAX && (op = queue_pop()) != NULL) {
+            if (op->kind == WRITE_RUN) { run = op; cut = 1; break; }
+            batch[n++] = op;
+            if (op->kind == WRITE_FLUSH) { cut = 1; break; }
+            if (op->kind == WRITE_PAUSE) { cut = pause = 1; break; }
+            if (op->kind == WRITE_STOP) { stop = 1; break; }
+        }
+        if (n > 0) commit_batch(batch, n);  /* frees the ops */
+        if (run) {
+            run->rc = apply_op(run);
+            finish_op(run);
+        }
+        if (pause) {
+            pthread_mutex_lock(&g_pause_lock);
+            while (g_paused) pthread_cond_wait(&g_pause_cond, &g_pause_lock);
+            pthread_mutex_unlock(&g_pause_lock);
+        }
+        if (cut || n == WRITE_QUEUE_BATCH_MAX)
+            sem_post(&g_wake);  /* more may be waiting behind the cut */
+    }
+    db_writer_thread_detach();
+    return NULL;
+}
+
+int write_queue_start(WriteDispatchFn dispatch)
+{
+    if (atomic_load(&g_running)) return 0;
+    WriterStart start;
+    if (sem_init(&g_wake, 0, 0) != 0) return -1;
+    if (sem_init(&start.started, 0, 0) != 0) { sem_destroy(&g_wake); return -1; }
+    g_dispatch = dispatch;
+    start.rc = -1;
+    int rc = pthread_create(&g_thread, NULL, writer_main, &start) == 0 ? 0 : -1;
+    if (rc == 0) {
+        sem_wait(&start.started);
+        rc = start.rc;
+        if (rc != 0) pthread_join(g_thread, NULL);
+    }
+    sem_destroy(&start.started);
+    if (rc != 0) {
+        sem_destroy(&g_wake);
+        return -1;
+    }
+    atomic_store(&g_running, 1);
+    return 0;
+}
+
+static int enqueue(WriteOp *op)
+{
+    if (!atomic_load(&g_running)) {
+        op->rc = apply_op(op);
+        if (op->done) op->done(op->rc, op->user_data);
+        free(op);
+        return 0;
+    }
+    queue_push(op);
+    sem_post(&g_wake);
+    return 0;
+}
+
+void write_queue_stop(void)
+{
+    if (!atomic_load(&g_running)) return;
+    WriteOp *op = (WriteOp*)calloc(1, sizeof(WriteOp));
+    if (!op) return;  /* cannot ask the writer to stop; leave it running */
+    op->kind = WRITE_STOP;
+    queue_push(op);
+    sem_post(&g_wake);
+    pthread_join(g_thread, NULL);
+    atomic_store(&g_running, 0);
+    sem_destroy(&g_wake);
+}
+
+static void wait_for_barrier(WriteKind kind)
+{
+    FlushWait w = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 };
+    WriteOp *op = (WriteOp*)calloc(1, sizeof(WriteOp));
+    if (!op) return;
+    op->kind = kind;
+    op->u.flush = &w;
+    queue_push(op);
+    sem_post(&g_wake);
+    pthread_mutex_lock(&w.lock);
+    while (!w.done) pthread_cond_wait(&w.cond, &w.lock);
+    pthread_mutex_unlock(&w.lock);
+}
+
+void write_queue_flush(void)
+{
+    if (atomic_load(&g_running)) wait_for_barrier(WRITE_FLUSH);
+}
+
+void write_queue_pause(void)
+{
+    if (!atomic_load(&g_running)) return;
+    pthread_mutex_lock(&g_pause_lock);
+    g_paused = 1;
+    pthread_mutex_unlock(&g_pause_lock);
+    wait_for_barrier(WRITE_PAUSE);
+}
+
+void write_queue_resume(void)
+{
+    pthread_mutex_lock(&g_pause_lock);
+    g_paused = 0;
+    pthread_cond_broadcast(&g_pause_cond);
+    pthread_mutex_unlock(&g_pause_lock);
+}
+
+static WriteOp *new_op(WriteKind kind, WriteDoneFn done, void *user_data)
+{
+    WriteOp *op = (WriteOp*)calloc(1, sizeof(WriteOp));
+    if (!op) return NULL;
+    op->kind = kind;
+    op->done = done;
+    op->user_data = user_data;
+    return op;
+}
+
+int write_queue_add_transaction(const Transaction *t, WriteDoneFn done, void *user_data)
+{
+    WriteOp *op = new_op(WRITE_ADD_TRANSACTION, done, user_data);
+    if (!op) return -1;
+    op->u.tx = *t;
+    return enqueue(op);
+}
+
+int write_queue_edit_transaction(const Transaction *t, WriteDoneFn done, void *user_data)
+{
+    WriteOp *op = new_op(WRITE_EDIT_TRANSACTION, done, user_data);
+    if (!op) return -1;
+    op->u.tx = *t;
+    return enqueue(op);
+}
+
+int write_queue_delete_transaction(int id, WriteDoneFn done, void *user_data)
+{
+    WriteOp *op = new_op(WRITE_DELETE_TRANSACTION, done, user_data);
+    if (!op) return -1;
+    op->u.id = id;
+    return enqueue(op);
+}
+
+int write_queue_run(WriteRunFn fn, void *arg, WriteDoneFn done, void *user_data)
+{
+    if (!fn) return -1;
+    WriteOp *op = new_op(WRITE_RUN, done, user_data);
+    if (!op) return -1;
+    op->u.run.fn = fn;
+    op->u.run.arg = arg;
+    return enqueue(op);
+}
+
+int write_queue_set_setting(const char *key, const char *value, WriteDoneFn done, void *user_data)
+{
+    if (!key || !value) return -1;
+    WriteOp *op = new_op(WRITE_SET_SETTING, done, user_data);
+    if (!op) return -1;
+    snprintf(op->u.setting.key, SETTING_LEN, "%s", key);
+    snprintf(op->u.setting.value, SETTING_LEN, "%s", value);
+    return enqueue(op);
+}